@@ -24,6 +24,9 @@
 #include "send.h"
 #include "map.h"
 #include "id.h"
+#include "conf.h"
+#include "shm.h"
+#include "rma.h"
 #include "buffer.h"
 #include "debug.h"
 #include "times.h"
@@ -34,7 +37,10 @@ static int rank;
 /*  the num of the app proc*/
 static int client_num;
 static MPI_Comm inter_comm;
-static MPI_Comm client_comm, server_comm;
+static MPI_Comm client_comm;
+/* whether this client sends the dims, atts and full def_vars, only the meta
+ * leader of each server does in meta leader mode */
+static int send_meta = 1;
 
 int cfio_init(int x_proc_num, int y_proc_num, int ratio)
 {
@@ -44,8 +50,6 @@ int cfio_init(int x_proc_num, int y_proc_num, int ratio)
     int error, ret;
     int server_proc_num;
     int best_server_amount;
-    MPI_Group group, client_group, server_group;
-    int *ranks;
 
     //set_debug_mask(DEBUG_CFIO | DEBUG_SERVER);// | DEBUG_MSG | DEBUG_SERVER);
     rc = MPI_Initialized(&i); 
@@ -63,6 +67,8 @@ int cfio_init(int x_proc_num, int y_proc_num, int ratio)
     //    set_debug_mask(DEBUG_MAP);
     //}
     
+    cfio_conf_init();
+
     client_num = x_proc_num * y_proc_num;
     server_proc_num = size - client_num;
     if(server_proc_num < 0)
@@ -76,36 +82,28 @@ int cfio_init(int x_proc_num, int y_proc_num, int ratio)
 	best_server_amount = 1;
     }
 
-    MPI_Comm_group(MPI_COMM_WORLD, &group);
-    
-    //ranks = malloc(client_num * sizeof(int));
-    //for(i = 0; i < client_num; i ++)
-    //{
-    //    ranks[i] = i;
-    //}
-    //MPI_Group_incl(group, client_num, ranks, &client_group);
-    //MPI_Comm_create(MPI_COMM_WORLD, client_group, &client_comm);
-    //free(ranks);
-
-    ranks = malloc(server_proc_num * sizeof(int));
-    for(i = 0; i < server_proc_num; i ++)
-    {
-	ranks[i] = i + client_num;
-    }
-    MPI_Group_incl(group, server_proc_num, ranks, &server_group);
-    MPI_Comm_create(MPI_COMM_WORLD, server_group, &server_comm);
-    free(ranks);
-
     //times_start();
 
     if((ret = cfio_map_init(
 		    x_proc_num, y_proc_num, server_proc_num, 
-		    best_server_amount, MPI_COMM_WORLD, server_comm)) < 0)
+		    best_server_amount, MPI_COMM_WORLD)) < 0)
     {
 	error("Map Init Fail.");
 	return ret;
     }
 
+    if((ret = cfio_shm_init()) < 0)
+    {
+	error("Shm Init Fail.");
+	return ret;
+    }
+
+    if((ret = cfio_rma_init()) < 0)
+    {
+	error("Rma Init Fail.");
+	return ret;
+    }
+
     if(cfio_map_proc_type(rank) == CFIO_MAP_TYPE_SERVER)
     {
 	if((ret = cfio_server_init()) < 0)
@@ -131,7 +129,11 @@ int cfio_init(int x_proc_num, int y_proc_num, int ratio)
 	    error("");
 	    return ret;
 	}
-	
+
+	/* the first client of each server is the meta leader */
+	send_meta = !cfio_conf_get_meta_leader() || 
+	    0 == cfio_map_get_client_index_of_server(rank);
+	debug(DEBUG_CFIO, "send_meta = %d", send_meta);
     }
 
     debug(DEBUG_CFIO, "success return.");
@@ -164,6 +166,8 @@ int cfio_finalize()
 	cfio_send_final();
     }
 
+    cfio_rma_final();
+    cfio_shm_final();
     cfio_map_final();
     debug(DEBUG_CFIO, "success return.");
     return CFIO_ERROR_NONE;
@@ -180,6 +184,16 @@ int cfio_proc_type()
     return type;
 }
 
+int cfio_client_index()
+{
+    if(cfio_map_proc_type(rank) != CFIO_MAP_TYPE_CLIENT)
+    {
+	return -1;
+    }
+
+    return cfio_map_get_client_index(rank);
+}
+
 /**
  * @brief: create
  *
@@ -214,6 +228,40 @@ int cfio_create(
     debug(DEBUG_CFIO, "success return.");
     return CFIO_ERROR_NONE;
 }
+/**
+ * @brief: create from a template
+ *
+ * @param path: the file anme of the new netCDF dataset
+ * @param template_ncid: the netCDF ID of the template
+ * @param ncidp: pointer to location where returned netCDF ID is to be stored
+ *
+ * @return: 0 if success
+ */
+int cfio_create_from_template(
+	char *path, int template_ncid, int *ncidp)
+{
+    if(path == NULL || ncidp == NULL)
+    {
+	error("args should not be NULL.");
+	return CFIO_ERROR_ARG_NULL;
+    }
+
+    int ret;
+
+    if((ret = cfio_id_assign_nc_from_template(template_ncid, ncidp)) < 0)
+    {
+	error("");
+	return ret;
+    }
+
+    cfio_send_create_from_template(path, *ncidp, template_ncid);
+
+    debug(DEBUG_CFIO, "path = %s, ncid = %d, template = %d", 
+	    path, *ncidp, template_ncid);
+
+    debug(DEBUG_CFIO, "success return.");
+    return CFIO_ERROR_NONE;
+}
 /**
  * @brief: def_dim
  *
@@ -246,7 +294,10 @@ int cfio_def_dim(
 	return ret;
     }
 
-    cfio_send_def_dim(ncid, name, len, *idp);
+    if(send_meta)
+    {
+	cfio_send_def_dim(ncid, name, len, *idp);
+    }
 
     debug(DEBUG_CFIO, "success return.");
     return CFIO_ERROR_NONE;
@@ -275,8 +326,14 @@ int cfio_def_var(
 	return ret;
     }
     
-    cfio_send_def_var(ncid, name, xtype, 
-	    ndims, dimids, start, count, *varidp);
+    if(send_meta)
+    {
+	cfio_send_def_var(ncid, name, xtype, 
+		ndims, dimids, start, count, *varidp);
+    }else
+    {
+	cfio_send_def_var_decomp(ncid, xtype, ndims, start, count, *varidp);
+    }
     
     debug(DEBUG_CFIO, "success return.");
     return CFIO_ERROR_NONE;
@@ -288,11 +345,11 @@ int cfio_put_att(
 {
     cfio_msg_t *msg;
     
-    //if(cfio_map_get_client_index_of_server(rank) == 0)
-    //{
-    cfio_send_put_att(ncid, varid, name,
-	    xtype, len, op);
-    //}
+    if(send_meta)
+    {
+	cfio_send_put_att(ncid, varid, name,
+		xtype, len, op);
+    }
     debug(DEBUG_CFIO, "ncid = %d, var_id = %d, name = %s, len = %lu",
 	    ncid, varid, name, len);
 
@@ -304,6 +361,14 @@ int cfio_enddef(
 	int ncid)
 {
     cfio_msg_t *msg;
+    int ret;
+
+    /* keep the schema, new datasets can be created from it */
+    if((ret = cfio_id_save_template(ncid)) < 0)
+    {
+	error("");
+	return ret;
+    }
 
     cfio_send_enddef(ncid);
 
@@ -418,6 +483,64 @@ int cfio_put_vara_int(
     return CFIO_ERROR_NONE;
 }
 
+int cfio_iput_vara_float(
+	int ncid, int varid, int dim,
+	size_t *start, size_t *count, float *fp, int *request)
+{
+    if(start == NULL || count == NULL || fp == NULL || request == NULL)
+    {
+	error("args should not be NULL.");
+	return CFIO_ERROR_ARG_NULL;
+    }
+
+    return cfio_send_iput_vara(ncid, varid, dim, 
+	    start, count, CFIO_FLOAT, fp, request);
+}
+
+int cfio_iput_vara_double(
+	int ncid, int varid, int dim,
+	size_t *start, size_t *count, double *fp, int *request)
+{
+    if(start == NULL || count == NULL || fp == NULL || request == NULL)
+    {
+	error("args should not be NULL.");
+	return CFIO_ERROR_ARG_NULL;
+    }
+
+    return cfio_send_iput_vara(ncid, varid, dim, 
+	    start, count, CFIO_DOUBLE, fp, request);
+}
+
+int cfio_iput_vara_int(
+	int ncid, int varid, int dim,
+	size_t *start, size_t *count, int *fp, int *request)
+{
+    if(start == NULL || count == NULL || fp == NULL || request == NULL)
+    {
+	error("args should not be NULL.");
+	return CFIO_ERROR_ARG_NULL;
+    }
+
+    return cfio_send_iput_vara(ncid, varid, dim, 
+	    start, count, CFIO_INT, fp, request);
+}
+
+int cfio_wait(int request)
+{
+    return cfio_send_req_wait(request);
+}
+
+int cfio_test(int request, int *flag)
+{
+    if(flag == NULL)
+    {
+	error("args should not be NULL.");
+	return CFIO_ERROR_ARG_NULL;
+    }
+
+    return cfio_send_req_test(request, flag);
+}
+
 int cfio_io_end()
 {
     debug(DEBUG_CFIO, "Start cfio_io_end");
@@ -426,9 +549,7 @@ int cfio_io_end()
     
     cfio_send_io_end();
 
-#ifndef async_send
     //MPI_Barrier(client_comm);
-#endif
 
 #ifdef async_isend
     cfio_send_test();
@@ -478,6 +599,11 @@ void cfio_proc_type_c_(int *type)
     *type = cfio_proc_type();
 }
 
+void cfio_client_index_c_(int *index)
+{
+    *index = cfio_client_index();
+}
+
 void cfio_create_c_(
 	char *path, int *len, int *cmode, int *ncidp, int *ierr)
 {
@@ -489,6 +615,17 @@ void cfio_create_c_(
 
     return;
 }
+void cfio_create_from_template_c_(
+	char *path, int *len, int *template_ncid, int *ncidp, int *ierr)
+{
+    debug(DEBUG_CFIO, "path = %s, template_ncid = %d", path, *template_ncid);
+
+    path[*len] = 0;
+
+    *ierr = cfio_create_from_template(path, *template_ncid, ncidp);
+
+    return;
+}
 void cfio_def_dim_c_(
 	int *ncid, char *name, int *name_len, int *len, int *idp, int *ierr)
 {
@@ -705,6 +842,80 @@ void cfio_inq_varid_c_(int *ncid, char *var_name, int *name_len, int *varid, int
     return;
 }
 
+/**
+ * @brief: non-blocking put for fortran, the start and count are converted, 
+ *	the data is sent without copy
+ *
+ * @return: error code
+ */
+static int _iput_vara_c(
+	int ncid, int varid, int ndims,
+	int *start, int *count, int fp_type, void *fp, int *request)
+{
+    size_t *_start, *_count;
+    int i, j, ret;
+
+    _start = malloc(ndims * sizeof(size_t));
+    _count = malloc(ndims * sizeof(size_t));
+    if(NULL == _start || NULL == _count)
+    {
+	free(_start);
+	free(_count);
+	debug(DEBUG_CFIO, "malloc fail");
+	return CFIO_ERROR_MALLOC;
+    }
+    for(i = 0, j = ndims - 1; i < ndims; i ++, j --)
+    {
+	_start[i] = start[j] - 1;
+	_count[i] = count[j];
+    }
+    ret = cfio_send_iput_vara(ncid, varid, ndims, 
+	    _start, _count, fp_type, fp, request);
+    
+    free(_start);
+    free(_count);
+    return ret;
+}
+
+void cfio_iput_vara_float_c_(
+	int *ncid, int *varid, int *ndims,
+	int *start, int *count, float *fp, int *request, int *ierr)
+{
+    *ierr = _iput_vara_c(*ncid, *varid, *ndims, 
+	    start, count, CFIO_FLOAT, fp, request);
+    return;
+}
+
+void cfio_iput_vara_double_c_(
+	int *ncid, int *varid, int *ndims,
+	int *start, int *count, double *fp, int *request, int *ierr)
+{
+    *ierr = _iput_vara_c(*ncid, *varid, *ndims, 
+	    start, count, CFIO_DOUBLE, fp, request);
+    return;
+}
+
+void cfio_iput_vara_int_c_(
+	int *ncid, int *varid, int *ndims,
+	int *start, int *count, int *fp, int *request, int *ierr)
+{
+    *ierr = _iput_vara_c(*ncid, *varid, *ndims, 
+	    start, count, CFIO_INT, fp, request);
+    return;
+}
+
+void cfio_wait_c_(int *request, int *ierr)
+{
+    *ierr = cfio_wait(*request);
+    return;
+}
+
+void cfio_test_c_(int *request, int *flag, int *ierr)
+{
+    *ierr = cfio_test(*request, flag);
+    return;
+}
+
 void cfio_close_c_(
 	int *ncid, int *ierr)
 {
@@ -55,12 +55,28 @@ int cfio_init(int x_proc_num, int y_proc_num, int ratio);
  * @return 
  */
 int cfio_finalize();
+/**
+ * @brief: flush the msgs the client has buffered to the servers, the msgs 
+ *	of an io step are merged until it is called
+ *
+ * @return: error code
+ */
+int cfio_io_end();
 /**
  * @brief: get the process type, client, server or blank
  *
  * @return: the proccess type
  */
 int cfio_proc_type();
+/**
+ * @brief: get the client index, the position of the client in the 
+ *	x_proc_num * y_proc_num decomposition. it equals the rank by default, 
+ *	but not when CFIO_MAP_TOPOLOGY is set, so the model should use it 
+ *	instead of the rank to locate its block
+ *
+ * @return: the client index, -1 if the proc is not a client
+ */
+int cfio_client_index();
 /**
  * @brief: cfio_create
  *
@@ -72,6 +88,22 @@ int cfio_proc_type();
  */
 int cfio_create(
 	char *path, int cmode, int *ncidp);
+/**
+ * @brief: create a new netCDF dataset with the dims, vars and attributes of 
+ *	a template, the template is a dataset defined by cfio_create and 
+ *	cfio_enddef. the new dataset is in data mode at once, its var and dim 
+ *	ids are the same as the template's, and each client should put the 
+ *	same sub-arrays as in the template. only the latest defined 
+ *	ID_TEMPLATE_CACHE_SIZE templates are kept
+ *
+ * @param path: the file anme of the new netCDF dataset
+ * @param template_ncid: the netCDF ID of the template
+ * @param ncidp: pointer to location where returned netCDF ID is to be stored
+ *
+ * @return: 0 if success
+ */
+int cfio_create_from_template(
+	char *path, int template_ncid, int *ncidp);
 /**
  * @brief: cfio_def_dim
  *
@@ -167,6 +199,58 @@ int cfio_put_vara_float(
 int cfio_put_vara_double(
 	int ncid, int varid, int dim,
 	size_t *start, size_t *count, double *fp);
+/**
+ * @brief: cfio_iput_vara_float, non-blocking put, the data is sent from fp 
+ *	without copy, so fp can't be changed until the request is done by 
+ *	cfio_wait or cfio_test
+ *
+ * @param ncid: netCDF ID
+ * @param varid: variable ID
+ * @param dim: the dimensionality fo variable
+ * @param start: a vector of size_t intergers specifying the index in the variable
+ *	where the first of the data values will be written
+ * @param count: a vector of size_t intergers specifying the edge lengths along 
+ *	each dimension of the block of data values to be written
+ * @param fp: pinter to the data value to be written
+ * @param request: pointer to where the handle of the request is to be stored
+ *
+ * @return: 0 if success
+ */
+int cfio_iput_vara_float(
+	int ncid, int varid, int dim,
+	size_t *start, size_t *count, float *fp, int *request);
+/**
+ * @brief: cfio_iput_vara_double, see cfio_iput_vara_float
+ */
+int cfio_iput_vara_double(
+	int ncid, int varid, int dim,
+	size_t *start, size_t *count, double *fp, int *request);
+/**
+ * @brief: cfio_iput_vara_int, see cfio_iput_vara_float
+ */
+int cfio_iput_vara_int(
+	int ncid, int varid, int dim,
+	size_t *start, size_t *count, int *fp, int *request);
+/**
+ * @brief: wait until the data of a non-blocking put is sent, then the data 
+ *	array can be reused
+ *
+ * @param request: handle of the request
+ *
+ * @return: 0 if success
+ */
+int cfio_wait(int request);
+/**
+ * @brief: test whether the data of a non-blocking put is sent, the request
+ *	can't be used any more once it is done
+ *
+ * @param request: handle of the request
+ * @param flag: pointer to where 1 is to be stored if the data array can be 
+ *	reused, else 0
+ *
+ * @return: 0 if success
+ */
+int cfio_test(int request, int *flag);
 /**
  * @brief: cfio_close
  *
@@ -12,9 +12,12 @@
  *	    Email:  never.wencan@gmail.com
  *        Company:  HPC Tsinghua
  ***************************************************************************/
+#define _GNU_SOURCE
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <assert.h>
+#include <sched.h>
 
 #include "msg.h"
 #include "send.h"
@@ -27,49 +30,204 @@
 #include "cfio_types.h"
 #include "cfio_error.h"
 #include "define.h"
+#include "conf.h"
 #include "quicklist.h"
+#include "shm.h"
+#include "rma.h"
 
 static cfio_msg_t *msg_head, *merge_msg = NULL;
 static cfio_buf_t *buffer;
-static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
-static pthread_cond_t empty_cond = PTHREAD_COND_INITIALIZER;
-static pthread_cond_t full_cond = PTHREAD_COND_INITIALIZER;
-static pthread_mutex_t full_mutex = PTHREAD_MUTEX_INITIALIZER;
-
-static pthread_cond_t pause_cond = PTHREAD_COND_INITIALIZER;
-static pthread_mutex_t pause_mutex = PTHREAD_MUTEX_INITIALIZER;
+/* shared memory with the server if it is on the same node, then the buffer 
+ * is the ring in it and msgs are put into its queue instead of sent by MPI */
+static cfio_shm_t *shm = NULL;
+/* 1 if the buffer is in a window and the server pulls msgs from it, then 
+ * only the place of each msg is sent, by MPI_Isend from rma_desc */
+static int rma = 0;
+static size_t rma_desc[SEND_QUEUE_LEN][RMA_DESC_LEN];
+static MPI_Request rma_req[SEND_QUEUE_LEN];
+static size_t rma_next = 0;
 
 static pthread_t sender;
+/* 1 if msgs are sent by the sender thread */
+static int send_thread = 0;
+
+/**
+ * single-producer/single-consumer queue of msgs to be sent, the main thread 
+ * put msg at tail, the sender thread get msg from head. head and tail only 
+ * increase, index in the queue is (head or tail) % SEND_QUEUE_LEN
+ **/
+static cfio_msg_t *send_queue[SEND_QUEUE_LEN];
+static volatile size_t queue_head = 0;
+static volatile size_t queue_tail = 0;
 
 static int rank;
 
 static double start_time;
 
 static int max_msg_size;
-//static int send_pause = 0;
+static int wire_format;		/* version of the msgs sent, see msg.h */
+/* the FUNC_NC_PUT_VARA_BATCH msg being packed, NULL if none, it is added 
+ * before any other msg of the client */
+static cfio_msg_t *batch_msg = NULL;
+static int batch_ncid;
+static int batch_num;		/* amount of records in the batch msg */
 double send_time = 0;
 
-static inline int _send_msg(
+/* non-blocking puts not waited by the model */
+static qlist_head_t req_head;
+static int req_id = 0;
+
+/**
+ * @brief: put a msg at the tail of send queue, only called by the main thread
+ *
+ * @param msg: the msg
+ */
+static inline void _queue_put(cfio_msg_t *msg)
+{
+    size_t tail = queue_tail;
+    int spin = 0;
+
+    while(tail - __atomic_load_n(&queue_head, __ATOMIC_ACQUIRE) 
+	    >= SEND_QUEUE_LEN)
+    {
+	times_backoff(&spin);
+    }
+    send_queue[tail % SEND_QUEUE_LEN] = msg;
+    __atomic_store_n(&queue_tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief: get the msg at the head of send queue, wait until there is one, 
+ *	only called by the sender thread
+ *
+ * @return: the msg
+ */
+static inline cfio_msg_t *_queue_get()
+{
+    size_t head = queue_head;
+    cfio_msg_t *msg;
+    int spin = 0;
+
+    while(__atomic_load_n(&queue_tail, __ATOMIC_ACQUIRE) == head)
+    {
+	times_backoff(&spin);
+    }
+    msg = send_queue[head % SEND_QUEUE_LEN];
+    __atomic_store_n(&queue_head, head + 1, __ATOMIC_RELEASE);
+
+    return msg;
+}
+
+/**
+ * @brief: create the datatype of a msg with data, which is the msg head 
+ *	followed by the data, both are addressed from MPI_BOTTOM
+ *
+ * @param msg: the msg
+ * @param type: pointer to where the committed datatype is to be stored
+ */
+static void _data_msg_type(cfio_msg_t *msg, MPI_Datatype *type)
+{
+    int lens[2];
+    MPI_Aint disps[2];
+
+    lens[0] = msg->size - msg->data_size;
+    lens[1] = msg->data_size;
+    MPI_Get_address(msg->addr, &disps[0]);
+    MPI_Get_address(msg->data, &disps[1]);
+    MPI_Type_create_hindexed(2, lens, disps, MPI_BYTE, type);
+    MPI_Type_commit(type);
+}
+
+/**
+ * @brief: send a msg in the sender thread, and free its buffer space
+ *
+ * @param msg: the msg
+ */
+static inline void _send_msg(
 	cfio_msg_t *msg)
 {
-    MPI_Status status;
+    char *used_addr;
+    MPI_Datatype type;
+
+    debug(DEBUG_SEND, "src=%d; dst=%d; func_code = %d; size = %lu", 
+	    msg->src, msg->dst, msg->func_code, msg->size);
+    /* the head of a msg with data is not in the buffer */
+    if(NULL != msg->data)
+    {
+	_data_msg_type(msg, &type);
+	MPI_Ssend(MPI_BOTTOM, 1, type, msg->dst, msg->src, msg->comm);
+	MPI_Type_free(&type);
+	cfio_buf_close(msg->head_buf);
+	__atomic_add_fetch(msg->sent_num, 1, __ATOMIC_RELEASE);
+	return;
+    }
     MPI_Ssend(msg->addr, msg->size, MPI_BYTE, msg->dst, msg->src, 
 	    msg->comm);
-    //if(msg->func_code == FUNC_IO_END)
-    //{
-    //    printf("proc %d send point : %f\n", rank, times_cur() - start_time);
-    //}
-   //MPI_Wait(&(msg->req), &status);
 
-    pthread_mutex_lock(&full_mutex);
-    assert(check_used_addr(msg->addr, buffer));
-    buffer->used_addr = msg->addr;
-    free_buf(buffer, msg->size);
-    pthread_mutex_unlock(&full_mutex);
-    
-    pthread_cond_signal(&full_cond);
+    /* msgs are sent in order, so the buffer before the end of this msg can 
+     * be reused, only the sender thread change used_addr */
+    used_addr = msg->addr + msg->size;
+    if(used_addr >= buffer->start_addr + buffer->size)
+    {
+	used_addr -= buffer->size;
+    }
+    __atomic_store_n(&buffer->used_addr, used_addr, __ATOMIC_RELEASE);
+}
 
-    return CFIO_ERROR_NONE;
+static void* sender_thread(void *arg)
+{
+    cfio_msg_t *msg;
+    int sender_finish = 0;
+
+    while(sender_finish == 0)
+    {
+	msg = _queue_get();
+	_send_msg(msg);
+	if(msg->func_code == FUNC_FINAL)
+	{
+	    sender_finish = 1;
+	}
+	cfio_msg_free(msg);
+    }
+
+    debug(DEBUG_CFIO, "Proc %d : sender finish", rank);
+    return (void*)0;
+}
+
+/**
+ * @brief: put a msg into the queue of shared memory, its space in the ring is
+ *	given back by the server when it is decoded
+ *
+ * @param msg: the msg
+ */
+static inline void _shm_send_msg(cfio_msg_t *msg)
+{
+    int spin = 0;
+
+    while(!cfio_shm_put(shm, msg->addr - buffer->start_addr, msg->size))
+    {
+	times_backoff(&spin);
+    }
+    cfio_msg_free(msg);
+}
+
+/**
+ * @brief: send the place of a msg to the server, which pulls the msg and 
+ *	gives its space back
+ *
+ * @param msg: the msg
+ */
+static inline void _rma_send_msg(cfio_msg_t *msg)
+{
+    size_t slot = rma_next % SEND_QUEUE_LEN;
+
+    MPI_Wait(&rma_req[slot], MPI_STATUS_IGNORE);
+    rma_desc[slot][0] = msg->addr - buffer->start_addr;
+    rma_desc[slot][1] = msg->size;
+    MPI_Isend(rma_desc[slot], sizeof(rma_desc[slot]), MPI_BYTE, 
+	    msg->dst, msg->src, msg->comm, &rma_req[slot]);
+    rma_next ++;
+    cfio_msg_free(msg);
 }
 
 /*send msg in main thread*/
@@ -77,12 +235,25 @@ static inline void _main_send_msg(cfio_msg_t *msg)
 {
     debug(DEBUG_SEND, "src=%d; dst=%d; func_code = %d; size = %lu", 
 	    msg->src, msg->dst, msg->func_code, msg->size);
+    if(NULL != shm)
+    {
+	_shm_send_msg(msg);
+	return;
+    }
+    if(rma)
+    {
+	_rma_send_msg(msg);
+	return;
+    }
+    if(send_thread)
+    {
+	_queue_put(msg);
+	return;
+    }
 #ifdef async_isend
     MPI_Isend(msg->addr, msg->size, MPI_BYTE, 
 	    msg->dst, msg->src, msg->comm, &(msg->req));
     qlist_add_tail(&(msg->link), &(msg_head->link));
-#elif (defined async_send)
-    qlist_add_tail(&(msg->link), &(msg_head->link));
 #else
     //times_start();
     MPI_Ssend(msg->addr, msg->size, MPI_BYTE, msg->dst, msg->src, 
@@ -90,13 +261,14 @@ static inline void _main_send_msg(cfio_msg_t *msg)
     //send_time += times_end();
     buffer->used_addr = msg->addr;
     free_buf(buffer, msg->size);
-    free(msg);
+    cfio_msg_free(msg);
     msg = NULL;
 
     debug(DEBUG_SEND, "Success return.");
 #endif
 }
 
+static void _close_batch();
 
 static inline void _add_msg(
 	cfio_msg_t *msg)
@@ -107,6 +279,8 @@ static inline void _add_msg(
  
 	//times_start();
 
+    _close_batch();
+
     debug(DEBUG_SEND, "src=%d; dst=%d; func_code = %d; size = %lu", 
 	    msg->src, msg->dst, msg->func_code, msg->size);
     assert(msg->size <= max_msg_size);
@@ -122,10 +296,6 @@ static inline void _add_msg(
     // *TODO , it's not good to put free here
     // **/
     //free(msg);
-#ifdef async_send
-    pthread_mutex_lock(&mutex);
-#endif
-
 #ifdef disable_merge
     _main_send_msg(msg);
 #else
@@ -161,7 +331,7 @@ static inline void _add_msg(
 	    {
 		assert(msg->addr - merge_msg->addr == merge_msg->size);
 		merge_msg->size += msg->size;
-		free(msg);
+		cfio_msg_free(msg);
 	    }else
 	    {
 		//printf("send msg size : %lu\n", merge_msg->size);
@@ -191,71 +361,82 @@ static inline void _add_msg(
     //{
     //    qlist_add_tail(&(msg->link), &(msg_head->link));
     //}
-#ifdef async_send
-    pthread_mutex_unlock(&mutex);
-    pthread_cond_signal(&empty_cond);
-#endif
     //debug(DEBUG_TIME, "%f ms", times_end());
     debug(DEBUG_SEND, "success return.");
 }
 
-static inline cfio_msg_t *_get_first_msg()
+/**
+ * @brief: send the msgs merged so far
+ */
+static inline void _flush_merge_msg()
 {
-    cfio_msg_t *msg = NULL;
-    qlist_head_t *link;
-
-    pthread_mutex_lock(&mutex);
-    link = qlist_pop(&(msg_head->link));
-    if(NULL == link)
+    _close_batch();
+    if(merge_msg != NULL)
     {
-	msg = NULL;
-	pthread_cond_wait(&empty_cond, &mutex);
-    }else
-    {
-	msg = qlist_entry(link, cfio_msg_t, link);
+	_main_send_msg(merge_msg);
+	merge_msg = NULL;
     }
-    pthread_mutex_unlock(&mutex);
+}
+
+/**
+ * @brief: add a msg whose data is sent without copy, the msgs before it are 
+ *	sent first to keep the order. in main thread it is sent by MPI_Issend 
+ *	and kept in the request until done
+ *
+ * @param msg: the msg
+ * @param req: the request the msg belongs to
+ */
+static void _add_data_msg(cfio_msg_t *msg, cfio_send_req_t *req)
+{
+    MPI_Datatype type;
 
-    if(msg != NULL)
+    debug(DEBUG_SEND, "src=%d; dst=%d; func_code = %d; size = %lu", 
+	    msg->src, msg->dst, msg->func_code, msg->size);
+
+    _flush_merge_msg();
+    msg->sent_num = &(req->sent_num);
+    req->msg_num ++;
+    if(send_thread)
     {
-	debug(DEBUG_SEND, "get msg size : %lu", msg->size);
+	_queue_put(msg);
+	return;
     }
 
-    return msg;
+    _data_msg_type(msg, &type);
+    MPI_Issend(MPI_BOTTOM, 1, type, msg->dst, msg->src, msg->comm, 
+	    &(msg->req));
+    MPI_Type_free(&type);
+    qlist_add_tail(&(msg->link), req->msg_head);
 }
 
-static void* sender_thread(void *arg)
+/**
+ * @brief: bind the sender thread to a core
+ *
+ * @param core: the core id, not bind if < 0
+ */
+static void _bind_sender(int core)
 {
-    cfio_msg_t *msg;
-    int sender_finish = 0;
+    cpu_set_t cpuset;
+    int ret;
 
-    while(sender_finish == 0)
+    if(core < 0)
     {
-	msg = _get_first_msg();
-	if(msg != NULL)
-	{
-	    _send_msg(msg);
-	    if(msg->func_code == FUNC_FINAL)
-	    {
-		sender_finish = 1;
-	    }
-	    free(msg);
-	}
-	//    pthread_mutex_lock(&pause_mutex);
-	//if(send_pause == 1)
-	//{
-	//    pthread_cond_wait(&pause_cond, &pause_mutex);
-	//}
-	//    pthread_mutex_unlock(&pause_mutex);
+	return;
     }
 
-    debug(DEBUG_CFIO, "Proc %d : sender finish", rank);
-    return (void*)0;
+    CPU_ZERO(&cpuset);
+    CPU_SET(core, &cpuset);
+    if((ret = pthread_setaffinity_np(sender, sizeof(cpu_set_t), &cpuset)) != 0)
+    {
+	error("Proc %d bind sender thread to core %d fail, ret = %d.", 
+		rank, core, ret);
+    }
 }
 
 int cfio_send_init()
 {
     int error, ret, server_id, client_num_of_server;
+    int provided, i;
 
     start_time = times_cur();
 
@@ -265,20 +446,34 @@ int cfio_send_init()
 	return CFIO_ERROR_MALLOC;
     }
     INIT_QLIST_HEAD(&(msg_head->link));
+    INIT_QLIST_HEAD(&req_head);
 
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
 
+    /* msgs are freed by the sender thread, a locked pool would put a lock 
+     * on each msg of the model thread */
+    cfio_msg_init(0);
     max_msg_size = cfio_msg_get_max_size(rank);
+    wire_format = cfio_conf_get_wire_format();
     
-    buffer = cfio_buf_open(SEND_BUF_SIZE, &error);
-
-#ifdef async_send
-    if( (ret = pthread_create(&sender,NULL,sender_thread,NULL))<0  )
+    shm = cfio_shm_get_client(rank);
+    rma = (NULL != cfio_rma_get_buf());
+    if(NULL != shm)
+    {
+	buffer = cfio_buf_attach(cfio_shm_ring(shm), 
+		cfio_shm_get_buf_size(rank), &error);
+    }else if(rma)
+    {
+	for(i = 0; i < SEND_QUEUE_LEN; i ++)
+	{
+	    rma_req[i] = MPI_REQUEST_NULL;
+	}
+	buffer = cfio_buf_attach(cfio_rma_get_buf(), 
+		cfio_rma_get_buf_size(rank), &error);
+    }else
     {
-        error("Thread Writer create error()");
-        return CFIO_ERROR_PTHREAD_CREATE;
+	buffer = cfio_buf_open(SEND_BUF_SIZE, &error);
     }
-#endif
 
     if(NULL == buffer)
     {
@@ -286,6 +481,32 @@ int cfio_send_init()
 	return error;
     }
 
+    /* putting a msg into shared memory or sending its place costs no more 
+     * than queueing it to the sender thread */
+    if(cfio_conf_get_send_thread() && NULL == shm && !rma)
+    {
+	/* the sender thread call MPI while the model may call MPI in the main
+	 * thread at the same time */
+	MPI_Query_thread(&provided);
+	if(provided < MPI_THREAD_MULTIPLE)
+	{
+	    if(0 == rank)
+	    {
+		error("MPI_THREAD_MULTIPLE is not provided, msg will be sent "
+			"in main thread.");
+	    }
+	}else
+	{
+	    if((ret = pthread_create(&sender, NULL, sender_thread, NULL)) != 0)
+	    {
+		error("Thread Sender create error()");
+		return CFIO_ERROR_PTHREAD_CREATE;
+	    }
+	    _bind_sender(cfio_conf_get_send_core());
+	    send_thread = 1;
+	}
+    }
+
 
     return CFIO_ERROR_NONE;
 }
@@ -295,21 +516,35 @@ int cfio_send_final()
     cfio_msg_t *msg, *next;
     MPI_Status status;
 
-#ifdef async_send
-    pthread_join(sender, NULL);
-#endif
+    cfio_send_req_t *req, *req_next;
+
+    if(send_thread)
+    {
+	pthread_join(sender, NULL);
+	send_thread = 0;
+    }
+
+    /* the model may not wait all its requests */
+    qlist_for_each_entry_safe(req, req_next, &req_head, link)
+    {
+	cfio_send_req_wait(req->id);
+    }
     
     if(msg_head != NULL)
     {
         qlist_for_each_entry_safe(msg, next, &(msg_head->link), link)
         {
             MPI_Wait(&msg->req, &status);
-            free(msg);
+            cfio_msg_free(msg);
         }
         free(msg_head);
         msg_head = NULL;
     }
 
+    if(rma)
+    {
+	MPI_Waitall(SEND_QUEUE_LEN, rma_req, MPI_STATUSES_IGNORE);
+    }
     
     if(msg_head != NULL)
     {
@@ -318,6 +553,7 @@ int cfio_send_final()
     }
 	
     cfio_buf_close(buffer);
+    cfio_msg_final();
 
     //printf("send time : %f\n", send_time);
 
@@ -343,17 +579,100 @@ static void cfio_send_client_buf_free()
 	MPI_Wait(&msg->req, &status);
 	buffer->used_addr = msg->addr;
 	free_buf(buffer, msg->size);
-	free(msg);
+	cfio_msg_free(msg);
     }
 #endif
 
-#ifdef async_send
-    pthread_cond_wait(&full_cond, &full_mutex);
-#endif
+    /* space is freed by the server */
+    if(NULL != shm)
+    {
+	sched_yield();
+	buffer->used_addr = buffer->start_addr + cfio_shm_released(shm);
+	return;
+    }
+    if(rma)
+    {
+	sched_yield();
+	buffer->used_addr = buffer->start_addr + cfio_rma_released();
+	return;
+    }
+
+    /* space is freed by the sender thread, just wait */
+    if(send_thread)
+    {
+	sched_yield();
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+    }
 
     return;
 }
 
+/**
+ * @brief: get the size of a msg
+ *
+ * @param body_size: size of the fields after the func code
+ *
+ * @return: size of the msg, in v2 it is rounded up to CFIO_MSG_ALIGN so the
+ *	next msg put after it starts aligned
+ */
+static inline size_t _msg_size(size_t body_size)
+{
+    if(CFIO_MSG_V1 == wire_format)
+    {
+	return cfio_buf_data_size(sizeof(size_t)) + 
+	    cfio_buf_data_size(sizeof(uint32_t)) + body_size;
+    }
+
+    return cfio_msg_align(CFIO_MSG_HEAD_SIZE + body_size);
+}
+
+/**
+ * @brief: pack the head of a msg, its size and func code in v1, the fixed head
+ *	in v2
+ *
+ * @param msg: the msg, its size is set
+ * @param code: the func code
+ * @param head: the fields of a put_vara in the head, NULL for other msgs, 
+ *	not used in v1
+ * @param buf: the buffer which the msg is packed in
+ */
+static inline void _pack_head(cfio_msg_t *msg, uint32_t code,
+	cfio_msg_head_t *head, cfio_buf_t *buf)
+{
+    cfio_msg_head_t _head;
+
+    if(CFIO_MSG_V1 == wire_format)
+    {
+	cfio_buf_pack_data(&msg->size, sizeof(size_t), buf);
+	cfio_buf_pack_data(&code, sizeof(uint32_t), buf);
+	return;
+    }
+
+    if(NULL == head)
+    {
+	memset(&_head, 0, sizeof(cfio_msg_head_t));
+	_head.body_off = CFIO_MSG_HEAD_SIZE;
+	head = &_head;
+    }
+    head->size = msg->size;
+    head->code = code | ((uint32_t)CFIO_MSG_V2 << CFIO_MSG_VERSION_SHIFT);
+    cfio_buf_pack_data(head, sizeof(cfio_msg_head_t), buf);
+    use_buf(buf, CFIO_MSG_HEAD_SIZE - sizeof(cfio_msg_head_t));
+}
+
+/**
+ * @brief: skip the padding at the end of a msg packed in a buffer
+ *
+ * @param msg: the msg
+ * @param buf: the buffer which the msg is packed in
+ */
+static inline void _pack_end(cfio_msg_t *msg, cfio_buf_t *buf)
+{
+    size_t packed = (buf->size + buf->free_addr - msg->addr) % buf->size;
+
+    use_buf(buf, msg->size - packed);
+}
+
 int cfio_send_create(
 	char *path, int cmode, int ncid)
 {
@@ -364,28 +683,21 @@ int cfio_send_create(
     msg->src = rank;
     msg->func_code = FUNC_NC_CREATE;
 
-    msg->size = cfio_buf_data_size(sizeof(size_t));
-    msg->size += cfio_buf_data_size(sizeof(uint32_t));
-    msg->size += cfio_buf_str_size(path);
+    msg->size = cfio_buf_str_size(path);
     msg->size += cfio_buf_data_size(sizeof(int));
     msg->size += cfio_buf_data_size(sizeof(int));
+    msg->size = _msg_size(msg->size);
 
-#ifdef async_send
-    pthread_mutex_lock(&full_mutex);
-#endif
     ensure_free_space(buffer, msg->size, cfio_send_client_buf_free);
-#ifdef async_send
-    pthread_mutex_unlock(&full_mutex);
-#endif
 
     msg->addr = buffer->free_addr;
 
-    cfio_buf_pack_data(&msg->size, sizeof(size_t) , buffer);
-    cfio_buf_pack_data(&code, sizeof(uint32_t) , buffer);
+    _pack_head(msg, code, NULL, buffer);
     cfio_buf_pack_str(path, buffer);
     cfio_buf_pack_data(&cmode, sizeof(int), buffer);
     cfio_buf_pack_data(&ncid, sizeof(int), buffer);
 
+    _pack_end(msg, buffer);
     cfio_map_forwarding(msg);
     _add_msg(msg);
     
@@ -394,6 +706,40 @@ int cfio_send_create(
     return CFIO_ERROR_NONE;
 }
 
+int cfio_send_create_from_template(
+	char *path, int ncid, int template_ncid)
+{
+    uint32_t code = FUNC_NC_CREATE_TEMPLATE;
+    cfio_msg_t *msg;
+
+    msg = cfio_msg_create();
+    msg->src = rank;
+    msg->func_code = FUNC_NC_CREATE_TEMPLATE;
+
+    msg->size = cfio_buf_str_size(path);
+    msg->size += cfio_buf_data_size(sizeof(int));
+    msg->size += cfio_buf_data_size(sizeof(int));
+    msg->size = _msg_size(msg->size);
+
+    ensure_free_space(buffer, msg->size, cfio_send_client_buf_free);
+
+    msg->addr = buffer->free_addr;
+
+    _pack_head(msg, code, NULL, buffer);
+    cfio_buf_pack_str(path, buffer);
+    cfio_buf_pack_data(&ncid, sizeof(int), buffer);
+    cfio_buf_pack_data(&template_ncid, sizeof(int), buffer);
+
+    _pack_end(msg, buffer);
+    cfio_map_forwarding(msg);
+    _add_msg(msg);
+    
+    debug(DEBUG_SEND, "path = %s; ncid = %d, template_ncid = %d", 
+	    path, ncid, template_ncid);
+
+    return CFIO_ERROR_NONE;
+}
+
 /**
  *pack msg function
  **/
@@ -407,30 +753,23 @@ int cfio_send_def_dim(
     msg->src = rank;
     msg->func_code = FUNC_NC_DEF_DIM;
     
-    msg->size = cfio_buf_data_size(sizeof(size_t));
-    msg->size += cfio_buf_data_size(sizeof(uint32_t));
-    msg->size += cfio_buf_data_size(sizeof(int));
+    msg->size = cfio_buf_data_size(sizeof(int));
     msg->size += cfio_buf_str_size(name);
     msg->size += cfio_buf_data_size(sizeof(size_t));
     msg->size += cfio_buf_data_size(sizeof(int));
+    msg->size = _msg_size(msg->size);
 
-#ifdef async_send
-    pthread_mutex_lock(&full_mutex);
-#endif
     ensure_free_space(buffer, msg->size, cfio_send_client_buf_free);
-#ifdef async_send
-    pthread_mutex_unlock(&full_mutex);
-#endif
     
     msg->addr = buffer->free_addr;
 
-    cfio_buf_pack_data(&msg->size, sizeof(size_t) , buffer);
-    cfio_buf_pack_data(&code, sizeof(uint32_t), buffer);
+    _pack_head(msg, code, NULL, buffer);
     cfio_buf_pack_data(&ncid, sizeof(int), buffer);
     cfio_buf_pack_str(name, buffer);
     cfio_buf_pack_data(&len, sizeof(size_t), buffer);
     cfio_buf_pack_data(&dimid, sizeof(int), buffer);
 
+    _pack_end(msg, buffer);
     cfio_map_forwarding(msg);
     _add_msg(msg);
     
@@ -451,28 +790,20 @@ int cfio_send_def_var(
     msg->src = rank;
     msg->func_code = FUNC_NC_DEF_VAR;
     
-    msg->size = cfio_buf_data_size(sizeof(size_t));
-    msg->size += cfio_buf_data_size(sizeof(uint32_t));
-    msg->size += cfio_buf_data_size(sizeof(int));
+    msg->size = cfio_buf_data_size(sizeof(int));
     msg->size += cfio_buf_str_size(name);
     msg->size += cfio_buf_data_size(sizeof(cfio_type));
     msg->size += cfio_buf_data_array_size(ndims, sizeof(int));
     msg->size += cfio_buf_data_array_size(ndims, sizeof(size_t));
     msg->size += cfio_buf_data_array_size(ndims, sizeof(size_t));
     msg->size += cfio_buf_data_size(sizeof(int));
+    msg->size = _msg_size(msg->size);
 
-#ifdef async_send
-    pthread_mutex_lock(&full_mutex);
-#endif
     ensure_free_space(buffer, msg->size, cfio_send_client_buf_free);
-#ifdef async_send
-    pthread_mutex_unlock(&full_mutex);
-#endif
     
     msg->addr = buffer->free_addr;
 
-    cfio_buf_pack_data(&msg->size, sizeof(size_t) , buffer);
-    cfio_buf_pack_data(&code , sizeof(uint32_t), buffer);
+    _pack_head(msg, code, NULL, buffer);
     cfio_buf_pack_data(&ncid, sizeof(int), buffer);
     cfio_buf_pack_str(name, buffer);
     cfio_buf_pack_data(&xtype, sizeof(cfio_type), buffer);
@@ -481,6 +812,7 @@ int cfio_send_def_var(
     cfio_buf_pack_data_array(count, ndims, sizeof(size_t), buffer);
     cfio_buf_pack_data(&varid, sizeof(int), buffer);
 
+    _pack_end(msg, buffer);
     cfio_map_forwarding(msg);
     _add_msg(msg);
     
@@ -489,6 +821,45 @@ int cfio_send_def_var(
     return CFIO_ERROR_NONE;
 }
 
+int cfio_send_def_var_decomp(
+	int ncid, cfio_type xtype, int ndims, 
+	size_t *start, size_t *count, int varid)
+{
+    uint32_t code = FUNC_NC_DEF_VAR_DECOMP;
+    cfio_msg_t *msg;
+
+    msg = cfio_msg_create();
+    msg->src = rank;
+    msg->func_code = FUNC_NC_DEF_VAR_DECOMP;
+    
+    msg->size = cfio_buf_data_size(sizeof(int));
+    msg->size += cfio_buf_data_size(sizeof(cfio_type));
+    msg->size += cfio_buf_data_array_size(ndims, sizeof(size_t));
+    msg->size += cfio_buf_data_array_size(ndims, sizeof(size_t));
+    msg->size += cfio_buf_data_size(sizeof(int));
+    msg->size = _msg_size(msg->size);
+
+    ensure_free_space(buffer, msg->size, cfio_send_client_buf_free);
+    
+    msg->addr = buffer->free_addr;
+
+    _pack_head(msg, code, NULL, buffer);
+    cfio_buf_pack_data(&ncid, sizeof(int), buffer);
+    cfio_buf_pack_data(&xtype, sizeof(cfio_type), buffer);
+    cfio_buf_pack_data_array(start, ndims, sizeof(size_t), buffer);
+    cfio_buf_pack_data_array(count, ndims, sizeof(size_t), buffer);
+    cfio_buf_pack_data(&varid, sizeof(int), buffer);
+
+    _pack_end(msg, buffer);
+    cfio_map_forwarding(msg);
+    _add_msg(msg);
+    
+    debug(DEBUG_SEND, "ncid = %d, varid = %d, ndims = %u", 
+	    ncid, varid, ndims);
+
+    return CFIO_ERROR_NONE;
+}
+
 int cfio_send_put_att(
 	int ncid, int varid, char *name, 
 	cfio_type xtype, size_t len, void *op)
@@ -502,33 +873,25 @@ int cfio_send_put_att(
     msg->func_code = FUNC_PUT_ATT;
 
     cfio_types_size(att_size, xtype);
-
-    msg->size = cfio_buf_data_size(sizeof(size_t));
-    msg->size += cfio_buf_data_size(sizeof(uint32_t));
-    msg->size += cfio_buf_data_size(sizeof(int));
+    msg->size = cfio_buf_data_size(sizeof(int));
     msg->size += cfio_buf_data_size(sizeof(int));
     msg->size += cfio_buf_str_size(name);
     msg->size += cfio_buf_data_size(sizeof(cfio_type));
     msg->size += cfio_buf_data_array_size(len, att_size);
+    msg->size = _msg_size(msg->size);
 
-#ifdef async_send
-    pthread_mutex_lock(&full_mutex);
-#endif
     ensure_free_space(buffer, msg->size, cfio_send_client_buf_free);
-#ifdef async_send
-    pthread_mutex_unlock(&full_mutex);
-#endif
 
     msg->addr = buffer->free_addr;
 
-    cfio_buf_pack_data(&msg->size, sizeof(size_t) , buffer);
-    cfio_buf_pack_data(&code , sizeof(uint32_t), buffer);
+    _pack_head(msg, code, NULL, buffer);
     cfio_buf_pack_data(&ncid, sizeof(int), buffer);
     cfio_buf_pack_data(&varid, sizeof(int), buffer);
     cfio_buf_pack_str(name, buffer);
     cfio_buf_pack_data(&xtype, sizeof(cfio_type), buffer);
     cfio_buf_pack_data_array(op, len, att_size, buffer);
 
+    _pack_end(msg, buffer);
     cfio_map_forwarding(msg);
     _add_msg(msg);
     
@@ -549,24 +912,17 @@ int cfio_send_enddef(
     msg->src = rank;
     msg->func_code = FUNC_NC_ENDDEF;
     
-    msg->size = cfio_buf_data_size(sizeof(size_t));
-    msg->size += cfio_buf_data_size(sizeof(uint32_t));
-    msg->size += cfio_buf_data_size(sizeof(int));
+    msg->size = cfio_buf_data_size(sizeof(int));
+    msg->size = _msg_size(msg->size);
     
-#ifdef async_send
-    pthread_mutex_lock(&full_mutex);
-#endif
     ensure_free_space(buffer, msg->size, cfio_send_client_buf_free);
-#ifdef async_send
-    pthread_mutex_unlock(&full_mutex);
-#endif
     
     msg->addr = buffer->free_addr;
 
-    cfio_buf_pack_data(&msg->size, sizeof(size_t) , buffer);
-    cfio_buf_pack_data(&code, sizeof(uint32_t), buffer);
+    _pack_head(msg, code, NULL, buffer);
     cfio_buf_pack_data(&ncid, sizeof(int), buffer);
 
+    _pack_end(msg, buffer);
     cfio_map_forwarding(msg);
     _add_msg(msg);
     
@@ -575,15 +931,327 @@ int cfio_send_enddef(
     return CFIO_ERROR_NONE;
 }
 
-int cfio_send_put_vara(
+/**
+ * @brief: get the size of a put_vara or put_vara_chunk msg before its data
+ *
+ * @param code: FUNC_NC_PUT_VARA or FUNC_NC_PUT_VARA_CHUNK
+ * @param ndims: dimensionality of the variable
+ *
+ * @return: the size, in v2 it is the aligned offset of the data
+ */
+static inline size_t _put_vara_head_size(uint32_t code, int ndims)
+{
+    size_t size;
+
+    if(CFIO_MSG_V1 == wire_format)
+    {
+	size = _msg_size(0);
+	size += cfio_buf_data_size(sizeof(int));
+	size += cfio_buf_data_size(sizeof(int));
+	size += cfio_buf_data_array_size(ndims, sizeof(size_t));
+	size += cfio_buf_data_array_size(ndims, sizeof(size_t));
+	size += cfio_buf_data_size(sizeof(int));
+	if(FUNC_NC_PUT_VARA_CHUNK == code)
+	{
+	    size += cfio_buf_data_size(sizeof(size_t));
+	}
+	/* the len of the data array */
+	size += sizeof(int);
+	return size;
+    }
+
+    return cfio_msg_align(CFIO_MSG_HEAD_SIZE + 2 * ndims * sizeof(size_t));
+}
+
+/**
+ * @brief: get the size of a put_vara or put_vara_chunk msg packed in the 
+ *	buffer
+ *
+ * @param head_size: size of the msg before its data
+ * @param data_size: size of the data
+ *
+ * @return: the size
+ */
+static inline size_t _put_vara_size(size_t head_size, size_t data_size)
+{
+    if(CFIO_MSG_V1 == wire_format)
+    {
+	return head_size + data_size;
+    }
+
+    return cfio_msg_align(head_size + data_size);
+}
+
+/**
+ * @brief: get the size of a record in a batch msg
+ *
+ * @param ndims: dimensionality of the variable
+ * @param data_size: size of the data
+ * @param data_off: pointer to where the offset of the data in the record is
+ *	to be stored
+ *
+ * @return: the size
+ */
+static inline size_t _batch_rec_size(int ndims, size_t data_size, 
+	size_t *data_off)
+{
+    *data_off = cfio_msg_align(sizeof(cfio_msg_rec_t) + 
+	    2 * ndims * sizeof(size_t));
+
+    return cfio_msg_align(*data_off + data_size);
+}
+
+/**
+ * @brief: end the batch msg being packed and add it
+ */
+static void _close_batch()
+{
+    cfio_msg_t *msg = batch_msg;
+    cfio_msg_head_t *head;
+
+    if(NULL == msg)
+    {
+	return;
+    }
+    batch_msg = NULL;
+
+    /* the head is packed in one piece at the start of the msg */
+    head = (cfio_msg_head_t *)msg->addr;
+    head->size = msg->size;
+    head->data_len = batch_num;
+
+    debug(DEBUG_SEND, "ncid = %d, rec_num = %d, size = %lu", batch_ncid, 
+	    batch_num, msg->size);
+
+    cfio_map_forwarding(msg);
+    _add_msg(msg);
+}
+
+/**
+ * @brief: pack a small put_vara as a record of the batch msg of its nc, a new
+ *	batch msg is started if there is none, or the record does not fit in 
+ *	the one being packed
+ *
+ * @param ncid: netCDF ID
+ * @param varid: variable ID
+ * @param ndims: dimensionality of the variable
+ * @param start: start index of the data
+ * @param count: count of the data
+ * @param fp_type: type of data
+ * @param data_len: amount of elements of the data
+ * @param data_size: size of the data
+ * @param fp: the data
+ *
+ * @return: error code
+ */
+static int _batch_put_vara(
 	int ncid, int varid, int ndims,
 	size_t *start, size_t *count, 
-	int fp_type, void *fp)
+	int fp_type, size_t data_len, size_t data_size, char *fp)
 {
-    int i;
-    size_t data_len;
-    uint32_t code = FUNC_NC_PUT_VARA;
     cfio_msg_t *msg;
+    cfio_msg_head_t head;
+    cfio_msg_rec_t rec;
+    size_t rec_size, data_off;
+
+    rec_size = _batch_rec_size(ndims, data_size, &data_off);
+
+    /* a msg never wraps in the buffer */
+    if(NULL != batch_msg && (ncid != batch_ncid || 
+		batch_msg->size + rec_size > max_msg_size ||
+		batch_msg->addr + batch_msg->size + rec_size > 
+		buffer->start_addr + buffer->size ||
+		rec_size > free_buf_size(buffer)))
+    {
+	_close_batch();
+    }
+
+    if(NULL == batch_msg)
+    {
+	/* the batch is the only msg not sent while it is packed */
+	_flush_merge_msg();
+
+	msg = cfio_msg_create();
+	msg->src = rank;
+	msg->func_code = FUNC_NC_PUT_VARA_BATCH;
+	msg->size = CFIO_MSG_HEAD_SIZE;
+
+	ensure_free_space(buffer, msg->size + rec_size, 
+		cfio_send_client_buf_free);
+
+	msg->addr = buffer->free_addr;
+
+	memset(&head, 0, sizeof(cfio_msg_head_t));
+	head.body_off = CFIO_MSG_HEAD_SIZE;
+	head.ncid = ncid;
+	_pack_head(msg, FUNC_NC_PUT_VARA_BATCH, &head, buffer);
+
+	batch_msg = msg;
+	batch_ncid = ncid;
+	batch_num = 0;
+    }
+
+    rec.size = rec_size;
+    rec.data_off = data_off;
+    rec.varid = varid;
+    rec.ndims = ndims;
+    rec.type = fp_type;
+    rec.data_len = data_len;
+    cfio_buf_pack_data(&rec, sizeof(cfio_msg_rec_t), buffer);
+    if(ndims > 0)
+    {
+	cfio_buf_pack_data(start, ndims * sizeof(size_t), buffer);
+	cfio_buf_pack_data(count, ndims * sizeof(size_t), buffer);
+    }
+    use_buf(buffer, data_off - sizeof(cfio_msg_rec_t) - 
+	    2 * ndims * sizeof(size_t));
+    if(data_size > 0)
+    {
+	cfio_buf_pack_data(fp, data_size, buffer);
+    }
+    use_buf(buffer, rec_size - data_off - data_size);
+
+    batch_msg->size += rec_size;
+    batch_num ++;
+
+    debug(DEBUG_SEND, "ncid = %d, varid = %d, ndims = %d, data_len = %lu in "
+	    "batch", ncid, varid, ndims, data_len);
+
+    return CFIO_ERROR_NONE;
+}
+
+/**
+ * @brief: pack a put_vara or put_vara_chunk msg and add it
+ *
+ * @param code: FUNC_NC_PUT_VARA or FUNC_NC_PUT_VARA_CHUNK
+ * @param ncid: netCDF ID
+ * @param varid: variable ID
+ * @param ndims: dimensionality of the variable
+ * @param start: start index of the data in the msg
+ * @param count: count of the data in the msg
+ * @param fp_type: type of data
+ * @param ele_size: size of each element
+ * @param data_len: amount of elements in the msg
+ * @param total_len: amount of elements of the whole put_vara, only packed in
+ *	FUNC_NC_PUT_VARA_CHUNK
+ * @param fp: data in the msg
+ * @param req: the non-blocking put the msg belongs to, the data is not 
+ *	copied if it is not small, NULL if it is a blocking put
+ *
+ * @return: error code
+ */
+static int _send_put_vara_msg(
+	uint32_t code, int ncid, int varid, int ndims,
+	size_t *start, size_t *count, 
+	int fp_type, size_t ele_size, size_t data_len, size_t total_len, 
+	char *fp, cfio_send_req_t *req)
+{
+    cfio_msg_t *msg;
+    cfio_msg_head_t head;
+    cfio_buf_t *buf = buffer;
+    int error, len = data_len;
+    size_t head_size, data_size = data_len * ele_size;
+
+    msg = cfio_msg_create();
+    msg->src = rank;
+    msg->func_code = code;
+    
+    head_size = _put_vara_head_size(code, ndims);
+    msg->size = _put_vara_size(head_size, data_size);
+
+    if(NULL != req && data_size >= SEND_ZERO_COPY_MIN_SIZE)
+    {
+	/* only the head is packed, in its own buffer, since the buffer space
+	 * is freed in msg order while the msg may be done later */
+	msg->data = fp;
+	msg->data_size = data_size;
+	msg->size = head_size + data_size;
+	msg->head_buf = cfio_buf_open(head_size + 1, &error);
+	if(NULL == msg->head_buf)
+	{
+	    cfio_msg_free(msg);
+	    return error;
+	}
+	buf = msg->head_buf;
+    }else
+    {
+	ensure_free_space(buffer, msg->size, cfio_send_client_buf_free);
+    }
+
+    msg->addr = buf->free_addr;
+
+    if(CFIO_MSG_V1 == wire_format)
+    {
+	_pack_head(msg, code, NULL, buf);
+	cfio_buf_pack_data(&ncid, sizeof(int), buf);
+	cfio_buf_pack_data(&varid, sizeof(int), buf);
+	cfio_buf_pack_data_array(start, ndims, sizeof(size_t), buf);
+	cfio_buf_pack_data_array(count, ndims, sizeof(size_t), buf);
+	cfio_buf_pack_data(&fp_type, sizeof(int), buf);
+	if(FUNC_NC_PUT_VARA_CHUNK == code)
+	{
+	    cfio_buf_pack_data(&total_len, sizeof(size_t), buf);
+	}
+	/* the array len, the data follows it */
+	cfio_buf_pack_data(&len, sizeof(int), buf);
+    }else
+    {
+	/* all fields are in the head, the data starts at an aligned offset 
+	 * after the start and count */
+	memset(&head, 0, sizeof(cfio_msg_head_t));
+	head.body_off = CFIO_MSG_HEAD_SIZE;
+	head.data_off = head_size;
+	head.ncid = ncid;
+	head.varid = varid;
+	head.ndims = ndims;
+	head.type = fp_type;
+	head.data_len = len;
+	head.total_len = total_len;
+	_pack_head(msg, code, &head, buf);
+	if(ndims > 0)
+	{
+	    cfio_buf_pack_data(start, ndims * sizeof(size_t), buf);
+	    cfio_buf_pack_data(count, ndims * sizeof(size_t), buf);
+	}
+	use_buf(buf, head_size - CFIO_MSG_HEAD_SIZE - 
+		2 * ndims * sizeof(size_t));
+    }
+
+    cfio_map_forwarding(msg);
+    if(NULL != msg->data)
+    {
+	/* the data follows the head on the wire */
+	_add_data_msg(msg, req);
+    }else
+    {
+	if(data_size > 0)
+	{
+	    cfio_buf_pack_data(fp, data_size, buf);
+	}
+	_pack_end(msg, buf);
+	_add_msg(msg);
+    }
+
+    return CFIO_ERROR_NONE;
+}
+
+/**
+ * @brief: send a put_vara, split it into chunks if it is larger than the max
+ *	msg size
+ *
+ * @param req: the non-blocking put, NULL if it is a blocking put
+ *
+ * @return: error code
+ */
+static int _send_put_vara(
+	int ncid, int varid, int ndims,
+	size_t *start, size_t *count, 
+	int fp_type, void *fp, cfio_send_req_t *req)
+{
+    int i, split, ret = CFIO_ERROR_NONE;
+    size_t data_len, ele_size, head_size, rec_size, data_off;
+    size_t chunk_len, inner_len, step, offset;
+    size_t *chunk_start = NULL, *chunk_count = NULL, *index = NULL;
     
     //times_start();
 
@@ -602,85 +1270,256 @@ int cfio_send_put_vara(
     {
 	data_len *= count[i]; 
     }
-    
-    msg = cfio_msg_create();
-    msg->src = rank;
-    msg->func_code = FUNC_NC_PUT_VARA;
-    
-    msg->size = cfio_buf_data_size(sizeof(size_t));
-    msg->size += cfio_buf_data_size(sizeof(uint32_t));
-    msg->size += cfio_buf_data_size(sizeof(int));
-    msg->size += cfio_buf_data_size(sizeof(int));
-    msg->size += cfio_buf_data_array_size(ndims, sizeof(size_t));
-    msg->size += cfio_buf_data_array_size(ndims, sizeof(size_t));
-    msg->size += cfio_buf_data_size(sizeof(int));
-    switch(fp_type)
+    cfio_types_size(ele_size, fp_type);
+
+    if(CFIO_MSG_V2 == wire_format)
     {
-	case CFIO_BYTE :
-	    msg->size += cfio_buf_data_array_size(data_len, 1);
-	    break;
-	case CFIO_CHAR :
-	    msg->size += cfio_buf_data_array_size(data_len, sizeof(char));
-	    break;
-	case CFIO_SHORT :
-	    msg->size += cfio_buf_data_array_size(data_len, sizeof(short));
-	    break;
-	case CFIO_INT :
-	    msg->size += cfio_buf_data_array_size(data_len, sizeof(int));
-	    break;
-	case CFIO_FLOAT :
-	    msg->size += cfio_buf_data_array_size(data_len, sizeof(float));
-	    break;
-	case CFIO_DOUBLE :
-	    msg->size += cfio_buf_data_array_size(data_len, sizeof(double));
-	    break;
+	rec_size = _batch_rec_size(ndims, data_len * ele_size, &data_off);
+	if(rec_size <= SEND_BATCH_MAX_SIZE && 
+		CFIO_MSG_HEAD_SIZE + rec_size <= max_msg_size)
+	{
+	    return _batch_put_vara(ncid, varid, ndims, start, count, fp_type,
+		    data_len, data_len * ele_size, fp);
+	}
     }
-	    
-#ifdef async_send
-    pthread_mutex_lock(&full_mutex);
-#endif
-    ensure_free_space(buffer, msg->size, cfio_send_client_buf_free);
-#ifdef async_send
-    pthread_mutex_unlock(&full_mutex);
-#endif
 
-    msg->addr = buffer->free_addr;
+    head_size = _put_vara_head_size(FUNC_NC_PUT_VARA, ndims);
+    if(_put_vara_size(head_size, data_len * ele_size) <= max_msg_size)
+    {
+	debug(DEBUG_SEND, "ncid = %d, varid = %d, ndims = %d, data_len = %lu", 
+		ncid, varid, ndims, data_len);
+	return _send_put_vara_msg(FUNC_NC_PUT_VARA, ncid, varid, ndims, 
+		start, count, fp_type, ele_size, data_len, data_len, fp, req);
+    }
 
-    cfio_buf_pack_data(&msg->size, sizeof(size_t) , buffer);
-    cfio_buf_pack_data(&code, sizeof(uint32_t), buffer);
-    cfio_buf_pack_data(&ncid, sizeof(int), buffer);
-    cfio_buf_pack_data(&varid, sizeof(int), buffer);
-    cfio_buf_pack_data_array(start, ndims, sizeof(size_t), buffer);
-    cfio_buf_pack_data_array(count, ndims, sizeof(size_t), buffer);
-    cfio_buf_pack_data(&fp_type, sizeof(int), buffer);
-    switch(fp_type)
+    /**
+     * too large for one msg, split the hyperslab into chunks, each chunk is 
+     * contiguous in fp : one index in dims before split, at most step indexes 
+     * in dim split, and the whole count in dims after split
+     **/
+    head_size = _put_vara_head_size(FUNC_NC_PUT_VARA_CHUNK, ndims);
+    /* a v2 msg is rounded up to CFIO_MSG_ALIGN */
+    chunk_len = (CFIO_MSG_V1 == wire_format) ? max_msg_size : 
+	max_msg_size & ~(CFIO_MSG_ALIGN - 1);
+    chunk_len = (chunk_len - head_size) / ele_size;
+    assert(chunk_len > 0);
+
+    split = ndims - 1;
+    inner_len = 1;
+    while(split > 0 && inner_len * count[split] <= chunk_len)
     {
-	case CFIO_BYTE :
-	    cfio_buf_pack_data_array(fp, data_len, 1, buffer);
-	    break;
-	case CFIO_CHAR :
-	    cfio_buf_pack_data_array(fp, data_len, sizeof(char), buffer);
-	    break;
-	case CFIO_SHORT :
-	    cfio_buf_pack_data_array(fp, data_len, sizeof(short), buffer);
-	    break;
-	case CFIO_INT :
-	    cfio_buf_pack_data_array(fp, data_len, sizeof(int), buffer);
-	    break;
-	case CFIO_FLOAT :
-	    cfio_buf_pack_data_array(fp, data_len, sizeof(float), buffer);
-	    break;
-	case CFIO_DOUBLE :
-	    cfio_buf_pack_data_array(fp, data_len, sizeof(double), buffer);
+	inner_len *= count[split];
+	split --;
+    }
+    step = chunk_len / inner_len;
+
+    chunk_start = malloc(ndims * sizeof(size_t));
+    chunk_count = malloc(ndims * sizeof(size_t));
+    index = malloc(ndims * sizeof(size_t));
+    if(NULL == chunk_start || NULL == chunk_count || NULL == index)
+    {
+	error("malloc for chunk fail.");
+	free(chunk_start);
+	free(chunk_count);
+	free(index);
+	return CFIO_ERROR_MALLOC;
+    }
+    for(i = 0; i < ndims; i ++)
+    {
+	index[i] = 0;
+	chunk_start[i] = start[i];
+	chunk_count[i] = (i < split) ? 1 : count[i];
+    }
+
+    while(index[0] < count[0])
+    {
+	offset = 0;
+	for(i = 0; i <= split; i ++)
+	{
+	    offset = offset * count[i] + index[i];
+	    chunk_start[i] = start[i] + index[i];
+	}
+	offset *= inner_len;
+	chunk_count[split] = count[split] - index[split] < step ? 
+	    count[split] - index[split] : step;
+
+	if((ret = _send_put_vara_msg(FUNC_NC_PUT_VARA_CHUNK, ncid, varid, 
+			ndims, chunk_start, chunk_count, fp_type, ele_size, 
+			chunk_count[split] * inner_len, data_len, 
+			(char *)fp + offset * ele_size, req)) < 0)
+	{
 	    break;
+	}
+
+	index[split] += step;
+	i = split;
+	while(i > 0 && index[i] >= count[i])
+	{
+	    index[i] = 0;
+	    i --;
+	    index[i] ++;
+	}
     }
 
-    cfio_map_forwarding(msg);
-    _add_msg(msg);
+    free(chunk_start);
+    free(chunk_count);
+    free(index);
     
     //debug(DEBUG_TIME, "%f ms", times_end());
-    debug(DEBUG_SEND, "ncid = %d, varid = %d, ndims = %d, data_len = %lu", 
-	    ncid, varid, ndims, data_len);
+    debug(DEBUG_SEND, "ncid = %d, varid = %d, ndims = %d, data_len = %lu in "
+	    "chunks", ncid, varid, ndims, data_len);
+
+    return ret;
+}
+
+int cfio_send_put_vara(
+	int ncid, int varid, int ndims,
+	size_t *start, size_t *count, 
+	int fp_type, void *fp)
+{
+    return _send_put_vara(ncid, varid, ndims, start, count, fp_type, fp, 
+	    NULL);
+}
+
+int cfio_send_iput_vara(
+	int ncid, int varid, int ndims,
+	size_t *start, size_t *count, 
+	int fp_type, void *fp, int *request)
+{
+    cfio_send_req_t *req;
+
+    req = malloc(sizeof(cfio_send_req_t));
+    if(NULL == req)
+    {
+	error("malloc for req fail.");
+	return CFIO_ERROR_MALLOC;
+    }
+    req->msg_head = malloc(sizeof(qlist_head_t));
+    if(NULL == req->msg_head)
+    {
+	error("malloc for req fail.");
+	free(req);
+	return CFIO_ERROR_MALLOC;
+    }
+    INIT_QLIST_HEAD(req->msg_head);
+    req->id = ++ req_id;
+    req->msg_num = 0;
+    req->sent_num = 0;
+    qlist_add_tail(&(req->link), &req_head);
+
+    *request = req->id;
+
+    /* with shared memory or rma the data is copied only once, into the 
+     * buffer which the server reads, so the put is done at once */
+    return _send_put_vara(ncid, varid, ndims, start, count, fp_type, fp, 
+	    NULL == shm && !rma ? req : NULL);
+}
+
+/**
+ * @brief: find a non-blocking put
+ *
+ * @param request: handle of the request
+ *
+ * @return: the request, NULL if not found
+ */
+static cfio_send_req_t *_find_req(int request)
+{
+    cfio_send_req_t *req;
+
+    qlist_for_each_entry(req, &req_head, link)
+    {
+	if(req->id == request)
+	{
+	    return req;
+	}
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief: progress the msgs of a non-blocking put, free the msgs done
+ *
+ * @param req: the request
+ * @param block: 1 if wait until all msgs are done, 0 if return at once
+ *
+ * @return: 1 if all msgs are done, else 0
+ */
+static int _req_progress(cfio_send_req_t *req, int block)
+{
+    cfio_msg_t *msg, *next;
+    MPI_Status status;
+    int flag, spin = 0;
+
+    qlist_for_each_entry_safe(msg, next, req->msg_head, link)
+    {
+	if(block)
+	{
+	    MPI_Wait(&(msg->req), &status);
+	}else
+	{
+	    MPI_Test(&(msg->req), &flag, &status);
+	    if(!flag)
+	    {
+		return 0;
+	    }
+	}
+	qlist_del(&(msg->link));
+	cfio_buf_close(msg->head_buf);
+	cfio_msg_free(msg);
+	__atomic_add_fetch(&(req->sent_num), 1, __ATOMIC_RELEASE);
+    }
+
+    /* msgs in the queue of sender thread */
+    while(__atomic_load_n(&(req->sent_num), __ATOMIC_ACQUIRE) < req->msg_num)
+    {
+	if(!block)
+	{
+	    return 0;
+	}
+	times_backoff(&spin);
+    }
+
+    return 1;
+}
+
+int cfio_send_req_wait(int request)
+{
+    cfio_send_req_t *req;
+
+    if(NULL == (req = _find_req(request)))
+    {
+	error("request(%d) not found.", request);
+	return CFIO_ERROR_INVALID_REQ;
+    }
+
+    _req_progress(req, 1);
+    qlist_del(&(req->link));
+    free(req->msg_head);
+    free(req);
+
+    debug(DEBUG_SEND, "request(%d) done", request);
+    return CFIO_ERROR_NONE;
+}
+
+int cfio_send_req_test(int request, int *flag)
+{
+    cfio_send_req_t *req;
+
+    if(NULL == (req = _find_req(request)))
+    {
+	error("request(%d) not found.", request);
+	return CFIO_ERROR_INVALID_REQ;
+    }
+
+    *flag = _req_progress(req, 0);
+    if(*flag)
+    {
+	qlist_del(&(req->link));
+	free(req->msg_head);
+	free(req);
+	debug(DEBUG_SEND, "request(%d) done", request);
+    }
 
     return CFIO_ERROR_NONE;
 }
@@ -696,24 +1535,17 @@ int cfio_send_close(
     msg->src = rank;
     msg->func_code = FUNC_NC_CLOSE;
     
-    msg->size = cfio_buf_data_size(sizeof(size_t));
-    msg->size += cfio_buf_data_size(sizeof(uint32_t));
-    msg->size += cfio_buf_data_size(sizeof(int));
+    msg->size = cfio_buf_data_size(sizeof(int));
+    msg->size = _msg_size(msg->size);
     
-#ifdef async_send
-    pthread_mutex_lock(&full_mutex);
-#endif
     ensure_free_space(buffer, msg->size, cfio_send_client_buf_free);
-#ifdef async_send
-    pthread_mutex_unlock(&full_mutex);
-#endif
 
     msg->addr = buffer->free_addr;
 
-    cfio_buf_pack_data(&msg->size, sizeof(size_t) , buffer);
-    cfio_buf_pack_data(&code, sizeof(uint32_t), buffer);
+    _pack_head(msg, code, NULL, buffer);
     cfio_buf_pack_data(&ncid, sizeof(int), buffer);
 
+    _pack_end(msg, buffer);
     cfio_map_forwarding(msg);
     _add_msg(msg);
     //debug(DEBUG_TIME, "%f", times_end());
@@ -730,22 +1562,15 @@ int cfio_send_io_done()
     msg->src = rank;
     msg->func_code = code;
     
-    msg->size = cfio_buf_data_size(sizeof(size_t));
-    msg->size += cfio_buf_data_size(sizeof(uint32_t));
+    msg->size = _msg_size(0);
     
-#ifdef async_send
-    pthread_mutex_lock(&full_mutex);
-#endif
     ensure_free_space(buffer, msg->size, cfio_send_client_buf_free);
-#ifdef async_send
-    pthread_mutex_unlock(&full_mutex);
-#endif
     
     msg->addr = buffer->free_addr;
     
-    cfio_buf_pack_data(&msg->size, sizeof(size_t) , buffer);
-    cfio_buf_pack_data(&code, sizeof(uint32_t), buffer);
+    _pack_head(msg, code, NULL, buffer);
     
+    _pack_end(msg, buffer);
     cfio_map_forwarding(msg);
     _add_msg(msg);
     
@@ -764,22 +1589,15 @@ int cfio_send_io_end()
     msg->src = rank;
     msg->func_code = code;
     
-    msg->size = cfio_buf_data_size(sizeof(size_t));
-    msg->size += cfio_buf_data_size(sizeof(uint32_t));
+    msg->size = _msg_size(0);
     
-#ifdef async_send
-    pthread_mutex_lock(&full_mutex);
-#endif
     ensure_free_space(buffer, msg->size, cfio_send_client_buf_free);
-#ifdef async_send
-    pthread_mutex_unlock(&full_mutex);
-#endif
     
     msg->addr = buffer->free_addr;
     
-    cfio_buf_pack_data(&msg->size, sizeof(size_t) , buffer);
-    cfio_buf_pack_data(&code, sizeof(uint32_t), buffer);
+    _pack_head(msg, code, NULL, buffer);
     
+    _pack_end(msg, buffer);
     cfio_map_forwarding(msg);
     _add_msg(msg);
 
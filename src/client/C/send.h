@@ -17,18 +17,41 @@
 #include <stdlib.h>
 
 #include "cfio_types.h"
+#include "quicklist.h"
 
 #define SEND_BUF_SIZE ((size_t)1024*1024*1024)
 #define SEND_MSG_MIN_SIZE ((size_t)70*1024*1024)
 
+/* length of the msg queue between main thread and sender thread */
+#define SEND_QUEUE_LEN 4096
+/* data of a non-blocking put smaller than it is still copied into the 
+ * buffer, a msg for it alone costs more than the copy */
+#define SEND_ZERO_COPY_MIN_SIZE ((size_t)32*1024)
+/* a put_vara whose record is not larger than it is packed into the batch msg 
+ * of its nc with the other small puts, only in the v2 wire format */
+#define SEND_BATCH_MAX_SIZE ((size_t)16*1024)
+
+/** @brief: a non-blocking put, whose data is sent from the model's array 
+ *	without copy */
+typedef struct
+{
+    int id;		/* handle of the request returned to the model */
+    int msg_num;	/* amount of msgs of the put */
+    int sent_num;	/* amount of msgs which have been sent */
+    qlist_head_t *msg_head;
+			/* msgs sent by MPI_Issend in main thread */
+    qlist_head_t link;
+}cfio_send_req_t;
+
 /**
- * @brief: init the buffer and msg queue
+ * @brief: init the buffer and msg queue, start the sender thread if it is 
+ *	set in configure and MPI_THREAD_MULTIPLE is provided
  *
  * @return: error code
  */
 int cfio_send_init();
 /**
- * @brief: finalize , free the buffer and msg queue
+ * @brief: finalize , wait the sender thread, free the buffer and msg queue
  *
  * @return: error code
  */
@@ -45,6 +68,19 @@ int cfio_send_final();
  */
 int cfio_send_create(
 	char *path, int cmode, int ncid);
+/**
+ * @brief: pack cfio_create_from_template into msg
+ *
+ * @param path: the file name of the new netCDF dataset, 
+ *	cfio_create_from_template's arg
+ * @param ncid: ncid assigned by client
+ * @param template_ncid: ncid of the template nc, cfio_create_from_template's
+ *	arg
+ *
+ * @return: error code
+ */
+int cfio_send_create_from_template(
+	char *path, int ncid, int template_ncid);
 /**
  * @brief: pack cfio_def_dim into msg
  *
@@ -82,6 +118,27 @@ int cfio_send_def_var(
 	int ncid, char *name, cfio_type xtype,
 	int ndims, int *dimids, 
 	size_t *start, size_t *count, int varid);
+/**
+ * @brief: pack only the start and count of a cfio_def_var into msg, it is 
+ *	sent instead of the whole def_var by the clients which are not the 
+ *	meta leader of their server
+ *
+ * @param ncid: netCDF ID, arg of cfio_def_var
+ * @param xtype: predefined netCDF external data type, arg of 
+ *	cfio_def_var
+ * @param ndims: number of dimensions for the variable, arg of 
+ *	cfio_def_var
+ * @param start: a vector of size_t intergers specifying the index in 
+ *	the variable where the first of the data values will be written
+ * @param count: a vector of size_t intergers specifying the edge lengths
+ *	along each dimension of the block of data values to be written
+ * @param varid: var id assigned by client
+ *
+ * @return: error code
+ */
+int cfio_send_def_var_decomp(
+	int ncid, cfio_type xtype, int ndims, 
+	size_t *start, size_t *count, int varid);
 /**
  * @brief: pack cfio_put_att into msg
  *
@@ -107,7 +164,9 @@ int cfio_send_put_att(
 int cfio_send_enddef(
 	int ncid);
 /**
- * @brief: pack cfio_put_vara_float into msg
+ * @brief: pack cfio_put_vara_float into msg, if the data is larger than the 
+ *	max msg size, it is split into a stream of FUNC_NC_PUT_VARA_CHUNK msgs,
+ *	each of which is a contiguous sub-block of the data
  *
  * @param ncid: netCDF ID, arg of cfio_put_vara_float
  * @param varid: variable ID, arg of cfio_put_vara_float
@@ -129,6 +188,47 @@ int cfio_send_put_vara(
 	int ncid, int varid, int ndims,
 	size_t *start, size_t *count, 
 	int fp_type, void *fp);
+/**
+ * @brief: send a put_vara without copying the data into buffer, only the 
+ *	msg head is packed, the data is sent from fp with a MPI derived 
+ *	datatype. the msgs are the same as cfio_send_put_vara's, so the server
+ *	need not know it. fp can't be changed until the request is done
+ *
+ * @param ncid: netCDF ID
+ * @param varid: variable ID
+ * @param ndims: the dimensionality fo variable
+ * @param start: start index of the data values to be written
+ * @param count: edge lengths of the block of data values to be written
+ * @param fp_type: type of data
+ * @param fp: pointer to where data is stored
+ * @param request: pointer to where the handle of the request is to be stored
+ *
+ * @return: error code
+ */
+int cfio_send_iput_vara(
+	int ncid, int varid, int ndims,
+	size_t *start, size_t *count, 
+	int fp_type, void *fp, int *request);
+/**
+ * @brief: wait until the data of a non-blocking put is sent, and free the 
+ *	request
+ *
+ * @param request: handle of the request
+ *
+ * @return: error code, CFIO_ERROR_INVALID_REQ if the request is not found
+ */
+int cfio_send_req_wait(int request);
+/**
+ * @brief: test whether the data of a non-blocking put is sent, the request 
+ *	is freed if it is done
+ *
+ * @param request: handle of the request
+ * @param flag: pointer to where 1 is to be stored if the request is done, 
+ *	else 0
+ *
+ * @return: error code, CFIO_ERROR_INVALID_REQ if the request is not found
+ */
+int cfio_send_req_test(int request, int *flag);
 /**
  * @brief: pack cfio_close into msg
  *
@@ -13,6 +13,7 @@
  *        Company:  HPC Tsinghua
  ***************************************************************************/
 #include <assert.h>
+#include <stdlib.h>
 
 #include "debug.h"
 #include "buffer.h"
@@ -49,8 +50,30 @@ static inline void get_buf_data(cfio_buf_t *buf_p, void *data, size_t size)
 cfio_buf_t *cfio_buf_open(size_t size, int *error)
 {
     cfio_buf_t *buf_p;
+    void *addr;
     
-    buf_p = malloc(size + sizeof(cfio_buf_t));
+    if(0 != posix_memalign(&addr, CFIO_BUF_ALIGN, size + CFIO_BUF_HEAD_SIZE))
+    {
+	SET_ERROR(error, CFIO_ERROR_MALLOC);
+	error("malloc for buf fail.");
+	return NULL;
+    }
+    buf_p = addr;
+
+    buf_p->magic = CFIO_BUF_MAGIC;
+    buf_p->size = size;
+    buf_p->start_addr = (char *)buf_p + CFIO_BUF_HEAD_SIZE;
+    buf_p->free_addr = buf_p->used_addr = buf_p->start_addr;
+    buf_p->magic2 = CFIO_BUF_MAGIC;
+
+    return buf_p;
+}
+
+cfio_buf_t *cfio_buf_attach(char *addr, size_t size, int *error)
+{
+    cfio_buf_t *buf_p;
+    
+    buf_p = malloc(sizeof(cfio_buf_t));
 
     if(NULL == buf_p)
     {
@@ -61,7 +84,7 @@ cfio_buf_t *cfio_buf_open(size_t size, int *error)
 
     buf_p->magic = CFIO_BUF_MAGIC;
     buf_p->size = size;
-    buf_p->start_addr = (char *)buf_p + sizeof(cfio_buf_t);
+    buf_p->start_addr = addr;
     buf_p->free_addr = buf_p->used_addr = buf_p->start_addr;
     buf_p->magic2 = CFIO_BUF_MAGIC;
 
@@ -220,12 +243,12 @@ int cfio_buf_unpack_data_array_ptr(
     {
 	*len = _len;
     }
-    free_buf(buf_p, sizeof(int));
 
-    data_size = (*len) * size;
+    data_size = _len * size;
     assert(used_buf_size(buf_p) >= data_size);
 
     (*data) = buf_p->used_addr;
+    free_buf(buf_p, data_size);
 
     return CFIO_ERROR_NONE;
 }
@@ -20,6 +20,10 @@
 #include "debug.h"
 
 #define CFIO_BUF_MAGIC 0xABCD
+/* the data of an opened buffer starts at an address aligned to this */
+#define CFIO_BUF_ALIGN 64
+#define CFIO_BUF_HEAD_SIZE \
+    ((sizeof(cfio_buf_t) + CFIO_BUF_ALIGN - 1) & ~((size_t)CFIO_BUF_ALIGN - 1))
 
 #define CFIO_BUF_FREE_SPACE_ENOUGH	1
 #define CFIO_BUF_FREE_SPACE_NOT_ENOUGH	2
@@ -185,6 +189,17 @@ static inline int check_used_addr(char *addr, cfio_buf_t *buf_p)
  * @return: pointer to the new buffer
  */
 cfio_buf_t *cfio_buf_open(size_t size, int *error);
+/**
+ * @brief: create a new buffer on memory given by the caller, such as shared 
+ *	memory, the memory is not freed when the buffer is closed
+ *
+ * @param addr: start address of the memory
+ * @param size: size of the memory
+ * @param error: error code 
+ *
+ * @return: pointer to the new buffer
+ */
+cfio_buf_t *cfio_buf_attach(char *addr, size_t size, int *error);
 /**
  * @brief: free the buffer
  *
@@ -256,8 +271,8 @@ int cfio_buf_unpack_data_array(
 
 /**
  * @brief: unpack an array of data from the buffer, the unpacked data pointer 
- *	just point to the address in buffer, no memcpy happen; the caller should
- *	free the data when finishing using the data
+ *	just point to the address in buffer, no memcpy happen; the data is 
+ *	valid until the space is reused, and must not be freed
  *
  * @param data: pointer to the unpacked data array
  * @param len: length of the array
@@ -28,8 +28,13 @@
 #define CFIO_ERROR_FINAL_AFTER_MPI  -200    /* cfio_final should be called before
 					       mpi_final*/
 #define CFIO_ERROR_RANK_INVALID	    -201    
+/* In map.c */
+#define CFIO_ERROR_MPI		    -202    /* mpi call in map init fail */
 /* In msg.c */
 #define CFIO_ERROR_MPI_RECV	    -300    /* MPI_Recv error */
+/* In send.c */
+#define CFIO_ERROR_INVALID_REQ	    -301    /* request of non-blocking put not 
+					       found */
 /* In id.c */
 #define CFIO_ERROR_EXCEED_BOUND	    -400    /* data index exceeds dimension bound */
 #define CFIO_ERROR_NC_NO_EXIST	    -401    /* nc_id not found in assign_table */
@@ -49,6 +49,27 @@ static inline nc_type cfio_type_to_nc(cfio_type type)
     }
 }
 
+static inline MPI_Datatype cfio_type_to_mpi(cfio_type type)
+{
+    switch(type)
+    {
+        case CFIO_BYTE :
+            return MPI_SIGNED_CHAR;
+        case CFIO_CHAR :
+            return MPI_CHAR;
+        case CFIO_SHORT :
+            return MPI_SHORT;
+        case CFIO_INT :
+            return MPI_INT;
+        case CFIO_FLOAT :
+            return MPI_FLOAT;
+        case CFIO_DOUBLE :
+            return MPI_DOUBLE;
+	default :
+	    return MPI_DATATYPE_NULL;
+    }
+}
+
 #define cfio_types_size(size, type) \
     do{				    \
     switch(type) {		    \
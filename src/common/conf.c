@@ -0,0 +1,219 @@
+/****************************************************************************
+ *       Filename:  conf.c
+ *
+ *    Description:  runtime configure of cfio, read from environment variables
+ *
+ *        Version:  1.0
+ *        Created:  10/17/2026 09:15:02 AM
+ *       Revision:  none
+ *       Compiler:  gcc
+ ***************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+
+#include "conf.h"
+#include "debug.h"
+#include "cfio_error.h"
+
+static int send_thread = CFIO_CONF_SEND_THREAD_DEFAULT;
+static int send_core = CFIO_CONF_SEND_CORE_NONE;
+static int output_mode = CFIO_CONF_OUTPUT_MERGE;
+static int flush_size = CFIO_CONF_FLUSH_SIZE_DEFAULT;
+static int meta_leader = CFIO_CONF_META_LEADER_DEFAULT;
+static int map_topology = CFIO_CONF_MAP_TOPOLOGY_DEFAULT;
+static int shm = CFIO_CONF_SHM_DEFAULT;
+static int rma = CFIO_CONF_RMA_DEFAULT;
+static int assemble_thread = CFIO_CONF_ASSEMBLE_THREAD_DEFAULT;
+static int wire_format = CFIO_CONF_WIRE_FORMAT_DEFAULT;
+static int subfile = CFIO_CONF_SUBFILE_NONE;
+static int backend = CFIO_CONF_BACKEND_DEFAULT;
+
+/**
+ * @brief: get an integer from environment variable
+ *
+ * @param name: name of the environment variable
+ * @param def: default value, returned if the variable is not set or not an 
+ *	integer
+ *
+ * @return: value of the variable
+ */
+static int _get_env_int(const char *name, int def)
+{
+    char *val, *end;
+    long ret;
+
+    val = getenv(name);
+    if(NULL == val || '\0' == val[0])
+    {
+	return def;
+    }
+
+    ret = strtol(val, &end, 10);
+    if('\0' != *end)
+    {
+	error("%s=%s is not an integer, use default %d.", name, val, def);
+	return def;
+    }
+
+    return (int)ret;
+}
+
+/**
+ * @brief: get the output mode from environment variable
+ *
+ * @return: CFIO_CONF_OUTPUT_MERGE or CFIO_CONF_OUTPUT_VARN, 
+ *	CFIO_CONF_OUTPUT_MERGE if the variable is not set or unknown
+ */
+static int _get_env_output_mode()
+{
+    char *val;
+
+    val = getenv(CFIO_CONF_ENV_OUTPUT_MODE);
+    if(NULL == val || '\0' == val[0] || 0 == strcmp(val, "merge"))
+    {
+	return CFIO_CONF_OUTPUT_MERGE;
+    }
+    if(0 == strcmp(val, "varn"))
+    {
+	return CFIO_CONF_OUTPUT_VARN;
+    }
+
+    error("%s=%s is unknown, use merge.", CFIO_CONF_ENV_OUTPUT_MODE, val);
+    return CFIO_CONF_OUTPUT_MERGE;
+}
+
+/**
+ * @brief: get the output engine from environment variable
+ *
+ * @return: CFIO_CONF_BACKEND_*, CFIO_CONF_BACKEND_DEFAULT if the variable is 
+ *	not set or unknown
+ */
+static int _get_env_backend()
+{
+    char *val;
+
+    val = getenv(CFIO_CONF_ENV_BACKEND);
+    if(NULL == val || '\0' == val[0])
+    {
+	return CFIO_CONF_BACKEND_DEFAULT;
+    }
+    if(0 == strcmp(val, "pnetcdf"))
+    {
+	return CFIO_CONF_BACKEND_PNETCDF;
+    }
+    if(0 == strcmp(val, "raw"))
+    {
+	return CFIO_CONF_BACKEND_RAW;
+    }
+    if(0 == strcmp(val, "null"))
+    {
+	return CFIO_CONF_BACKEND_NULL;
+    }
+
+    error("%s=%s is unknown, use default.", CFIO_CONF_ENV_BACKEND, val);
+    return CFIO_CONF_BACKEND_DEFAULT;
+}
+
+int cfio_conf_init()
+{
+    send_thread = _get_env_int(CFIO_CONF_ENV_SEND_THREAD, 
+	    CFIO_CONF_SEND_THREAD_DEFAULT);
+    send_core = _get_env_int(CFIO_CONF_ENV_SEND_CORE, 
+	    CFIO_CONF_SEND_CORE_NONE);
+    output_mode = _get_env_output_mode();
+    flush_size = _get_env_int(CFIO_CONF_ENV_FLUSH_SIZE, 
+	    CFIO_CONF_FLUSH_SIZE_DEFAULT);
+    meta_leader = _get_env_int(CFIO_CONF_ENV_META_LEADER, 
+	    CFIO_CONF_META_LEADER_DEFAULT);
+    map_topology = _get_env_int(CFIO_CONF_ENV_MAP_TOPOLOGY, 
+	    CFIO_CONF_MAP_TOPOLOGY_DEFAULT);
+    shm = _get_env_int(CFIO_CONF_ENV_SHM, CFIO_CONF_SHM_DEFAULT);
+    rma = _get_env_int(CFIO_CONF_ENV_RMA, CFIO_CONF_RMA_DEFAULT);
+    assemble_thread = _get_env_int(CFIO_CONF_ENV_ASSEMBLE_THREAD, 
+	    CFIO_CONF_ASSEMBLE_THREAD_DEFAULT);
+    wire_format = _get_env_int(CFIO_CONF_ENV_WIRE_FORMAT, 
+	    CFIO_CONF_WIRE_FORMAT_DEFAULT);
+    if(1 != wire_format && 2 != wire_format)
+    {
+	error("%s=%d is unknown, use %d.", CFIO_CONF_ENV_WIRE_FORMAT, 
+		wire_format, CFIO_CONF_WIRE_FORMAT_DEFAULT);
+	wire_format = CFIO_CONF_WIRE_FORMAT_DEFAULT;
+    }
+    subfile = _get_env_int(CFIO_CONF_ENV_SUBFILE, CFIO_CONF_SUBFILE_NONE);
+    if(subfile < 0)
+    {
+	error("%s=%d is negative, use %d.", CFIO_CONF_ENV_SUBFILE, subfile, 
+		CFIO_CONF_SUBFILE_NONE);
+	subfile = CFIO_CONF_SUBFILE_NONE;
+    }
+    backend = _get_env_backend();
+
+    debug(DEBUG_CONF, "send_thread = %d; send_core = %d; output_mode = %d; "
+	    "flush_size = %d; meta_leader = %d; map_topology = %d; shm = %d; "
+	    "rma = %d; assemble_thread = %d; wire_format = %d; subfile = %d; "
+	    "backend = %d", send_thread, send_core, output_mode, flush_size, 
+	    meta_leader, map_topology, shm, rma, assemble_thread, wire_format, 
+	    subfile, backend);
+
+    return CFIO_ERROR_NONE;
+}
+
+int cfio_conf_get_send_thread()
+{
+    return send_thread;
+}
+
+int cfio_conf_get_send_core()
+{
+    return send_core;
+}
+
+int cfio_conf_get_output_mode()
+{
+    return output_mode;
+}
+
+int cfio_conf_get_flush_size()
+{
+    return flush_size;
+}
+
+int cfio_conf_get_meta_leader()
+{
+    return meta_leader;
+}
+
+int cfio_conf_get_map_topology()
+{
+    return map_topology;
+}
+
+int cfio_conf_get_shm()
+{
+    return shm;
+}
+
+int cfio_conf_get_rma()
+{
+    return rma;
+}
+
+int cfio_conf_get_assemble_thread()
+{
+    return assemble_thread;
+}
+
+int cfio_conf_get_wire_format()
+{
+    return wire_format;
+}
+
+int cfio_conf_get_subfile()
+{
+    return subfile;
+}
+
+int cfio_conf_get_backend()
+{
+    return backend;
+}
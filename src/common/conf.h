@@ -0,0 +1,168 @@
+/****************************************************************************
+ *       Filename:  conf.h
+ *
+ *    Description:  runtime configure of cfio, read from environment variables
+ *
+ *        Version:  1.0
+ *        Created:  10/17/2026 09:12:31 AM
+ *       Revision:  none
+ *       Compiler:  gcc
+ ***************************************************************************/
+#ifndef _CONF_H
+#define _CONF_H
+#include "define.h"
+
+/* 1 to send msg in a separate sender thread, 0 to send in the main thread */
+#define CFIO_CONF_ENV_SEND_THREAD	"CFIO_SEND_THREAD"
+/* core the sender thread is bound to, not bound if < 0 */
+#define CFIO_CONF_ENV_SEND_CORE		"CFIO_SEND_THREAD_CORE"
+
+/* how the server writes the data of a var, "merge" or "varn" */
+#define CFIO_CONF_ENV_OUTPUT_MODE	"CFIO_OUTPUT_MODE"
+/* MB of var data the server posts with ncmpi_iput before a ncmpi_wait_all, 
+ * 0 to wait only at close, < 0 to write each var with a blocking put */
+#define CFIO_CONF_ENV_FLUSH_SIZE	"CFIO_FLUSH_SIZE"
+/* 1 to let only the first client of each server send the dims, atts and 
+ * full def_vars, the other clients send only the start and count of vars */
+#define CFIO_CONF_ENV_META_LEADER	"CFIO_META_LEADER"
+/* 1 to spread the servers over the nodes and let each block of clients be 
+ * served by a server on its node, see cfio_client_index */
+#define CFIO_CONF_ENV_MAP_TOPOLOGY	"CFIO_MAP_TOPOLOGY"
+/* 0 to send msgs by MPI even when a client and its server are on the same 
+ * node, instead of through shared memory */
+#define CFIO_CONF_ENV_SHM		"CFIO_SHM"
+/* 1 to let the server pull the msgs of a client not on its node with 
+ * MPI_Get, the client sends only the place of each msg */
+#define CFIO_CONF_ENV_RMA		"CFIO_RMA"
+/* amount of threads assembling var data in the server, another thread writes
+ * the assembled data while msgs are recved, 0 to do all in one thread, < 0 
+ * to use all cores the server can run on */
+#define CFIO_CONF_ENV_ASSEMBLE_THREAD	"CFIO_ASSEMBLE_THREAD"
+/* version of the msg format sent by the clients, 1 packs the fields one by 
+ * one, 2 starts each msg with a fixed head and aligns the data, see msg.h */
+#define CFIO_CONF_ENV_WIRE_FORMAT	"CFIO_WIRE_FORMAT"
+/* amount of servers writing one subfile, each group of servers writes its 
+ * part of the vars into its own file, 0 to write one shared file */
+#define CFIO_CONF_ENV_SUBFILE		"CFIO_SUBFILE"
+/* output engine of the server, "pnetcdf", "raw" or "null", see backend.h.
+ * with liburing only "raw" posts its writes to io_uring, also for subfiles */
+#define CFIO_CONF_ENV_BACKEND		"CFIO_BACKEND"
+
+#define CFIO_CONF_SEND_THREAD_DEFAULT	0
+#define CFIO_CONF_SEND_CORE_NONE	(-1)
+#define CFIO_CONF_FLUSH_SIZE_DEFAULT	256
+#define CFIO_CONF_FLUSH_AT_CLOSE	0
+#define CFIO_CONF_FLUSH_BLOCKING	(-1)
+#define CFIO_CONF_META_LEADER_DEFAULT	0
+#define CFIO_CONF_MAP_TOPOLOGY_DEFAULT	0
+#define CFIO_CONF_SHM_DEFAULT		1
+#define CFIO_CONF_RMA_DEFAULT		0
+#define CFIO_CONF_ASSEMBLE_THREAD_DEFAULT 2
+#define CFIO_CONF_WIRE_FORMAT_DEFAULT	2
+#define CFIO_CONF_SUBFILE_NONE		0
+
+/* merge the blocks of all clients into their bounding box and write it with
+ * one ncmpi_put_vara_*_all */
+#define CFIO_CONF_OUTPUT_MERGE		0
+/* write the block of each client directly with one ncmpi_put_varn_all */
+#define CFIO_CONF_OUTPUT_VARN		1
+
+/* write nc files with PnetCDF */
+#define CFIO_CONF_BACKEND_PNETCDF	0
+/* append the defs and the data to a log file of each server */
+#define CFIO_CONF_BACKEND_RAW		1
+/* drop everything, to measure the forwarding without the file system */
+#define CFIO_CONF_BACKEND_NULL		2
+#ifdef SVR_NO_IO
+#define CFIO_CONF_BACKEND_DEFAULT	CFIO_CONF_BACKEND_NULL
+#else
+#define CFIO_CONF_BACKEND_DEFAULT	CFIO_CONF_BACKEND_PNETCDF
+#endif
+
+/**
+ * @brief: read the configure from environment variables, variables not set 
+ *	get the default value
+ *
+ * @return: error code
+ */
+int cfio_conf_init();
+/**
+ * @brief: whether to send msg in a separate sender thread
+ *
+ * @return: 1 if yes, 0 if not
+ */
+int cfio_conf_get_send_thread();
+/**
+ * @brief: get the core which the sender thread is bound to
+ *
+ * @return: core id, CFIO_CONF_SEND_CORE_NONE if not bound
+ */
+int cfio_conf_get_send_core();
+/**
+ * @brief: get how the server writes the data of a var
+ *
+ * @return: CFIO_CONF_OUTPUT_MERGE or CFIO_CONF_OUTPUT_VARN
+ */
+int cfio_conf_get_output_mode();
+/**
+ * @brief: get the MB of var data the server posts before a wait
+ *
+ * @return: MB, CFIO_CONF_FLUSH_AT_CLOSE to wait only at close, < 0 to write 
+ *	each var with a blocking put
+ */
+int cfio_conf_get_flush_size();
+/**
+ * @brief: whether only the meta leader client of each server sends the 
+ *	metadata
+ *
+ * @return: 1 if yes, 0 if every client sends it
+ */
+int cfio_conf_get_meta_leader();
+/**
+ * @brief: whether the servers are placed and assigned by the node topology
+ *
+ * @return: 1 if yes, 0 if the servers are the procs after the clients
+ */
+int cfio_conf_get_map_topology();
+/**
+ * @brief: whether a client and its server on the same node talk through 
+ *	shared memory
+ *
+ * @return: 1 if yes, 0 if they always use MPI
+ */
+int cfio_conf_get_shm();
+/**
+ * @brief: whether the server pulls the msgs of a client not on its node
+ *
+ * @return: 1 if yes, 0 if the client sends them by MPI_Ssend
+ */
+int cfio_conf_get_rma();
+/**
+ * @brief: get the amount of threads assembling var data in the server
+ *
+ * @return: amount of threads, 0 if the server runs in one thread, < 0 if a 
+ *	thread for each core
+ */
+int cfio_conf_get_assemble_thread();
+/**
+ * @brief: get the version of the msg format sent by the clients
+ *
+ * @return: 1 or 2
+ */
+int cfio_conf_get_wire_format();
+/**
+ * @brief: get the amount of servers writing one subfile
+ *
+ * @return: amount of servers, CFIO_CONF_SUBFILE_NONE if all servers write one
+ *	shared file
+ */
+int cfio_conf_get_subfile();
+/**
+ * @brief: get the output engine of the server
+ *
+ * @return: CFIO_CONF_BACKEND_PNETCDF, CFIO_CONF_BACKEND_RAW or 
+ *	CFIO_CONF_BACKEND_NULL
+ */
+int cfio_conf_get_backend();
+
+#endif
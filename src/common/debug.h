@@ -36,6 +36,9 @@
 #define DEBUG_SERVER	((uint32_t)1 << 9)
 #define DEBUG_SEND	((uint32_t)1 << 10)
 #define DEBUG_RECV	((uint32_t)1 << 11)
+#define DEBUG_CONF	((uint32_t)1 << 12)
+#define DEBUG_SHM	((uint32_t)1 << 13)
+#define DEBUG_RMA	((uint32_t)1 << 14)
 
 extern int debug_mask;
 
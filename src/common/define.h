@@ -16,7 +16,6 @@
 //#define SVR_UNPACK_ONLY
 //#define SVR_NO_IO
 #undef SVR_META_ONLY
-//#define async_send
 
 //#define async_isend
 
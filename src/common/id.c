@@ -14,6 +14,7 @@
  *        Company:  HPC Tsinghua
  ***************************************************************************/
 #include <assert.h>
+#include <string.h>
 
 #include "id.h"
 #include "cfio_types.h"
@@ -26,6 +27,10 @@
 static int open_nc_a;  /* amount of opened nc file , assigned as new nc id*/
 static struct qhash_table *assign_table; /* used for assign id in client*/
 static struct qhash_table *map_table;	/* used for map id in server */
+static qlist_head_t template_head;	/* schema templates, oldest first */
+static int template_num;		/* amount of templates */
+static void (*free_data)(void *) = free;
+				/* frees the data put into the vars */
 
 static int _compare_client_name(struct qhash_head *link, void *key)
 {
@@ -90,6 +95,16 @@ static void _val_free(cfio_id_val_t *val)
 		free(val->var->recv_data);
 		val->var->recv_data = NULL;
 	    }
+	    if(NULL != val->var->data)
+	    {
+		free(val->var->data);
+		val->var->data = NULL;
+	    }
+	    if(NULL != val->var->chunk_head)
+	    {
+		free(val->var->chunk_head);
+		val->var->chunk_head = NULL;
+	    }
 	    free(val->var);
 	    val->var = NULL;
 	}
@@ -98,11 +113,207 @@ static void _val_free(cfio_id_val_t *val)
     }
 }
 
+/**
+ * @brief: copy a memory block
+ *
+ * @param src: the block, may be NULL
+ * @param size: size of the block
+ *
+ * @return: the copy, NULL if src is NULL
+ */
+static void *_memdup(const void *src, size_t size)
+{
+    void *dst;
+
+    if(NULL == src)
+    {
+	return NULL;
+    }
+    dst = malloc(size);
+    memcpy(dst, src, size);
+
+    return dst;
+}
+
+/**
+ * @brief: copy all attributes of a list to the tail of another list
+ *
+ * @param dst_head: the list which copies are added to
+ * @param src_head: the list to copy
+ */
+static void _att_list_copy(qlist_head_t *dst_head, qlist_head_t *src_head)
+{
+    cfio_id_att_t *att, *copy;
+    size_t att_size;
+
+    qlist_for_each_entry(att, src_head, link)
+    {
+	cfio_types_size(att_size, att->xtype);
+	copy = malloc(sizeof(cfio_id_att_t));
+	copy->name = strdup(att->name);
+	copy->xtype = att->xtype;
+	copy->len = att->len;
+	copy->data = _memdup(att->data, att_size * att->len);
+	qlist_add_tail(&(copy->link), dst_head);
+    }
+}
+
+/**
+ * @brief: free all attributes of a list, not including the list head
+ *
+ * @param head: the list
+ */
+static void _att_list_free(qlist_head_t *head)
+{
+    cfio_id_att_t *att, *next;
+
+    qlist_for_each_entry_safe(att, next, head, link)
+    {
+	qlist_del(&(att->link));
+	free(att->name);
+	free(att->data);
+	free(att);
+    }
+}
+
+/**
+ * @brief: copy a name list
+ *
+ * @param src_head: the list to copy
+ *
+ * @return: the copy
+ */
+static qlist_head_t *_name_list_dup(qlist_head_t *src_head)
+{
+    qlist_head_t *dst_head;
+    cfio_id_client_name_t *name, *copy;
+
+    dst_head = malloc(sizeof(qlist_head_t));
+    INIT_QLIST_HEAD(dst_head);
+    qlist_for_each_entry(name, src_head, link)
+    {
+	copy = malloc(sizeof(cfio_id_client_name_t));
+	copy->name = strdup(name->name);
+	copy->id = name->id;
+	qlist_add_tail(&(copy->link), dst_head);
+    }
+
+    return dst_head;
+}
+
+/**
+ * @brief: copy the schema part of a dim or var map entry, the recieved data 
+ *	is not copied
+ *
+ * @param val: the dim or var entry
+ *
+ * @return: the copy
+ */
+static cfio_id_val_t *_def_val_dup(cfio_id_val_t *val)
+{
+    cfio_id_val_t *copy;
+    cfio_id_var_t *var;
+
+    copy = malloc(sizeof(cfio_id_val_t));
+    memset(copy, 0, sizeof(cfio_id_val_t));
+    copy->client_nc_id = val->client_nc_id;
+    copy->client_dim_id = val->client_dim_id;
+    copy->client_var_id = val->client_var_id;
+
+    if(NULL != val->dim)
+    {
+	copy->dim = malloc(sizeof(cfio_id_dim_t));
+	memset(copy->dim, 0, sizeof(cfio_id_dim_t));
+	copy->dim->name = strdup(val->dim->name);
+	copy->dim->nc_id = CFIO_ID_NC_INVALID;
+	copy->dim->dim_id = CFIO_ID_DIM_INVALID;
+	copy->dim->dim_len = CFIO_ID_DIM_LOCAL_NULL;
+	copy->dim->global_dim_len = val->dim->global_dim_len;
+    }
+    if(NULL != val->var)
+    {
+	var = malloc(sizeof(cfio_id_var_t));
+	memset(var, 0, sizeof(cfio_id_var_t));
+	var->name = strdup(val->var->name);
+	var->nc_id = CFIO_ID_NC_INVALID;
+	var->var_id = CFIO_ID_VAR_INVALID;
+	var->ndims = val->var->ndims;
+	var->client_num = val->var->client_num;
+	var->dim_ids = _memdup(val->var->dim_ids, sizeof(int) * var->ndims);
+	var->start = _memdup(val->var->start, sizeof(size_t) * var->ndims);
+	var->count = _memdup(val->var->count, sizeof(size_t) * var->ndims);
+	var->data_type = val->var->data_type;
+	var->att_head = malloc(sizeof(qlist_head_t));
+	INIT_QLIST_HEAD(var->att_head);
+	_att_list_copy(var->att_head, val->var->att_head);
+	copy->var = var;
+    }
+
+    return copy;
+}
+
+/**
+ * @brief: free a template
+ *
+ * @param template: the template
+ */
+static void _template_free(cfio_id_template_t *template)
+{
+    cfio_id_val_t *val, *next;
+
+    if(NULL != template->val)
+    {
+	cfio_id_val_free(template->val);
+	template->val = NULL;
+    }
+    if(NULL != template->def_head)
+    {
+	qlist_for_each_entry_safe(val, next, template->def_head, link)
+	{
+	    qlist_del(&(val->link));
+	    cfio_id_val_free(val);
+	}
+	free(template->def_head);
+	template->def_head = NULL;
+    }
+    if(NULL != template->att_head)
+    {
+	_att_list_free(template->att_head);
+	free(template->att_head);
+	template->att_head = NULL;
+    }
+    free(template);
+}
+
+/**
+ * @brief: find a template
+ *
+ * @param client_nc_id: the client nc id of the template
+ *
+ * @return: the template, NULL if not found
+ */
+static cfio_id_template_t *_template_find(int client_nc_id)
+{
+    cfio_id_template_t *template;
+
+    qlist_for_each_entry(template, &template_head, link)
+    {
+	if(template->client_nc_id == client_nc_id)
+	{
+	    return template;
+	}
+    }
+
+    return NULL;
+}
+
 int cfio_id_init(int flag)
 {
     open_nc_a = 0;
     assign_table = NULL;
     map_table = NULL;
+    INIT_QLIST_HEAD(&template_head);
+    template_num = 0;
 
     switch(flag)
     {
@@ -132,6 +343,15 @@ int cfio_id_init(int flag)
 
 int cfio_id_final()
 {
+    cfio_id_template_t *template, *next;
+
+    qlist_for_each_entry_safe(template, next, &template_head, link)
+    {
+	qlist_del(&(template->link));
+	_template_free(template);
+    }
+    template_num = 0;
+
     if(NULL != assign_table)
     {
 	qhash_destroy_and_finalize(assign_table, cfio_id_val_t, 
@@ -349,6 +569,12 @@ int cfio_id_map_nc(
     val->nc = malloc(sizeof(cfio_id_nc_t));
     val->nc->nc_id = server_nc_id;
     val->nc->nc_status = DEFINE_MODE;
+    val->nc->cmode = 0;
+    val->nc->att_head = malloc(sizeof(qlist_head_t));
+    INIT_QLIST_HEAD(val->nc->att_head);
+    val->nc->req_head = malloc(sizeof(qlist_head_t));
+    INIT_QLIST_HEAD(val->nc->req_head);
+    val->nc->req_size = 0;
 
     qhash_add(map_table, &key, &(val->hash_link));
     INIT_QLIST_HEAD(&(val->link));
@@ -451,6 +677,12 @@ int cfio_id_map_var(
     val->var->att_head = malloc(sizeof(qlist_head_t));
     INIT_QLIST_HEAD(val->var->att_head);
 
+    val->var->data = NULL;
+    val->var->chunk_head = malloc(sizeof(qlist_head_t));
+    INIT_QLIST_HEAD(val->var->chunk_head);
+    val->var->global_size = 0;
+    val->var->sub_start = NULL;
+
     qhash_add(map_table, &key, &(val->hash_link));
     qlist_add_tail(&(val->link), &(nc_val->link));
     
@@ -622,7 +854,7 @@ int cfio_id_put_var(
 
 	if(NULL != var->recv_data[client_index].buf)
 	{
-	    free(var->recv_data[client_index].buf);
+	    cfio_id_free_data(var->recv_data[client_index].buf);
 	}
 	if(NULL != var->recv_data[client_index].start)
 	{
@@ -655,7 +887,11 @@ int cfio_id_put_att(
 
     memset(&key, 0, sizeof(cfio_id_key_t));
     key.client_nc_id = client_nc_id;
-    key.client_var_id = client_var_id;
+    /* global attribute is kept in the nc */
+    if(NC_GLOBAL != client_var_id)
+    {
+	key.client_var_id = client_var_id;
+    }
 
     if(NULL == (link = qhash_search(map_table, &key)))
     {
@@ -665,14 +901,20 @@ int cfio_id_put_att(
     }else
     {
 	val = qlist_entry(link, cfio_id_val_t, hash_link);
-	var = val->var;
 	
 	att = malloc(sizeof(cfio_id_att_t));
 	att->name = name;
 	att->xtype = xtype;
 	att->len = len;
 	att->data = data;
-	qlist_add_tail(&(att->link), var->att_head);
+	if(NC_GLOBAL == client_var_id)
+	{
+	    qlist_add_tail(&(att->link), val->nc->att_head);
+	}else
+	{
+	    var = val->var;
+	    qlist_add_tail(&(att->link), var->att_head);
+	}
 
 	debug(DEBUG_ID, "put att(%s)", att->name);
 	
@@ -685,6 +927,8 @@ void cfio_id_val_free(cfio_id_val_t *val)
     int i;
     cfio_id_data_t *recv_data;
     cfio_id_att_t *att, *next;
+    cfio_id_chunk_t *chunk, *chunk_next;
+    cfio_id_req_t *req, *req_next;
     cfio_id_client_name_t *name, *name_next;
 
     debug(DEBUG_ID, "start free.");
@@ -693,6 +937,23 @@ void cfio_id_val_free(cfio_id_val_t *val)
     {
 	if(NULL != val->nc)
 	{
+	    if(NULL != val->nc->req_head)
+	    {
+		qlist_for_each_entry_safe(req, req_next, 
+			val->nc->req_head, link)
+		{
+		    qlist_del(&(req->link));
+		    cfio_id_req_free(req);
+		}
+		free(val->nc->req_head);
+		val->nc->req_head = NULL;
+	    }
+	    if(NULL != val->nc->att_head)
+	    {
+		_att_list_free(val->nc->att_head);
+		free(val->nc->att_head);
+		val->nc->att_head = NULL;
+	    }
 	    free(val->nc);
 	    val->nc = NULL;
 	}
@@ -728,6 +989,11 @@ void cfio_id_val_free(cfio_id_val_t *val)
 		free(val->var->count);
 		val->var->count = NULL;
 	    }
+	    if(NULL != val->var->sub_start)
+	    {
+		free(val->var->sub_start);
+		val->var->sub_start = NULL;
+	    }
 	    recv_data = val->var->recv_data;
 	    if(NULL != recv_data)
 	    {
@@ -735,7 +1001,7 @@ void cfio_id_val_free(cfio_id_val_t *val)
 		{
 		    if(NULL != recv_data[i].buf)
 		    {
-			free(recv_data[i].buf);
+			cfio_id_free_data(recv_data[i].buf);
 			recv_data[i].buf = NULL;
 		    }
 		    if(NULL != recv_data[i].start)
@@ -772,6 +1038,24 @@ void cfio_id_val_free(cfio_id_val_t *val)
 		free(val->var->att_head);
 		val->var->att_head = NULL;
 	    }
+	    if(NULL != val->var->data)
+	    {
+		free(val->var->data);
+		val->var->data = NULL;
+	    }
+	    if(NULL != val->var->chunk_head)
+	    {
+		qlist_for_each_entry_safe(chunk, chunk_next, 
+			val->var->chunk_head, link)
+		{
+		    free(chunk->buf);
+		    free(chunk->start);
+		    free(chunk->count);
+		    free(chunk);
+		}
+		free(val->var->chunk_head);
+		val->var->chunk_head = NULL;
+	    }
 	    free(val->var);
 	    val->var = NULL;
 	} /* end var */
@@ -811,3 +1095,243 @@ void cfio_id_val_free(cfio_id_val_t *val)
     debug(DEBUG_ID, "success return.");
 }
 	
+
+void cfio_id_set_free_data(void (*_free_data)(void *))
+{
+    free_data = (NULL == _free_data) ? free : _free_data;
+}
+
+void cfio_id_free_data(void *data)
+{
+    free_data(data);
+}
+
+void cfio_id_req_free(cfio_id_req_t *req)
+{
+    int i;
+
+    if(NULL != req)
+    {
+	if(NULL != req->bufs)
+	{
+	    for(i = 0; i < req->buf_num; i ++)
+	    {
+		if(NULL != req->bufs[i])
+		{
+		    cfio_id_free_data(req->bufs[i]);
+		    req->bufs[i] = NULL;
+		}
+	    }
+	    free(req->bufs);
+	    req->bufs = NULL;
+	}
+	if(MPI_DATATYPE_NULL != req->buf_type)
+	{
+	    MPI_Type_free(&(req->buf_type));
+	}
+	free(req);
+    }
+}
+
+int cfio_id_save_template(int client_nc_id)
+{
+    cfio_id_key_t key;
+    cfio_id_val_t *val, *iter;
+    cfio_id_template_t *template;
+    struct qhash_head *link;
+
+    if(NULL != _template_find(client_nc_id))
+    {
+	return CFIO_ERROR_NONE;
+    }
+
+    memset(&key, 0, sizeof(cfio_id_key_t));
+    key.client_nc_id = client_nc_id;
+
+    template = malloc(sizeof(cfio_id_template_t));
+    if(NULL == template)
+    {
+	error("malloc fail.");
+	return CFIO_ERROR_MALLOC;
+    }
+    memset(template, 0, sizeof(cfio_id_template_t));
+    template->client_nc_id = client_nc_id;
+
+    if(NULL != assign_table)
+    {
+	if(NULL == (link = qhash_search(assign_table, &key)))
+	{
+	    error("nc_id(%d) not found in assign_table.", client_nc_id);
+	    free(template);
+	    return CFIO_ERROR_NC_NO_EXIST;
+	}
+	val = qlist_entry(link, cfio_id_val_t, hash_link);
+	if(0 != val->template_nc_id)
+	{
+	    free(template);
+	    return CFIO_ERROR_NONE;
+	}
+	template->val = malloc(sizeof(cfio_id_val_t));
+	memset(template->val, 0, sizeof(cfio_id_val_t));
+	template->val->client_var_a = val->client_var_a;
+	template->val->client_dim_a = val->client_dim_a;
+	template->val->var_head = _name_list_dup(val->var_head);
+	template->val->dim_head = _name_list_dup(val->dim_head);
+    }else
+    {
+	if(NULL == (link = qhash_search(map_table, &key)))
+	{
+	    error("nc_id(%d) not found in map_table.", client_nc_id);
+	    free(template);
+	    return CFIO_ERROR_NC_NO_EXIST;
+	}
+	val = qlist_entry(link, cfio_id_val_t, hash_link);
+	template->cmode = val->nc->cmode;
+	template->att_head = malloc(sizeof(qlist_head_t));
+	INIT_QLIST_HEAD(template->att_head);
+	_att_list_copy(template->att_head, val->nc->att_head);
+	template->def_head = malloc(sizeof(qlist_head_t));
+	INIT_QLIST_HEAD(template->def_head);
+	qlist_for_each_entry(iter, &(val->link), link)
+	{
+	    qlist_add_tail(&(_def_val_dup(iter)->link), template->def_head);
+	}
+    }
+
+    qlist_add_tail(&(template->link), &template_head);
+    template_num ++;
+    if(template_num > ID_TEMPLATE_CACHE_SIZE)
+    {
+	template = qlist_entry(template_head.next, cfio_id_template_t, link);
+	debug(DEBUG_ID, "drop template(%d)", template->client_nc_id);
+	qlist_del(&(template->link));
+	_template_free(template);
+	template_num --;
+    }
+
+    debug(DEBUG_ID, "save template(%d)", client_nc_id);
+    return CFIO_ERROR_NONE;
+}
+
+int cfio_id_assign_nc_from_template(int template_nc_id, int *nc_id)
+{
+    assert(nc_id != NULL);
+
+    int ret;
+    cfio_id_key_t key;
+    cfio_id_val_t *val;
+    cfio_id_template_t *template;
+    struct qhash_head *link;
+
+    if(NULL == (template = _template_find(template_nc_id)))
+    {
+	error("template nc_id(%d) not found.", template_nc_id);
+	return CFIO_ERROR_NC_NO_EXIST;
+    }
+
+    if((ret = cfio_id_assign_nc(nc_id)) < 0)
+    {
+	return ret;
+    }
+
+    memset(&key, 0, sizeof(cfio_id_key_t));
+    key.client_nc_id = *nc_id;
+    link = qhash_search(assign_table, &key);
+    val = qlist_entry(link, cfio_id_val_t, hash_link);
+
+    free(val->var_head);
+    free(val->dim_head);
+    val->client_var_a = template->val->client_var_a;
+    val->client_dim_a = template->val->client_dim_a;
+    val->var_head = _name_list_dup(template->val->var_head);
+    val->dim_head = _name_list_dup(template->val->dim_head);
+    val->template_nc_id = template_nc_id;
+
+    debug(DEBUG_ID, "assign nc_id = %d from template(%d)", 
+	    *nc_id, template_nc_id);
+
+    return CFIO_ERROR_NONE;
+}
+
+int cfio_id_map_nc_from_template(
+	int client_nc_id, int template_nc_id, int *cmode)
+{
+    int i;
+    size_t min_start, max_end;
+    cfio_id_key_t key;
+    cfio_id_val_t *nc_val, *def, *val;
+    cfio_id_var_t *var;
+    cfio_id_template_t *template;
+    struct qhash_head *link;
+
+    if(NULL == (template = _template_find(template_nc_id)))
+    {
+	debug(DEBUG_ID, "template (%d) null", template_nc_id);
+	return CFIO_ID_HASH_GET_NULL;
+    }
+
+    memset(&key, 0, sizeof(cfio_id_key_t));
+    key.client_nc_id = client_nc_id;
+    if(NULL == (link = qhash_search(map_table, &key)))
+    {
+	debug(DEBUG_ID, "get nc (%d, 0, 0) null", client_nc_id);
+	return CFIO_ID_HASH_GET_NULL;
+    }
+    nc_val = qlist_entry(link, cfio_id_val_t, hash_link);
+
+    nc_val->nc->cmode = template->cmode;
+    _att_list_copy(nc_val->nc->att_head, template->att_head);
+
+    qlist_for_each_entry(def, template->def_head, link)
+    {
+	if(NULL != def->dim)
+	{
+	    cfio_id_map_dim(client_nc_id, def->client_dim_id, 
+		    CFIO_ID_NC_INVALID, CFIO_ID_DIM_INVALID,
+		    strdup(def->dim->name), def->dim->global_dim_len);
+	    continue;
+	}
+
+	var = def->var;
+	if(CFIO_ID_HASH_GET_NULL == cfio_id_get_val(
+		    client_nc_id, def->client_var_id, 0, &val))
+	{
+	    cfio_id_map_var(strdup(var->name), 
+		    client_nc_id, def->client_var_id,
+		    CFIO_ID_NC_INVALID, CFIO_ID_VAR_INVALID,
+		    var->ndims, _memdup(var->dim_ids, sizeof(int) * var->ndims),
+		    _memdup(var->start, sizeof(size_t) * var->ndims),
+		    _memdup(var->count, sizeof(size_t) * var->ndims),
+		    var->data_type, var->client_num);
+	    cfio_id_get_val(client_nc_id, def->client_var_id, 0, &val);
+	}else
+	{
+	    /* mapped by a put_vara before the template is ready, fill the 
+	     * name and dims and merge the start and count */
+	    val->var->name = strdup(var->name);
+	    val->var->dim_ids = _memdup(var->dim_ids, sizeof(int) * var->ndims);
+	    val->var->data_type = var->data_type;
+	    for(i = 0; i < var->ndims && i < val->var->ndims; i ++)
+	    {
+		min_start = var->start[i] < val->var->start[i] ? 
+		    var->start[i] : val->var->start[i];
+		max_end = var->start[i] + var->count[i] > 
+		    val->var->start[i] + val->var->count[i] ?
+		    var->start[i] + var->count[i] : 
+		    val->var->start[i] + val->var->count[i];
+		val->var->start[i] = min_start;
+		val->var->count[i] = max_end - min_start;
+	    }
+	    /* keep the define order of the template */
+	    qlist_del(&(val->link));
+	    qlist_add_tail(&(val->link), &(nc_val->link));
+	}
+	_att_list_copy(val->var->att_head, var->att_head);
+    }
+
+    *cmode = template->cmode;
+
+    debug(DEBUG_ID, "map nc(%d) from template(%d)", 
+	    client_nc_id, template_nc_id);
+    return CFIO_ERROR_NONE;
+}
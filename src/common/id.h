@@ -20,6 +20,9 @@
 
 #define MAP_HASH_TABLE_SIZE 1024
 #define ASSIGN_HASH_TABLE_SIZE 1024
+/* max amount of schema templates kept, the oldest one is dropped first so 
+ * that client and server drop the same one */
+#define ID_TEMPLATE_CACHE_SIZE 8
 
 #define CFIO_ID_INIT_CLIENT	    0
 #define CFIO_ID_INIT_SERVER	    1
@@ -50,8 +53,31 @@ typedef struct
     char *buf;		    /* pointer to the data */
     size_t *start;	    /* vector of ndims start index of the variable */
     size_t *count;	    /* vector of ndims count index of the variable */
+    size_t recv_len;	    /* amount of elements recieved in chunks */
 }cfio_id_data_t;
 
+/** @brief: a chunk of put_vara data which arrives before the var's assemble
+ *	buffer can be allocated */
+typedef struct
+{
+    char *buf;		    /* pointer to the data */
+    size_t *start;	    /* vector of ndims start index of the chunk */
+    size_t *count;	    /* vector of ndims count index of the chunk */
+    qlist_head_t link;
+}cfio_id_chunk_t;
+
+/** @brief: a non-blocking put request which is not waited yet, its data must 
+ *	be kept until the wait */
+typedef struct
+{
+    int req;		    /* request id returned by ncmpi_iput_* */
+    int buf_num;	    /* number of data buffers */
+    char **bufs;	    /* data buffers, freed after the wait */
+    MPI_Datatype buf_type;  /* datatype of the data, MPI_DATATYPE_NULL if 
+			       no derived datatype is used */
+    qlist_head_t link;
+}cfio_id_req_t;
+
 /* quicklist entry for var and dim's name */
 typedef struct
 {
@@ -65,6 +91,12 @@ typedef struct
 {
     int nc_id;		    /* id of nc file */
     int nc_status;	    /* the status of nc file : DEFINE_MODE or DATA_MODE */
+    int cmode;		    /* the creation mode flag of the nc file */
+    qlist_head_t 
+	*att_head;	    /* global attribute list */
+    qlist_head_t 
+	*req_head;	    /* non-blocking put requests waiting for wait_all */
+    size_t req_size;	    /* global size of the vars of the requests */
 }cfio_id_nc_t;
 
 /** @brief: store a dimension information in server */
@@ -76,6 +108,8 @@ typedef struct
     
     int dim_len;	    /* length of the dim */
     int global_dim_len;
+    int sub_start;	    /* start of the part of the dim in the subfile */
+    int sub_len;	    /* length of the part of the dim in the subfile */
 }cfio_id_dim_t;
 /** @brief: store a variable information in server */
 typedef struct
@@ -92,6 +126,14 @@ typedef struct
     size_t *count;	    /* vector of ndims count index of the variable */
     cfio_id_data_t 
 	*recv_data;	    /* pointer to data vector recieved from client */
+    char *data;		    /* assemble buffer of start and count, chunks of 
+			       put_vara are copied into it directly */
+    qlist_head_t 
+	*chunk_head;	    /* chunks waiting for the assemble buffer */
+    size_t global_size;	    /* size in bytes of the whole var in the file, 
+			       an unlimited dim is counted as 1 */
+    int *sub_start;	    /* vector of ndims start of the subfile in the var,
+			       NULL if all servers write one shared file */
     cfio_type data_type;          /* type of data, define in cfio_types.h */
     //size_t ele_size;	    /* size of each element in the variable array */
     qlist_head_t 
@@ -128,6 +170,7 @@ typedef struct
     int client_dim_a;	/* amount of defined dim in client*/
     qlist_head_t *var_head, *dim_head;
 		  /* quicklist to store var and dim name that defined before*/
+    int template_nc_id;	/* the template nc is created from, 0 if none */
    
     cfio_id_nc_t *nc;   /* nc file infomation in server */
     cfio_id_dim_t *dim; /* dim infomation in server */
@@ -136,6 +179,24 @@ typedef struct
     qlist_head_t link; /* link for interator */
 }cfio_id_val_t;
 
+/** @brief: schema of a nc file after enddef, which new nc files can be 
+ *	created from */
+typedef struct
+{
+    int client_nc_id;	/* id of the template nc file in client */
+    
+    /* only in client */
+    cfio_id_val_t *val;	/* copy of the nc's var and dim name list */
+
+    /* only in server */
+    int cmode;		/* the creation mode flag of the nc file */
+    qlist_head_t *def_head;
+			/* copy of the nc's dims and vars in define order */
+    qlist_head_t *att_head;
+			/* copy of the nc's global attributes */
+    qlist_head_t link;
+}cfio_id_template_t;
+
 /**
  * @brief: init 
  *
@@ -312,5 +373,59 @@ int cfio_id_put_var(
 int cfio_id_merge_var_data(cfio_id_var_t *var);
 
 void cfio_id_val_free(cfio_id_val_t *val);
+/**
+ * @brief: save the schema of a nc as a template, in client the var and dim 
+ *	name list is saved, in server the dims, vars and attributes are saved.
+ *	nothing is done if the nc is already a template or is created from a 
+ *	template
+ *
+ * @param client_nc_id: the client nc id
+ *
+ * @return: error code
+ */
+int cfio_id_save_template(int client_nc_id);
+/**
+ * @brief: assign a new nc id in client, whose var and dim names are copied
+ *	from a template
+ *
+ * @param template_nc_id: the client nc id of the template
+ * @param nc_id: pointer to where the new nc id is to be stored
+ *
+ * @return: error code, CFIO_ERROR_NC_NO_EXIST if the template is not found
+ */
+int cfio_id_assign_nc_from_template(int template_nc_id, int *nc_id);
+/**
+ * @brief: map the dims, vars and global attributes of a template into a 
+ *	mapped nc in server, the vars which are already mapped without name and 
+ *	dims get them from the template
+ *
+ * @param client_nc_id: the client nc id of the new nc
+ * @param template_nc_id: the client nc id of the template
+ * @param cmode: pointer to where the creation mode of the template is to be 
+ *	stored
+ *
+ * @return: error code, CFIO_ID_HASH_GET_NULL if the template is not found
+ */
+int cfio_id_map_nc_from_template(
+	int client_nc_id, int template_nc_id, int *cmode);
+/**
+ * @brief: set the function which frees the data put into the vars, the
+ *	server keeps some data in its recv buffer, which is not freed by free
+ *
+ * @param _free_data: the function, NULL for free
+ */
+void cfio_id_set_free_data(void (*_free_data)(void *));
+/**
+ * @brief: free the data put into a var or owned by a request
+ *
+ * @param data: the data, can be NULL
+ */
+void cfio_id_free_data(void *data);
+/**
+ * @brief: free a non-blocking put request and its data
+ *
+ * @param req: the request
+ */
+void cfio_id_req_free(cfio_id_req_t *req);
 
 #endif
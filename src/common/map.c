@@ -13,9 +13,11 @@
  *        Company:  HPC Tsinghua
  ***************************************************************************/
 #include <assert.h>
+#include <stdio.h>
 
 #include "mpi.h"
 #include "map.h"
+#include "conf.h"
 #include "debug.h"
 #include "cfio_error.h"
 
@@ -26,7 +28,22 @@ static MPI_Comm comm;
 static int server_amount;
 static int server_x_num;
 static int server_y_num;
-static int server_comm;
+static MPI_Comm server_comm;
+static int subfile_amount;
+static int subfile_index;
+static MPI_Comm subfile_comm;
+
+/**
+ * the role of each proc in comm. a client's index is its position in the 
+ * client_x_num * client_y_num decomposition, a server's index is the block 
+ * of clients it serves : server_x_index + server_y_index * server_x_num
+ **/
+static int proc_amount;
+static int *proc_type = NULL;	/* proc id -> CFIO_MAP_TYPE_* */
+static int *proc_index = NULL;	/* proc id -> client or server index */
+static int *client_proc = NULL;	/* client index -> proc id */
+static int *server_proc = NULL;	/* server index -> proc id */
+static int *proc_node = NULL;	/* proc id -> node, named by its first proc */
 
 /**
  * @brief: get all factor of a interger n
@@ -161,10 +178,277 @@ static int _gen_server_x_and_y(int best_server_amount)
     }
 }
 
+/**
+ * @brief: get the client indexes of a server index
+ *
+ * @param server_index: the server index
+ * @param client_index: pointer to the array storing the client indexes
+ */
+static void _get_client_indexes(int server_index, int *client_index)
+{
+    int client_x_index, client_y_index;
+    int client_x_start_index, client_y_start_index;
+    int client_per_server_x, client_per_server_y;
+    int server_x_index, server_y_index;
+    int client_num;
+    int i;
+
+    server_x_index = server_index % server_x_num;
+    server_y_index = server_index / server_x_num;
+
+    client_num = client_amount / server_amount;
+    client_per_server_x = client_x_num / server_x_num;
+    client_per_server_y = client_y_num / server_y_num;
+
+    client_x_start_index = server_x_index * client_per_server_x;
+    client_y_start_index = server_y_index * client_per_server_y;
+    
+    for(i = 0; i < client_num ; i ++)
+    {
+	client_x_index = i % client_per_server_x + client_x_start_index;
+	client_y_index = i / client_per_server_x + client_y_start_index;
+	client_index[i] = client_x_index + client_y_index * client_x_num;
+    }
+}
+
+/**
+ * @brief: set a proc's role
+ *
+ * @param proc_id: the proc id
+ * @param type: CFIO_MAP_TYPE_CLIENT, CFIO_MAP_TYPE_SERVER or 
+ *	CFIO_MAP_TYPE_BLANK
+ * @param index: the client or server index
+ */
+static inline void _set_proc(int proc_id, int type, int index)
+{
+    proc_type[proc_id] = type;
+    proc_index[proc_id] = index;
+    if(CFIO_MAP_TYPE_CLIENT == type)
+    {
+	client_proc[index] = proc_id;
+    }else if(CFIO_MAP_TYPE_SERVER == type)
+    {
+	server_proc[index] = proc_id;
+    }
+}
+
+/**
+ * @brief: the clients are the first procs, the servers follow them
+ */
+static void _assign_by_rank()
+{
+    int i;
+
+    for(i = 0; i < proc_amount; i ++)
+    {
+	if(i < client_amount)
+	{
+	    _set_proc(i, CFIO_MAP_TYPE_CLIENT, i);
+	}else if(i < client_amount + server_amount)
+	{
+	    _set_proc(i, CFIO_MAP_TYPE_SERVER, i - client_amount);
+	}else
+	{
+	    _set_proc(i, CFIO_MAP_TYPE_BLANK, -1);
+	}
+    }
+}
+
+/**
+ * @brief: get the node of every proc into proc_node
+ *
+ * @return: error code
+ */
+static int _get_proc_node()
+{
+    MPI_Comm node_comm;
+    int rank, first;
+
+    MPI_Comm_rank(comm, &rank);
+    if(MPI_SUCCESS != MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, rank, 
+		MPI_INFO_NULL, &node_comm))
+    {
+	error("split comm by node fail.");
+	return CFIO_ERROR_MPI;
+    }
+    first = rank;
+    MPI_Bcast(&first, 1, MPI_INT, 0, node_comm);
+    MPI_Comm_free(&node_comm);
+
+    MPI_Allgather(&first, 1, MPI_INT, proc_node, 1, MPI_INT, comm);
+
+    return CFIO_ERROR_NONE;
+}
+
+/**
+ * @brief: print the placement of servers and how many of their clients are 
+ *	on the same node
+ */
+static void _print_placement()
+{
+    int *client_index;
+    int i, j, client_num, local_num, total_local = 0;
+
+    client_num = client_amount / server_amount;
+    client_index = malloc(client_num * sizeof(int));
+    for(i = 0; i < server_amount; i ++)
+    {
+	_get_client_indexes(i, client_index);
+	local_num = 0;
+	for(j = 0; j < client_num; j ++)
+	{
+	    if(proc_node[client_proc[client_index[j]]] == proc_node[server_proc[i]])
+	    {
+		local_num ++;
+	    }
+	}
+	total_local += local_num;
+	printf("cfio map: server %d on proc %d (node of proc %d), "
+		"%d of %d clients on the same node\n", i, server_proc[i], 
+		proc_node[server_proc[i]], local_num, client_num);
+    }
+    printf("cfio map: %d of %d clients send to a server on the same node\n",
+	    total_local, client_amount);
+    free(client_index);
+}
+
+/**
+ * @brief: spread the servers over the nodes, each node gets its last procs 
+ *	as servers by turn, the other procs are clients in order. then each 
+ *	block of clients is served by the server which has the most clients of
+ *	the block on its node
+ *
+ * @return: error code
+ */
+static int _assign_by_node()
+{
+    int *node_first, *node_next, *is_server, *servers, *used;
+    int *client_index;
+    int node_amount, client_num;
+    int i, j, k, n, index, best, best_local, local_num, rank;
+    int return_code = CFIO_ERROR_NONE;
+
+    node_first = malloc(proc_amount * sizeof(int));
+    node_next = malloc(proc_amount * sizeof(int));
+    is_server = malloc(proc_amount * sizeof(int));
+    servers = malloc(server_amount * sizeof(int));
+    used = malloc(server_amount * sizeof(int));
+    client_num = client_amount / server_amount;
+    client_index = malloc(client_num * sizeof(int));
+    if(NULL == node_first || NULL == node_next || 
+	    NULL == is_server || NULL == servers || NULL == used || 
+	    NULL == client_index)
+    {
+	error("malloc fail.");
+	return_code = CFIO_ERROR_MALLOC;
+	goto RETURN;
+    }
+
+    /* the nodes in the order of their first proc, node_next is the next 
+     * proc to be taken as a server, from the last of each node */
+    node_amount = 0;
+    for(i = 0; i < proc_amount; i ++)
+    {
+	is_server[i] = 0;
+	if(proc_node[i] == i)
+	{
+	    node_first[node_amount] = i;
+	    node_amount ++;
+	}
+    }
+    for(n = 0; n < node_amount; n ++)
+    {
+	node_next[n] = proc_amount - 1;
+	while(proc_node[node_next[n]] != node_first[n])
+	{
+	    node_next[n] --;
+	}
+    }
+    for(i = 0, n = 0; i < server_amount; n = (n + 1) % node_amount)
+    {
+	if(node_next[n] < node_first[n])
+	{
+	    continue;
+	}
+	is_server[node_next[n]] = 1;
+	servers[i ++] = node_next[n];
+	do
+	{
+	    node_next[n] --;
+	}while(node_next[n] >= node_first[n] && 
+		proc_node[node_next[n]] != node_first[n]);
+    }
+
+    index = 0;
+    for(i = 0; i < proc_amount; i ++)
+    {
+	if(is_server[i])
+	{
+	    continue;
+	}
+	if(index < client_amount)
+	{
+	    _set_proc(i, CFIO_MAP_TYPE_CLIENT, index ++);
+	}else
+	{
+	    _set_proc(i, CFIO_MAP_TYPE_BLANK, -1);
+	}
+    }
+
+    for(k = 0; k < server_amount; k ++)
+    {
+	used[k] = 0;
+    }
+    for(i = 0; i < server_amount; i ++)
+    {
+	_get_client_indexes(i, client_index);
+	best = -1;
+	best_local = -1;
+	for(k = 0; k < server_amount; k ++)
+	{
+	    if(used[k])
+	    {
+		continue;
+	    }
+	    local_num = 0;
+	    for(j = 0; j < client_num; j ++)
+	    {
+		if(proc_node[client_proc[client_index[j]]] == proc_node[servers[k]])
+		{
+		    local_num ++;
+		}
+	    }
+	    if(local_num > best_local)
+	    {
+		best = k;
+		best_local = local_num;
+	    }
+	}
+	used[best] = 1;
+	_set_proc(servers[best], CFIO_MAP_TYPE_SERVER, i);
+    }
+
+    MPI_Comm_rank(comm, &rank);
+    if(0 == rank)
+    {
+	_print_placement();
+    }
+
+RETURN:
+    free(node_first);
+    free(node_next);
+    free(is_server);
+    free(servers);
+    free(used);
+    free(client_index);
+
+    return return_code;
+}
+
 int cfio_map_init(
 	int _client_x_num, int _client_y_num,
 	int _server_amount, int best_server_amount,
-	MPI_Comm _comm, MPI_Comm _server_comm)
+	MPI_Comm _comm)
 {
     assert(_client_x_num > 0);
     assert(_client_y_num > 0);
@@ -176,7 +460,9 @@ int cfio_map_init(
     client_y_num = _client_y_num;
     client_amount = client_x_num * client_y_num;
     comm = _comm;
-    server_comm = _server_comm;
+    server_comm = MPI_COMM_NULL;
+    subfile_comm = MPI_COMM_NULL;
+    subfile_amount = subfile_index = 0;
 
     server_amount = _server_amount;
 
@@ -185,40 +471,122 @@ int cfio_map_init(
 	error("");
 	return ret;
     }
+
+    MPI_Comm_size(comm, &proc_amount);
+    proc_type = malloc(proc_amount * sizeof(int));
+    proc_index = malloc(proc_amount * sizeof(int));
+    client_proc = malloc(client_amount * sizeof(int));
+    server_proc = malloc(server_amount * sizeof(int));
+    proc_node = malloc(proc_amount * sizeof(int));
+    if(NULL == proc_type || NULL == proc_index || NULL == client_proc ||
+	    NULL == server_proc || NULL == proc_node)
+    {
+	error("malloc fail.");
+	return CFIO_ERROR_MALLOC;
+    }
+
+    if((ret = _get_proc_node()) < 0)
+    {
+	error("");
+	return ret;
+    }
+
+    if(cfio_conf_get_map_topology())
+    {
+	if((ret = _assign_by_node()) < 0)
+	{
+	    error("");
+	    return ret;
+	}
+    }else
+    {
+	_assign_by_rank();
+    }
+
+    /* ranks in server_comm are the server indexes */
+    MPI_Comm_rank(comm, &i);
+    MPI_Comm_split(comm, 
+	    CFIO_MAP_TYPE_SERVER == proc_type[i] ? 0 : MPI_UNDEFINED, 
+	    proc_index[i], &server_comm);
+
+    /* the servers are grouped by their indexes, each group writes a subfile */
+    if(CFIO_CONF_SUBFILE_NONE != (ret = cfio_conf_get_subfile()))
+    {
+	subfile_amount = (server_amount + ret - 1) / ret;
+	if(CFIO_MAP_TYPE_SERVER == proc_type[i])
+	{
+	    subfile_index = proc_index[i] / ret;
+	    MPI_Comm_split(server_comm, subfile_index, proc_index[i], 
+		    &subfile_comm);
+	}
+	debug(DEBUG_MAP, "subfile_amount : %d; subfile_index : %d", 
+		subfile_amount, subfile_index);
+    }
     
     debug(DEBUG_MAP, "success return.");
     return CFIO_ERROR_NONE;
 }
 int cfio_map_final()
 {
+    if(MPI_COMM_NULL != subfile_comm)
+    {
+	MPI_Comm_free(&subfile_comm);
+    }
+    if(MPI_COMM_NULL != server_comm)
+    {
+	MPI_Comm_free(&server_comm);
+    }
+    free(proc_type);
+    free(proc_index);
+    free(client_proc);
+    free(server_proc);
+    free(proc_node);
+    proc_type = proc_index = client_proc = server_proc = proc_node = NULL;
+
     return CFIO_ERROR_NONE;
 }
 int cfio_map_proc_type(int proc_id)
 {
     assert(proc_id >= 0);
-    /* client is 0 ~ client_amount - 1 , server is client_amount ~ server_amount
-     * + client_amount - 1 */
-    if(proc_id < client_amount)
-    {
-	return CFIO_MAP_TYPE_CLIENT;
-    }else if(proc_id < client_amount + server_amount)
-    {
-	return CFIO_MAP_TYPE_SERVER;
-    }else
+    
+    if(proc_id >= proc_amount)
     {
 	return CFIO_MAP_TYPE_BLANK;
     }
+    return proc_type[proc_id];
+}
+int cfio_map_same_node(int proc_a, int proc_b)
+{
+    assert(proc_a >= 0 && proc_a < proc_amount);
+    assert(proc_b >= 0 && proc_b < proc_amount);
+
+    return proc_node[proc_a] == proc_node[proc_b];
 }
-int cfio_map_get_comm()
+MPI_Comm cfio_map_get_comm()
 {
     return comm; 
 }
 
-int cfio_map_get_server_comm()
+MPI_Comm cfio_map_get_server_comm()
 {
     return server_comm; 
 }
 
+MPI_Comm cfio_map_get_subfile_comm()
+{
+    return MPI_COMM_NULL != subfile_comm ? subfile_comm : server_comm;
+}
+
+int cfio_map_get_subfile_amount()
+{
+    return subfile_amount;
+}
+
+int cfio_map_get_subfile_index()
+{
+    return subfile_index;
+}
+
 int cfio_map_get_server_amount()
 {
     return server_amount;
@@ -231,33 +599,17 @@ int cfio_map_get_client_amount()
 
 int cfio_map_get_clients(int server_id, int *client_id)
 {
-    int client_x_index, client_y_index;
-    int client_x_start_index, client_y_start_index;
-    int client_per_server_x, client_per_server_y;
-    int server_x_index, server_y_index;
     int client_num;
     int i;
-    int server_index;
    
-    server_index = cfio_map_get_server_index(server_id);
-    server_x_index = server_index % server_x_num;
-    server_y_index = server_index / server_x_num;
-
-    debug(DEBUG_MAP, "rank(%d) : (%d, %d)", server_id, server_x_index, 
-	    server_y_index);
+    debug(DEBUG_MAP, "rank(%d) : server index %d", server_id, 
+	    cfio_map_get_server_index(server_id));
 
+    _get_client_indexes(cfio_map_get_server_index(server_id), client_id);
     client_num = cfio_map_get_client_num_of_server(server_id);
-    client_per_server_x = client_x_num / server_x_num;
-    client_per_server_y = client_y_num / server_y_num;
-
-    client_x_start_index = server_x_index * client_per_server_x;
-    client_y_start_index = server_y_index * client_per_server_y;
-    
     for(i = 0; i < client_num ; i ++)
     {
-	client_x_index = i % client_per_server_x + client_x_start_index;
-	client_y_index = i / client_per_server_x + client_y_start_index;
-	client_id[i] = client_x_index + client_y_index * client_x_num;
+	client_id[i] = client_proc[client_id[i]];
     }
 
     return CFIO_ERROR_NONE;
@@ -296,7 +648,13 @@ int cfio_map_get_server_index(int server_id)
 {
     assert(cfio_map_proc_type(server_id) == CFIO_MAP_TYPE_SERVER);
 
-    return server_id - client_amount;
+    return proc_index[server_id];
+}
+int cfio_map_get_client_index(int client_id)
+{
+    assert(cfio_map_proc_type(client_id) == CFIO_MAP_TYPE_CLIENT);
+
+    return proc_index[client_id];
 }
 int cfio_map_get_client_index_of_server(int client_id)
 {
@@ -326,8 +684,8 @@ int cfio_map_get_client_index_of_server(int client_id)
     int client_x_index_in_server, client_y_index_in_server;
     int client_index;
     
-    client_x_index = client_id % client_x_num;
-    client_y_index = client_id / client_x_num;
+    client_x_index = proc_index[client_id] % client_x_num;
+    client_y_index = proc_index[client_id] / client_x_num;
 
     client_per_server_x = client_x_num / server_x_num;
     client_per_server_y = client_y_num / server_y_num;
@@ -349,8 +707,8 @@ int cfio_map_get_server_of_client(int client_id)
     int server_x_index, server_y_index;
     int client_per_server_x, client_per_server_y;
     
-    client_x_index = client_id % client_x_num;
-    client_y_index = client_id / client_x_num;
+    client_x_index = proc_index[client_id] % client_x_num;
+    client_y_index = proc_index[client_id] / client_x_num;
 
     client_per_server_x = client_x_num / server_x_num;
     client_per_server_y = client_y_num / server_y_num;
@@ -360,7 +718,7 @@ int cfio_map_get_server_of_client(int client_id)
 
     server_id = server_x_index + server_y_index * server_x_num;
 
-    return server_id + client_amount;
+    return server_proc[server_id];
 }
 
 int cfio_map_forwarding(
@@ -32,12 +32,17 @@
  * @param best_server_amount: best server proc num, = client_amount * SERVER_RATIO
  * @param _comm: 
  *
+ * by default the clients are the first procs and the servers follow them. if
+ * CFIO_MAP_TOPOLOGY is set, the servers are spread over the nodes and each 
+ * block of clients is served by a server on the node where most of them are,
+ * the placement is printed by proc 0. the server comm is created here
+ *
  * @return: error cod
  */
 int cfio_map_init(
 	int _client_x_num, int _client_y_num,
 	int _server_amount, int best_server_amount,
-	MPI_Comm _comm, MPI_Comm server_comm);
+	MPI_Comm _comm);
 /**
  * @brief: cfio map finalize
  *
@@ -52,13 +57,48 @@ int cfio_map_final();
  * @return: CFIO_MAP_TYPE_SERVER, CFIO_MAP_TYPE_CLIENT or CFIO_MAP_TYPE_BLANK
  */
 int cfio_map_proc_type(int porc_id);
+/**
+ * @brief: whether two procs are on the same node, so they can share memory
+ *
+ * @param proc_a: proc id
+ * @param proc_b: proc id
+ *
+ * @return: 1 if yes, 0 if not
+ */
+int cfio_map_same_node(int proc_a, int proc_b);
 /**
  * @brief: get MPI communication
  *
  * @return: MPI Communication
  */
-int cfio_map_get_comm();
-int cfio_map_get_server_comm();
+MPI_Comm cfio_map_get_comm();
+/**
+ * @brief: get the MPI communication of all servers, the rank of a server in it
+ *	is its server index
+ *
+ * @return: MPI Communication, MPI_COMM_NULL in a client
+ */
+MPI_Comm cfio_map_get_server_comm();
+/**
+ * @brief: get the MPI communication of the servers writing the same subfile,
+ *	see CFIO_CONF_ENV_SUBFILE
+ *
+ * @return: MPI Communication, the server communication if there is no 
+ *	subfile, MPI_COMM_NULL in a client
+ */
+MPI_Comm cfio_map_get_subfile_comm();
+/**
+ * @brief: get the amount of subfiles an output file is split into
+ *
+ * @return: subfile amount, 0 if all servers write one shared file
+ */
+int cfio_map_get_subfile_amount();
+/**
+ * @brief: get the index of the subfile written by this server
+ *
+ * @return: subfile index, 0 if all servers write one shared file
+ */
+int cfio_map_get_subfile_index();
 /**
  * @brief: get server proc amount
  *
@@ -96,6 +136,15 @@ int cfio_map_get_client_num_of_server(int server_id);
  * @return: server index
  */
 int cfio_map_get_server_index(int server_id);
+/**
+ * @brief: get client index, the position of the client in the 
+ *	client_x_num * client_y_num decomposition
+ *
+ * @param client_id: client proc id
+ *
+ * @return: client index
+ */
+int cfio_map_get_client_index(int client_id);
 /**
  * @brief: get client index in a server
  *
@@ -0,0 +1,188 @@
+/****************************************************************************
+ *       Filename:  mem.c
+ *
+ *    Description:  pools of fixed size objects and arenas of scratch memory
+ *
+ *        Version:  1.0
+ *        Created:  10/17/2026 09:20:04 PM
+ *       Revision:  none
+ *       Compiler:  gcc
+ ***************************************************************************/
+#include <stdlib.h>
+#include <assert.h>
+
+#include "mem.h"
+#include "debug.h"
+#include "cfio_error.h"
+
+/* the link at the head of a slab or an arena block */
+#define MEM_LINK_SIZE cfio_mem_align(sizeof(void *))
+#define mem_next(ptr) (*((void **)(ptr)))
+
+/**
+ * @brief: malloc a slab and put its objects in the free list, called with the
+ *	mutex locked
+ *
+ * @param slab: the pool
+ *
+ * @return: error code
+ */
+static int _slab_grow(cfio_mem_slab_t *slab)
+{
+    char *new_slab, *obj;
+    int i;
+
+    new_slab = malloc(MEM_LINK_SIZE + slab->obj_size * slab->obj_num);
+    if(NULL == new_slab)
+    {
+	error("malloc for slab fail.");
+	return CFIO_ERROR_MALLOC;
+    }
+    mem_next(new_slab) = slab->slab_list;
+    slab->slab_list = new_slab;
+
+    obj = new_slab + MEM_LINK_SIZE;
+    for(i = 0; i < slab->obj_num; i ++)
+    {
+	mem_next(obj) = slab->free_list;
+	slab->free_list = obj;
+	obj += slab->obj_size;
+    }
+
+    return CFIO_ERROR_NONE;
+}
+
+int cfio_mem_slab_init(cfio_mem_slab_t *slab, size_t obj_size, int obj_num)
+{
+    assert(NULL != slab);
+    assert(obj_num > 0);
+
+    slab->obj_size = cfio_mem_align(obj_size);
+    slab->obj_num = obj_num;
+    slab->free_list = NULL;
+    slab->slab_list = NULL;
+    pthread_mutex_init(&(slab->mutex), NULL);
+
+    return CFIO_ERROR_NONE;
+}
+
+void *cfio_mem_slab_alloc(cfio_mem_slab_t *slab)
+{
+    void *obj = NULL;
+
+    pthread_mutex_lock(&(slab->mutex));
+    if(NULL != slab->free_list || _slab_grow(slab) >= 0)
+    {
+	obj = slab->free_list;
+	slab->free_list = mem_next(obj);
+    }
+    pthread_mutex_unlock(&(slab->mutex));
+
+    return obj;
+}
+
+void cfio_mem_slab_free(cfio_mem_slab_t *slab, void *obj)
+{
+    if(NULL == obj)
+    {
+	return;
+    }
+
+    pthread_mutex_lock(&(slab->mutex));
+    mem_next(obj) = slab->free_list;
+    slab->free_list = obj;
+    pthread_mutex_unlock(&(slab->mutex));
+}
+
+void cfio_mem_slab_final(cfio_mem_slab_t *slab)
+{
+    void *next;
+
+    pthread_mutex_lock(&(slab->mutex));
+    while(NULL != slab->slab_list)
+    {
+	next = mem_next(slab->slab_list);
+	free(slab->slab_list);
+	slab->slab_list = next;
+    }
+    slab->free_list = NULL;
+    pthread_mutex_unlock(&(slab->mutex));
+}
+
+int cfio_mem_arena_init(cfio_mem_arena_t *arena, size_t block_size)
+{
+    assert(NULL != arena);
+
+    arena->block_size = cfio_mem_align(block_size);
+    arena->block_list = NULL;
+    arena->used = arena->size = 0;
+    pthread_mutex_init(&(arena->mutex), NULL);
+
+    return CFIO_ERROR_NONE;
+}
+
+void *cfio_mem_arena_alloc(cfio_mem_arena_t *arena, size_t size)
+{
+    char *block, *ptr = NULL;
+    size_t block_size;
+
+    size = cfio_mem_align(size);
+
+    pthread_mutex_lock(&(arena->mutex));
+    if(arena->used + size > arena->size)
+    {
+	/* the rest of the block being cut is left until reset */
+	block_size = MEM_LINK_SIZE + size > arena->block_size ?
+	    MEM_LINK_SIZE + size : arena->block_size;
+	if(NULL == (block = malloc(block_size)))
+	{
+	    error("malloc for arena block fail.");
+	    pthread_mutex_unlock(&(arena->mutex));
+	    return NULL;
+	}
+	mem_next(block) = arena->block_list;
+	arena->block_list = block;
+	arena->used = MEM_LINK_SIZE;
+	arena->size = block_size;
+    }
+    ptr = (char *)arena->block_list + arena->used;
+    arena->used += size;
+    pthread_mutex_unlock(&(arena->mutex));
+
+    return ptr;
+}
+
+void cfio_mem_arena_reset(cfio_mem_arena_t *arena)
+{
+    void *block, *next;
+
+    pthread_mutex_lock(&(arena->mutex));
+    if(NULL == arena->block_list)
+    {
+	pthread_mutex_unlock(&(arena->mutex));
+	return;
+    }
+
+    /* keep the newest block, it is the largest one in most cases */
+    block = mem_next(arena->block_list);
+    while(NULL != block)
+    {
+	next = mem_next(block);
+	free(block);
+	block = next;
+    }
+    mem_next(arena->block_list) = NULL;
+    arena->used = MEM_LINK_SIZE;
+    pthread_mutex_unlock(&(arena->mutex));
+}
+
+void cfio_mem_arena_final(cfio_mem_arena_t *arena)
+{
+    cfio_mem_arena_reset(arena);
+
+    pthread_mutex_lock(&(arena->mutex));
+    free(arena->block_list);
+    arena->block_list = NULL;
+    arena->used = arena->size = 0;
+    pthread_mutex_unlock(&(arena->mutex));
+}
@@ -0,0 +1,120 @@
+/****************************************************************************
+ *       Filename:  mem.h
+ *
+ *    Description:  pools of fixed size objects and arenas of scratch memory,
+ *		    to keep the objects allocated for each msg off malloc
+ *
+ *        Version:  1.0
+ *        Created:  10/17/2026 09:12:37 PM
+ *       Revision:  none
+ *       Compiler:  gcc
+ ***************************************************************************/
+#ifndef _MEM_H
+#define _MEM_H
+#include <stdlib.h>
+#include <pthread.h>
+
+/* objects and arena allocations are aligned to it */
+#define CFIO_MEM_ALIGN 16
+#define cfio_mem_align(size) \
+    (((size) + CFIO_MEM_ALIGN - 1) & ~((size_t)CFIO_MEM_ALIGN - 1))
+
+/**
+ * a pool of objects of one size. objects are cut from slabs malloced
+ * obj_num at a time, a freed object is put in the free list and reused, the
+ * slabs are only freed at final. it can be used by several threads
+ **/
+typedef struct
+{
+    size_t obj_size;	/* size of an object */
+    int obj_num;	/* amount of objects in a slab */
+    void *free_list;	/* free objects, linked by their first word */
+    void *slab_list;	/* slabs, linked by their first word */
+    pthread_mutex_t mutex;
+}cfio_mem_slab_t;
+
+/* a slab pool can be defined static with it and used without init */
+#define CFIO_MEM_SLAB_INITIALIZER(size, num) \
+    {cfio_mem_align(size), (num), NULL, NULL, PTHREAD_MUTEX_INITIALIZER}
+
+/**
+ * an arena of scratch memory, allocations are cut from blocks one after
+ * another and never freed one by one, all of them are released together by
+ * cfio_mem_arena_reset. it can be used by several threads
+ **/
+typedef struct
+{
+    size_t block_size;	/* min size of a block */
+    void *block_list;	/* blocks, the one being cut first, linked by
+			   their first word */
+    size_t used;	/* used size of the block being cut */
+    size_t size;	/* size of the block being cut */
+    pthread_mutex_t mutex;
+}cfio_mem_arena_t;
+
+/**
+ * @brief: init a slab pool
+ *
+ * @param slab: the pool
+ * @param obj_size: size of an object
+ * @param obj_num: amount of objects malloced at a time
+ *
+ * @return: error code
+ */
+int cfio_mem_slab_init(cfio_mem_slab_t *slab, size_t obj_size, int obj_num);
+/**
+ * @brief: get an object from a slab pool, it is not zeroed
+ *
+ * @param slab: the pool
+ *
+ * @return: the object, NULL if malloc fail
+ */
+void *cfio_mem_slab_alloc(cfio_mem_slab_t *slab);
+/**
+ * @brief: give an object back to the slab pool it is got from
+ *
+ * @param slab: the pool
+ * @param obj: the object, can be NULL
+ */
+void cfio_mem_slab_free(cfio_mem_slab_t *slab, void *obj);
+/**
+ * @brief: free all the slabs of a pool, the objects got from it must not be
+ *	used any more
+ *
+ * @param slab: the pool
+ */
+void cfio_mem_slab_final(cfio_mem_slab_t *slab);
+/**
+ * @brief: init an arena
+ *
+ * @param arena: the arena
+ * @param block_size: min size of the blocks malloced
+ *
+ * @return: error code
+ */
+int cfio_mem_arena_init(cfio_mem_arena_t *arena, size_t block_size);
+/**
+ * @brief: get scratch memory from an arena, it is valid until the arena is
+ *	reset
+ *
+ * @param arena: the arena
+ * @param size: size of the memory
+ *
+ * @return: the memory, NULL if malloc fail
+ */
+void *cfio_mem_arena_alloc(cfio_mem_arena_t *arena, size_t size);
+/**
+ * @brief: release all the memory got from an arena, the first block is kept
+ *	for the next allocations
+ *
+ * @param arena: the arena
+ */
+void cfio_mem_arena_reset(cfio_mem_arena_t *arena);
+/**
+ * @brief: free all the blocks of an arena
+ *
+ * @param arena: the arena
+ */
+void cfio_mem_arena_final(cfio_mem_arena_t *arena);
+
+#endif
@@ -17,6 +17,7 @@
 #include <assert.h>
 
 #include "msg.h"
+#include "mem.h"
 #include "debug.h"
 #include "times.h"
 #include "map.h"
@@ -28,10 +29,29 @@
 #define min(a,b) (a<b?a:b)
 #define max(a,b) (a>b?a:b)
 
+/* msgs of the server are created and freed in different threads, the pool 
+ * is locked. the client mallocs each msg, for its model thread does not take 
+ * a lock for a msg */
+static cfio_mem_slab_t msg_slab = 
+    CFIO_MEM_SLAB_INITIALIZER(sizeof(cfio_msg_t), MSG_SLAB_NUM);
+static int pooled = 0;
+
+void cfio_msg_init(int use_pool)
+{
+    pooled = use_pool;
+}
+
 cfio_msg_t *cfio_msg_create()
 {
     cfio_msg_t *msg;
-    msg = malloc(sizeof(cfio_msg_t));
+
+    if(pooled)
+    {
+	msg = cfio_mem_slab_alloc(&msg_slab);
+    }else
+    {
+	msg = malloc(sizeof(cfio_msg_t));
+    }
     if(NULL == msg)
     {
 	return NULL;
@@ -41,6 +61,22 @@ cfio_msg_t *cfio_msg_create()
     return msg;
 }
 
+void cfio_msg_free(cfio_msg_t *msg)
+{
+    if(pooled)
+    {
+	cfio_mem_slab_free(&msg_slab, msg);
+    }else
+    {
+	free(msg);
+    }
+}
+
+void cfio_msg_final()
+{
+    cfio_mem_slab_final(&msg_slab);
+}
+
 int cfio_msg_get_max_size(int proc_id)
 {   
     int client_num_of_server, max_msg_size, client_amount, server_id; 
@@ -26,10 +26,19 @@
 #define FUNC_NC_CREATE		((uint32_t)1)
 #define FUNC_NC_ENDDEF		((uint32_t)2)
 #define FUNC_NC_CLOSE		((uint32_t)3)
+/* create a nc and define it with the schema of a template nc */
+#define FUNC_NC_CREATE_TEMPLATE	((uint32_t)4)
 #define FUNC_NC_DEF_DIM		((uint32_t)11)
 #define FUNC_NC_DEF_VAR		((uint32_t)12)
 #define FUNC_PUT_ATT		((uint32_t)13)
+/* only the start and count of a def_var, sent by the clients which are not 
+ * the meta leader of their server */
+#define FUNC_NC_DEF_VAR_DECOMP	((uint32_t)14)
 #define FUNC_NC_PUT_VARA	((uint32_t)20)
+/* a chunk of a put_vara whose data is larger than the max msg size */
+#define FUNC_NC_PUT_VARA_CHUNK	((uint32_t)21)
+/* many small put_vara of one nc in one msg, only in the v2 wire format */
+#define FUNC_NC_PUT_VARA_BATCH	((uint32_t)22)
 #define FUNC_IO_END		((uint32_t)30)
 #define FUNC_FINAL		((uint32_t)40)
 /* below two are only used in io.c */
@@ -39,6 +48,70 @@
 //define for msg buf size in a proc
 #define MSG_BUF_SIZE ((size_t)512*1024)
 
+/**
+ * version of the wire format, in the top byte of the func code of a msg, 0 
+ * there means v1. a v1 msg is its size and func code followed by the fields
+ * packed one by one. a v2 msg starts with a fixed head cfio_msg_head_t, its 
+ * size is a multiple of CFIO_MSG_ALIGN so the msgs put one after another 
+ * stay aligned, and the data of a put_vara starts at an aligned offset
+ **/
+#define CFIO_MSG_V1		1
+#define CFIO_MSG_V2		2
+#define CFIO_MSG_VERSION_SHIFT	24
+#define CFIO_MSG_FUNC_MASK	((uint32_t)0xFFFFFF)
+#define CFIO_MSG_ALIGN		((size_t)64)
+#define cfio_msg_align(size) \
+    (((size) + CFIO_MSG_ALIGN - 1) & ~(CFIO_MSG_ALIGN - 1))
+/* version of a msg with the func code */
+#define cfio_msg_version(code) \
+    (0 == ((code) >> CFIO_MSG_VERSION_SHIFT) ? CFIO_MSG_V1 : \
+     (code) >> CFIO_MSG_VERSION_SHIFT)
+/* func code of a msg without the version */
+#define cfio_msg_func(code) ((code) & CFIO_MSG_FUNC_MASK)
+/* get the func code of a msg which is not unpacked */
+#define cfio_msg_peek_func(addr) \
+    cfio_msg_func(*((uint32_t *)((addr) + sizeof(size_t))))
+
+/**
+ * fixed head of a v2 msg, size and code are at the same place as in v1. the
+ * body of a msg starts at body_off, for a put_vara it is the start and count
+ * vectors, else the fields of v1 after the func code. the fields of a 
+ * put_vara are in the head, the others are 0
+ **/
+typedef struct
+{
+    size_t size;	/* size of the msg */
+    uint32_t code;	/* func code with the version */
+    uint32_t body_off;	/* offset of the body in the msg */
+    uint32_t data_off;	/* offset of the data of a put_vara, aligned */
+    int ncid;
+    int varid;
+    int ndims;
+    int type;		/* type of the data */
+    int data_len;	/* amount of elements of the data in the msg */
+    size_t total_len;	/* amount of elements of the whole put_vara */
+}cfio_msg_head_t;
+
+/* space of the head in a v2 msg */
+#define CFIO_MSG_HEAD_SIZE cfio_msg_align(sizeof(cfio_msg_head_t))
+
+/**
+ * head of a record in a FUNC_NC_PUT_VARA_BATCH msg. the ncid of the records 
+ * and their amount (in data_len) are in the head of the msg, the records 
+ * follow it at body_off one after another. each record is its head, the start
+ * and count vectors, and the data at data_off, the size of a record is a 
+ * multiple of CFIO_MSG_ALIGN
+ **/
+typedef struct
+{
+    uint32_t size;	/* size of the record */
+    uint32_t data_off;	/* offset of the data in the record, aligned */
+    int varid;
+    int ndims;
+    int type;		/* type of the data */
+    int data_len;	/* amount of elements of the data */
+}cfio_msg_rec_t;
+
 typedef struct
 {
     uint32_t func_code;	/* function code , like FUNC_NC_CREATE */
@@ -48,10 +121,42 @@ typedef struct
     int dst;		/* id of dst porc */  
     MPI_Comm comm;	/* communication  */
     MPI_Request req;	/* MPI request of the send msg */
+    char *data;		/* data sent behind addr without copy, NULL if the 
+			   whole msg is in addr */
+    size_t data_size;	/* size of data, included in size */
+    cfio_buf_t *head_buf;
+			/* buffer of the msg head if data is not NULL */
+    int *sent_num;	/* increased when the msg with data is sent */
     qlist_head_t link;	/* quicklist head */
 }cfio_msg_t;
 
+/* amount of msgs malloced at a time */
+#define MSG_SLAB_NUM 256
+
+/**
+ * @brief: choose where the msgs come from, not calling it is the same as 
+ *	passing 0
+ *
+ * @param use_pool: 1 to get the msgs from the locked pool, for the server 
+ *	whose msgs are freed by other threads, 0 to malloc each msg
+ */
+void cfio_msg_init(int use_pool);
+/**
+ * @brief: get a zeroed msg from the msg pool, or malloced
+ *
+ * @return: the msg, NULL if malloc fail
+ */
 cfio_msg_t *cfio_msg_create();
+/**
+ * @brief: give a msg got by cfio_msg_create back to the msg pool, or free it
+ *
+ * @param msg: the msg, can be NULL
+ */
+void cfio_msg_free(cfio_msg_t *msg);
+/**
+ * @brief: free the msg pool, all msgs must have been freed
+ */
+void cfio_msg_final();
 
 int cfio_msg_get_max_size(int proc_id);
 #endif
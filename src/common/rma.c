@@ -0,0 +1,147 @@
+/****************************************************************************
+ *       Filename:  rma.c
+ *
+ *    Description:  one-sided transport, the server pulls the msgs of a
+ *		    client from the client's buffer with MPI_Get
+ *
+ *        Version:  1.0
+ *        Created:  10/17/2026 04:10:52 PM
+ *       Revision:  none
+ *       Compiler:  gcc
+ ***************************************************************************/
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+
+#include "rma.h"
+#include "map.h"
+#include "msg.h"
+#include "conf.h"
+#include "debug.h"
+#include "cfio_error.h"
+
+static MPI_Win win = MPI_WIN_NULL;
+static MPI_Comm comm;
+static int rank;
+/* start of the window in this proc, the release offset is at its head */
+static char *base = NULL;
+
+#define max(a,b) (a>b?a:b)
+
+int cfio_rma_used(int client_id)
+{
+    if(!cfio_conf_get_rma() ||
+	    cfio_map_proc_type(client_id) != CFIO_MAP_TYPE_CLIENT)
+    {
+	return 0;
+    }
+
+    /* shared memory is better on the same node */
+    return !(cfio_conf_get_shm() && cfio_map_same_node(client_id,
+		cfio_map_get_server_of_client(client_id)));
+}
+
+size_t cfio_rma_get_buf_size(int client_id)
+{
+    /* the buffer holds several max size msgs, so the client can pack the 
+     * next msg while the server pulls */
+    return max(RMA_BUF_SIZE, 4 * (size_t)cfio_msg_get_max_size(client_id));
+}
+
+int cfio_rma_init()
+{
+    MPI_Aint size = 0;
+
+    comm = cfio_map_get_comm();
+    MPI_Comm_rank(comm, &rank);
+
+    if(!cfio_conf_get_rma())
+    {
+	return CFIO_ERROR_NONE;
+    }
+
+    if(cfio_rma_used(rank))
+    {
+	size = RMA_HEAD_SIZE + cfio_rma_get_buf_size(rank);
+    }
+    if(MPI_SUCCESS != MPI_Win_allocate(size, 1, MPI_INFO_NULL, comm,
+		&base, &win))
+    {
+	error("allocate window fail.");
+	return CFIO_ERROR_MPI;
+    }
+    if(size > 0)
+    {
+	*((uint64_t *)base) = 0;
+    }
+
+    /* the window is always open, the servers get from it and the clients
+     * read their release offset at any time */
+    MPI_Win_lock_all(MPI_MODE_NOCHECK, win);
+    MPI_Win_sync(win);
+    MPI_Barrier(comm);
+
+    debug(DEBUG_RMA, "success return.");
+    return CFIO_ERROR_NONE;
+}
+
+int cfio_rma_final()
+{
+    if(MPI_WIN_NULL != win)
+    {
+	MPI_Win_unlock_all(win);
+	MPI_Win_free(&win);
+	base = NULL;
+    }
+
+    return CFIO_ERROR_NONE;
+}
+
+char *cfio_rma_get_buf()
+{
+    if(!cfio_rma_used(rank))
+    {
+	return NULL;
+    }
+
+    return base + RMA_HEAD_SIZE;
+}
+
+size_t cfio_rma_released()
+{
+    uint64_t off;
+
+    /* the offset is put by the server with an atomic op, so read it with one
+     * too */
+    MPI_Fetch_and_op(NULL, &off, MPI_UINT64_T, rank, 0, MPI_NO_OP, win);
+    MPI_Win_flush(rank, win);
+
+    return off;
+}
+
+int cfio_rma_get(int client_id, size_t off, size_t size, char *addr)
+{
+    debug(DEBUG_RMA, "get %lu bytes at %lu from client(%d)", size, off,
+	    client_id);
+
+    if(MPI_SUCCESS != MPI_Get(addr, size, MPI_BYTE, client_id,
+		RMA_HEAD_SIZE + off, size, MPI_BYTE, win) ||
+	    MPI_SUCCESS != MPI_Win_flush(client_id, win))
+    {
+	error("get from client(%d) fail.", client_id);
+	return CFIO_ERROR_MPI;
+    }
+
+    return CFIO_ERROR_NONE;
+}
+
+int cfio_rma_release(int client_id, size_t off)
+{
+    uint64_t _off = off;
+
+    MPI_Accumulate(&_off, 1, MPI_UINT64_T, client_id, 0, 1, MPI_UINT64_T,
+	    MPI_REPLACE, win);
+    MPI_Win_flush(client_id, win);
+
+    return CFIO_ERROR_NONE;
+}
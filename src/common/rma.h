@@ -0,0 +1,91 @@
+/****************************************************************************
+ *       Filename:  rma.h
+ *
+ *    Description:  one-sided transport, the server pulls the msgs of a
+ *		    client from the client's buffer with MPI_Get
+ *
+ *        Version:  1.0
+ *        Created:  10/17/2026 04:02:19 PM
+ *       Revision:  none
+ *       Compiler:  gcc
+ ***************************************************************************/
+#ifndef _RMA_H
+#define _RMA_H
+#include <stdlib.h>
+
+#include "mpi.h"
+
+/* min size of the buffer of a client in its window, the buffer is kept 
+ * small for it may be registered or shared memory */
+#define RMA_BUF_SIZE ((size_t)64*1024*1024)
+/* size of the head of a client's window, the buffer follows it */
+#define RMA_HEAD_SIZE 64
+/* a client sends only the place of a msg in its buffer, off and size */
+#define RMA_DESC_LEN 2
+
+/**
+ * @brief: create the window over the buffers of the clients which are pulled
+ *	by their server, must be called by all procs after cfio_shm_init
+ *
+ * @return: error code
+ */
+int cfio_rma_init();
+/**
+ * @brief: free the window, must be called by all procs after the server has
+ *	pulled all msgs of its clients
+ *
+ * @return: error code
+ */
+int cfio_rma_final();
+/**
+ * @brief: whether a client's msgs are pulled by its server
+ *
+ * @param client_id: the client's id
+ *
+ * @return: 1 if yes, 0 if not
+ */
+int cfio_rma_used(int client_id);
+/**
+ * @brief: get the buffer of this client in the window
+ *
+ * @return: start address of the buffer, NULL if the client is not pulled
+ */
+char *cfio_rma_get_buf();
+/**
+ * @brief: get the size of the buffer of a client in its window
+ *
+ * @param client_id: the client's id
+ *
+ * @return: size of the buffer
+ */
+size_t cfio_rma_get_buf_size(int client_id);
+/**
+ * @brief: get the offset in this client's buffer before which the space has
+ *	been pulled by the server
+ *
+ * @return: the offset
+ */
+size_t cfio_rma_released();
+/**
+ * @brief: pull a msg from a client's buffer, called by the server
+ *
+ * @param client_id: the client's id
+ * @param off: offset of the msg in the client's buffer
+ * @param size: size of the msg
+ * @param addr: where the msg is to be stored
+ *
+ * @return: error code
+ */
+int cfio_rma_get(int client_id, size_t off, size_t size, char *addr);
+/**
+ * @brief: give back the space before off in a client's buffer, called by the
+ *	server after the msgs before off are pulled
+ *
+ * @param client_id: the client's id
+ * @param off: the offset
+ *
+ * @return: error code
+ */
+int cfio_rma_release(int client_id, size_t off);
+
+#endif
@@ -0,0 +1,176 @@
+/****************************************************************************
+ *       Filename:  shm.c
+ *
+ *    Description:  shared memory transport between a client and its server
+ *		    on the same node, the shared memory is a MPI-3 shared
+ *		    window over the procs of each node
+ *
+ *        Version:  1.0
+ *        Created:  10/17/2026 02:25:13 PM
+ *       Revision:  none
+ *       Compiler:  gcc
+ ***************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "shm.h"
+#include "map.h"
+#include "msg.h"
+#include "conf.h"
+#include "debug.h"
+#include "cfio_error.h"
+
+#define max(a,b) (a>b?a:b)
+
+static MPI_Comm node_comm = MPI_COMM_NULL;
+static MPI_Win win = MPI_WIN_NULL;
+static int proc_amount;
+/* shared memory of each client which this proc can reach */
+static cfio_shm_t **client_shm = NULL;
+
+/**
+ * @brief: whether a client talks to its server through shared memory
+ *
+ * @param client_id: the client's id
+ *
+ * @return: 1 if yes, 0 if not
+ */
+static int _use_shm(int client_id)
+{
+    if(!cfio_conf_get_shm() ||
+	    cfio_map_proc_type(client_id) != CFIO_MAP_TYPE_CLIENT)
+    {
+	return 0;
+    }
+
+    return cfio_map_same_node(client_id,
+	    cfio_map_get_server_of_client(client_id));
+}
+
+size_t cfio_shm_get_buf_size(int client_id)
+{
+    /* the ring holds several max size msgs, so the client can pack the next
+     * msg while the server decodes */
+    return max(SHM_BUF_SIZE, 4 * (size_t)cfio_msg_get_max_size(client_id));
+}
+
+int cfio_shm_init()
+{
+    MPI_Comm comm;
+    MPI_Group group, node_group;
+    MPI_Info info;
+    MPI_Aint size;
+    int rank, node_rank, disp_unit;
+    int *client_id, client_num;
+    int i;
+    void *base;
+
+    comm = cfio_map_get_comm();
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &proc_amount);
+
+    client_shm = malloc(proc_amount * sizeof(cfio_shm_t *));
+    if(NULL == client_shm)
+    {
+	error("malloc fail.");
+	return CFIO_ERROR_MALLOC;
+    }
+    for(i = 0; i < proc_amount; i ++)
+    {
+	client_shm[i] = NULL;
+    }
+
+    if(MPI_SUCCESS != MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, rank,
+		MPI_INFO_NULL, &node_comm))
+    {
+	error("split comm by node fail.");
+	return CFIO_ERROR_MPI;
+    }
+
+    size = 0;
+    if(_use_shm(rank))
+    {
+	size = sizeof(cfio_shm_t) + cfio_shm_get_buf_size(rank);
+    }
+    /* each segment is placed near the client who first touches it */
+    MPI_Info_create(&info);
+    MPI_Info_set(info, "alloc_shared_noncontig", "true");
+    if(MPI_SUCCESS != MPI_Win_allocate_shared(size, 1, info, node_comm,
+		&base, &win))
+    {
+	MPI_Info_free(&info);
+	error("allocate shared memory fail.");
+	return CFIO_ERROR_MPI;
+    }
+    MPI_Info_free(&info);
+
+    if(size > 0)
+    {
+	client_shm[rank] = base;
+	memset(base, 0, sizeof(cfio_shm_t));
+    }
+
+    if(cfio_map_proc_type(rank) == CFIO_MAP_TYPE_SERVER)
+    {
+	client_num = cfio_map_get_client_num_of_server(rank);
+	client_id = malloc(client_num * sizeof(int));
+	if(NULL == client_id)
+	{
+	    error("malloc fail.");
+	    return CFIO_ERROR_MALLOC;
+	}
+	cfio_map_get_clients(rank, client_id);
+
+	MPI_Comm_group(comm, &group);
+	MPI_Comm_group(node_comm, &node_group);
+	for(i = 0; i < client_num; i ++)
+	{
+	    if(!_use_shm(client_id[i]))
+	    {
+		continue;
+	    }
+	    MPI_Group_translate_ranks(group, 1, &client_id[i], node_group,
+		    &node_rank);
+	    MPI_Win_shared_query(win, node_rank, &size, &disp_unit, &base);
+	    client_shm[client_id[i]] = base;
+	    debug(DEBUG_SHM, "server(%d) reach client(%d) by shared memory",
+		    rank, client_id[i]);
+	}
+	MPI_Group_free(&group);
+	MPI_Group_free(&node_group);
+	free(client_id);
+    }
+
+    /* the heads are cleared before any msg is put */
+    MPI_Barrier(node_comm);
+
+    debug(DEBUG_SHM, "success return.");
+    return CFIO_ERROR_NONE;
+}
+
+int cfio_shm_final()
+{
+    if(MPI_WIN_NULL != win)
+    {
+	MPI_Win_free(&win);
+    }
+    if(MPI_COMM_NULL != node_comm)
+    {
+	MPI_Comm_free(&node_comm);
+    }
+    if(NULL != client_shm)
+    {
+	free(client_shm);
+	client_shm = NULL;
+    }
+
+    return CFIO_ERROR_NONE;
+}
+
+cfio_shm_t *cfio_shm_get_client(int client_id)
+{
+    assert(client_id >= 0 && client_id < proc_amount);
+
+    return client_shm[client_id];
+}
@@ -0,0 +1,138 @@
+/****************************************************************************
+ *       Filename:  shm.h
+ *
+ *    Description:  shared memory transport between a client and its server
+ *		    on the same node
+ *
+ *        Version:  1.0
+ *        Created:  10/17/2026 02:10:45 PM
+ *       Revision:  none
+ *       Compiler:  gcc
+ ***************************************************************************/
+#ifndef _SHM_H
+#define _SHM_H
+#include <stdlib.h>
+
+#include "mpi.h"
+
+/* min size of the ring of a client in shared memory */
+#define SHM_BUF_SIZE ((size_t)64*1024*1024)
+/* length of the msg queue from a client to its server */
+#define SHM_QUEUE_LEN 1024
+#define SHM_CACHE_LINE 64
+
+/**
+ * the head of the shared memory of a client, the ring of the client follows
+ * it. the client packs msgs into the ring and puts their place at the tail of
+ * the queue, the server decodes the msgs in place and gives back the space
+ * before release_off. queue_tail is only changed by the client, queue_head
+ * and release_off only by the server
+ **/
+typedef struct
+{
+    volatile size_t queue_tail;	/* amount of msgs put by the client */
+    char pad0[SHM_CACHE_LINE - sizeof(size_t)];
+    volatile size_t queue_head;	/* amount of msgs got by the server */
+    volatile size_t release_off;/* offset in the ring, the space before it
+				   can be reused by the client */
+    char pad1[SHM_CACHE_LINE - 2 * sizeof(size_t)];
+    size_t off[SHM_QUEUE_LEN];	/* offset of each msg in the ring */
+    size_t size[SHM_QUEUE_LEN];	/* size of each msg */
+}cfio_shm_t;
+
+#define cfio_shm_ring(shm) ((char *)(shm) + sizeof(cfio_shm_t))
+
+/**
+ * @brief: put a msg at the tail of the queue, only called by the client
+ *
+ * @param shm: the shared memory of the client
+ * @param off: offset of the msg in the ring
+ * @param size: size of the msg
+ *
+ * @return: 1 if put, 0 if the queue is full
+ */
+static inline int cfio_shm_put(cfio_shm_t *shm, size_t off, size_t size)
+{
+    size_t tail = shm->queue_tail;
+
+    if(tail - __atomic_load_n(&shm->queue_head, __ATOMIC_ACQUIRE)
+	    >= SHM_QUEUE_LEN)
+    {
+	return 0;
+    }
+    shm->off[tail % SHM_QUEUE_LEN] = off;
+    shm->size[tail % SHM_QUEUE_LEN] = size;
+    __atomic_store_n(&shm->queue_tail, tail + 1, __ATOMIC_RELEASE);
+
+    return 1;
+}
+
+/**
+ * @brief: get the msg at the head of the queue, only called by the server
+ *
+ * @param shm: the shared memory of the client
+ * @param off: pointer to where the offset of the msg is to be stored
+ * @param size: pointer to where the size of the msg is to be stored
+ *
+ * @return: 1 if got, 0 if the queue is empty
+ */
+static inline int cfio_shm_get(cfio_shm_t *shm, size_t *off, size_t *size)
+{
+    size_t head = shm->queue_head;
+
+    if(__atomic_load_n(&shm->queue_tail, __ATOMIC_ACQUIRE) == head)
+    {
+	return 0;
+    }
+    *off = shm->off[head % SHM_QUEUE_LEN];
+    *size = shm->size[head % SHM_QUEUE_LEN];
+    __atomic_store_n(&shm->queue_head, head + 1, __ATOMIC_RELEASE);
+
+    return 1;
+}
+
+/**
+ * @brief: give back the ring space before off to the client, only called by
+ *	the server when the msgs before off are decoded
+ */
+#define cfio_shm_release(shm, _off) \
+    __atomic_store_n(&(shm)->release_off, (_off), __ATOMIC_RELEASE)
+/**
+ * @brief: get the offset before which the ring space can be reused
+ */
+#define cfio_shm_released(shm) \
+    __atomic_load_n(&(shm)->release_off, __ATOMIC_ACQUIRE)
+
+/**
+ * @brief: allocate the shared memory of the clients who are on the same node
+ *	with their server, must be called by all procs after cfio_map_init
+ *
+ * @return: error code
+ */
+int cfio_shm_init();
+/**
+ * @brief: free the shared memory, must be called by all procs after the
+ *	server has decoded all msgs of its clients
+ *
+ * @return: error code
+ */
+int cfio_shm_final();
+/**
+ * @brief: get the shared memory of a client, in the client itself or in its
+ *	server
+ *
+ * @param client_id: the client's id
+ *
+ * @return: the shared memory, NULL if the client talks to its server by MPI
+ */
+cfio_shm_t *cfio_shm_get_client(int client_id);
+/**
+ * @brief: get the size of the ring of a client in shared memory
+ *
+ * @param client_id: the client's id
+ *
+ * @return: size of the ring
+ */
+size_t cfio_shm_get_buf_size(int client_id);
+
+#endif
@@ -2,6 +2,7 @@
 #include <stdlib.h>
 #include <sys/time.h>
 #include <assert.h>
+#include <sched.h>
 
 #include "debug.h"
 #include "times.h"
@@ -91,3 +92,22 @@ double times_end()
 
     return (cur_time - start_time);
 }
+
+void times_backoff(int *spin)
+{
+    struct timespec ts;
+
+    (*spin) ++;
+    if(*spin < TIMES_SPIN_NUM)
+    {
+	return;
+    }else if(*spin < TIMES_SPIN_NUM + TIMES_YIELD_NUM)
+    {
+	sched_yield();
+    }else
+    {
+	ts.tv_sec = 0;
+	ts.tv_nsec = TIMES_SLEEP_NSEC;
+	nanosleep(&ts, NULL);
+    }
+}
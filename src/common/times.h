@@ -5,6 +5,11 @@
 #include <sys/time.h>
 
 #define TIMES_STACK_INIT_SIZE 512
+/* how a thread waits for something not ready: spin TIMES_SPIN_NUM, then 
+ * yield TIMES_YIELD_NUM, then sleep TIMES_SLEEP_NSEC each time */
+#define TIMES_SPIN_NUM 1000
+#define TIMES_YIELD_NUM 1000
+#define TIMES_SLEEP_NSEC 20000
 
 typedef struct time_stack_s
 {
@@ -44,5 +49,13 @@ int times_start();
  * @return: time between start tag and end tag
  */
 double times_end();
+/**
+ * @brief: wait a moment when something is not ready, spin first, then yield 
+ *	the cpu, then sleep, so a idle thread does not eat the cpu of others
+ *
+ * @param spin: pointer to the times already waited, set to 0 before the 
+ *	first wait
+ */
+void times_backoff(int *spin);
 
 #endif
@@ -0,0 +1,257 @@
+/****************************************************************************
+ *       Filename:  assemble.c
+ *
+ *    Description:  assemble sub-arrays recieved from clients into the array
+ *		    which is written by server
+ *
+ *        Version:  1.0
+ *        Created:  10/17/2026 02:25:13 PM
+ *       Revision:  none
+ *       Compiler:  gcc
+ ***************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "assemble.h"
+#include "debug.h"
+#include "cfio_error.h"
+
+/**
+ * copy a run of len elements, the element size is a constant so the small 
+ * memcpy becomes a single move, and the loop can be vectorized. src and dst
+ * may be unaligned because msgs are packed without padding
+ **/
+#define DEF_COPY_RUN(size) \
+static inline void _copy_run_##size(char *dst, const char *src, size_t len) \
+{ \
+    size_t i; \
+    if(len * size >= ASSEMBLE_MEMCPY_MIN) \
+    { \
+	memcpy(dst, src, len * size); \
+	return; \
+    } \
+    for(i = 0; i < len; i ++) \
+    { \
+	memcpy(dst + i * size, src + i * size, size); \
+    } \
+}
+
+DEF_COPY_RUN(1)
+DEF_COPY_RUN(2)
+DEF_COPY_RUN(4)
+DEF_COPY_RUN(8)
+
+/**
+ * copy src into dst, count and dst_stride are the collapsed dims, the last
+ * dim is the run, dst_stride is in bytes, src is dense
+ **/
+#define DEF_ASSEMBLE(size) \
+static void _assemble_##size(int ndims, const size_t *count, \
+	const size_t *dst_stride, char *dst, const char *src) \
+{ \
+    size_t i, j, k; \
+    size_t run = count[ndims - 1]; \
+    size_t run_size = run * size; \
+    switch(ndims) \
+    { \
+	case 1 : \
+	    _copy_run_##size(dst, src, run); \
+	    break; \
+	case 2 : \
+	    for(i = 0; i < count[0]; i ++) \
+	    { \
+		_copy_run_##size(dst + i * dst_stride[0], src, run); \
+		src += run_size; \
+	    } \
+	    break; \
+	case 3 : \
+	    for(i = 0; i < count[0]; i ++) \
+	    { \
+		for(j = 0; j < count[1]; j ++) \
+		{ \
+		    _copy_run_##size(dst + i * dst_stride[0] + \
+			    j * dst_stride[1], src, run); \
+		    src += run_size; \
+		} \
+	    } \
+	    break; \
+	case 4 : \
+	    for(i = 0; i < count[0]; i ++) \
+	    { \
+		for(j = 0; j < count[1]; j ++) \
+		{ \
+		    for(k = 0; k < count[2]; k ++) \
+		    { \
+			_copy_run_##size(dst + i * dst_stride[0] + \
+				j * dst_stride[1] + k * dst_stride[2], \
+				src, run); \
+			src += run_size; \
+		    } \
+		} \
+	    } \
+	    break; \
+    } \
+}
+
+DEF_ASSEMBLE(1)
+DEF_ASSEMBLE(2)
+DEF_ASSEMBLE(4)
+DEF_ASSEMBLE(8)
+
+/**
+ * @brief: copy src into dst for any collapsed ndims and element size, the run
+ *	is copied by memcpy
+ *
+ * @param ndims: number of collapsed dims
+ * @param ele_size: size of each element
+ * @param count: count of each collapsed dim
+ * @param dst_stride: dst stride in bytes of each collapsed dim
+ * @param dst: the dst
+ * @param src: the src, dense
+ * @param index: space for ndims index
+ */
+static void _assemble_generic(int ndims, size_t ele_size, 
+	const size_t *count, const size_t *dst_stride, 
+	char *dst, const char *src, size_t *index)
+{
+    int i;
+    size_t run_size = count[ndims - 1] * ele_size;
+
+    for(i = 0; i < ndims; i ++)
+    {
+	index[i] = 0;
+    }
+
+    while(1)
+    {
+	memcpy(dst, src, run_size);
+	src += run_size;
+
+	i = ndims - 2;
+	while(i >= 0)
+	{
+	    index[i] ++;
+	    dst += dst_stride[i];
+	    if(index[i] < count[i])
+	    {
+		break;
+	    }
+	    dst -= index[i] * dst_stride[i];
+	    index[i] = 0;
+	    i --;
+	}
+	if(i < 0)
+	{
+	    break;
+	}
+    }
+}
+
+int cfio_assemble_put(
+	int ndims, size_t ele_size,
+	const size_t *dst_start, const size_t *dst_count, char *dst_data, 
+	const size_t *src_start, const size_t *src_count, const char *src_data)
+{
+    int i, n;
+    size_t stride, offset;
+    size_t stack_space[3 * (ASSEMBLE_STACK_DIMS + 1)];
+    size_t *space, *count, *dst_stride, *index;
+
+    assert(NULL != dst_start);
+    assert(NULL != dst_count);
+    assert(NULL != dst_data);
+    assert(NULL != src_start);
+    assert(NULL != src_count);
+    assert(NULL != src_data);
+
+    for(i = 0; i < ndims; i ++)
+    {
+	if(0 == src_count[i])
+	{
+	    return CFIO_ERROR_NONE;
+	}
+    }
+    if(ndims <= ASSEMBLE_STACK_DIMS)
+    {
+	space = stack_space;
+    }else
+    {
+	space = malloc(3 * (ndims + 1) * sizeof(size_t));
+	if(NULL == space)
+	{
+	    error("malloc for assemble dims fail.");
+	    return CFIO_ERROR_MALLOC;
+	}
+    }
+    /* at most ndims + 1 collapsed dims */
+    count = space;
+    dst_stride = space + ndims + 1;
+    index = space + 2 * (ndims + 1);
+
+    /**
+     * from innermost dim to outermost, a dim is merged into the inner 
+     * collapsed dim if the inner one covers its whole dst stride, dims with 
+     * count 1 are dropped. the collapsed dims are built reversed in count and
+     * dst_stride, starting from a run of 1 element so that the innermost 
+     * collapsed dim is always contiguous
+     **/
+    count[0] = 1;
+    dst_stride[0] = ele_size;
+    n = 1;
+    stride = ele_size;
+    offset = 0;
+    for(i = ndims - 1; i >= 0; i --)
+    {
+	offset += (src_start[i] - dst_start[i]) * stride;
+	if(count[n - 1] * dst_stride[n - 1] == stride)
+	{
+	    count[n - 1] *= src_count[i];
+	}else if(1 != src_count[i])
+	{
+	    count[n] = src_count[i];
+	    dst_stride[n] = stride;
+	    n ++;
+	}
+	stride *= dst_count[i];
+    }
+    dst_data += offset;
+
+    /* reverse to outermost first, the run is count in elements */
+    for(i = 0; i < n / 2; i ++)
+    {
+	stride = count[i]; count[i] = count[n - 1 - i]; count[n - 1 - i] = stride;
+	stride = dst_stride[i]; dst_stride[i] = dst_stride[n - 1 - i]; 
+	dst_stride[n - 1 - i] = stride;
+    }
+
+    debug(DEBUG_IO, "collapsed ndims = %d, run = %lu", n, count[n - 1]);
+
+    if(n <= 4)
+    {
+	switch(ele_size)
+	{
+	    case 1 :
+		_assemble_1(n, count, dst_stride, dst_data, src_data);
+		goto RETURN;
+	    case 2 :
+		_assemble_2(n, count, dst_stride, dst_data, src_data);
+		goto RETURN;
+	    case 4 :
+		_assemble_4(n, count, dst_stride, dst_data, src_data);
+		goto RETURN;
+	    case 8 :
+		_assemble_8(n, count, dst_stride, dst_data, src_data);
+		goto RETURN;
+	}
+    }
+    _assemble_generic(n, ele_size, count, dst_stride, 
+	    dst_data, src_data, index);
+
+RETURN:
+    if(space != stack_space)
+    {
+	free(space);
+    }
+    return CFIO_ERROR_NONE;
+}
@@ -0,0 +1,44 @@
+/****************************************************************************
+ *       Filename:  assemble.h
+ *
+ *    Description:  assemble sub-arrays recieved from clients into the array
+ *		    which is written by server
+ *
+ *        Version:  1.0
+ *        Created:  10/17/2026 02:21:40 PM
+ *       Revision:  none
+ *       Compiler:  gcc
+ ***************************************************************************/
+#ifndef _ASSEMBLE_H
+#define _ASSEMBLE_H
+#include <stdlib.h>
+
+/* runs shorter than this are copied element by element, longer by memcpy */
+#define ASSEMBLE_MEMCPY_MIN 64
+/* dims more than this need malloc for the collapsed dims */
+#define ASSEMBLE_STACK_DIMS 16
+
+/**
+ * @brief: put the src data array into the dst data array, src and dst both are
+ *	sub-array of a total data array, src must be inside dst. Dimensions 
+ *	which are contiguous in both src and dst are collapsed, and the data is
+ *	copied by innermost runs with kernels for element size 1, 2, 4, 8 and 
+ *	1 to 4 collapsed dimensions
+ *
+ * @param ndims: number of dimensions for the variable
+ * @param ele_size: size of each element in the variable array
+ * @param dst_start: start index of the dst data array
+ * @param dst_count: count of the dst data array
+ * @param dst_data: pointer to the dst data array
+ * @param src_start: start index of the src data array
+ * @param src_count: count of the src data array
+ * @param src_data: pointer to the src data array
+ *
+ * @return: error code
+ */
+int cfio_assemble_put(
+	int ndims, size_t ele_size,
+	const size_t *dst_start, const size_t *dst_count, char *dst_data, 
+	const size_t *src_start, const size_t *src_count, const char *src_data);
+
+#endif
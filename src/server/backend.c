@@ -0,0 +1,94 @@
+/****************************************************************************
+ *       Filename:  backend.c
+ *
+ *    Description:  selection of the output engine, and the null engine which
+ *		    drops everything
+ *
+ *        Version:  1.0
+ *        Created:  10/17/2026 10:38:02 PM
+ *       Revision:  none
+ *       Compiler:  gcc
+ ***************************************************************************/
+#include "backend.h"
+#include "conf.h"
+#include "debug.h"
+
+/* ids given by the null engine, they are only to be told apart in debug */
+static int null_id = 0;
+
+static int _null_create(MPI_Comm comm, const char *path, int cmode,
+	int *nc_id)
+{
+    *nc_id = null_id ++;
+    return NC_NOERR;
+}
+
+static int _null_def_dim(int nc_id, const char *name, MPI_Offset len,
+	int *dim_id)
+{
+    *dim_id = null_id ++;
+    return NC_NOERR;
+}
+
+static int _null_def_var(int nc_id, const char *name, cfio_type type,
+	int ndims, const int *dim_ids, int *var_id)
+{
+    *var_id = null_id ++;
+    return NC_NOERR;
+}
+
+static int _null_put_att(int nc_id, int var_id, const char *name,
+	cfio_type type, MPI_Offset len, const void *data)
+{
+    return NC_NOERR;
+}
+
+static int _null_enddef(int nc_id)
+{
+    return NC_NOERR;
+}
+
+static int _null_put_vara(int nc_id, int var_id,
+	const MPI_Offset *start, const MPI_Offset *count,
+	const void *buf, MPI_Offset bufcount, MPI_Datatype buftype)
+{
+    return NC_NOERR;
+}
+
+static int _null_put_varn(int nc_id, int var_id, int num,
+	MPI_Offset * const *starts, MPI_Offset * const *counts,
+	const void *buf, MPI_Offset bufcount, MPI_Datatype buftype)
+{
+    return NC_NOERR;
+}
+
+static int _null_close(int nc_id)
+{
+    return NC_NOERR;
+}
+
+static const char *_null_strerror(int err)
+{
+    return "null engine error";
+}
+
+cfio_backend_t cfio_backend_null =
+{
+    "null",
+    _null_create, _null_def_dim, _null_def_var, _null_put_att, _null_enddef,
+    _null_put_vara, _null_put_varn, NULL, NULL, NULL,
+    _null_close, _null_strerror
+};
+
+cfio_backend_t *cfio_backend_get(int kind)
+{
+    switch(kind)
+    {
+	case CFIO_CONF_BACKEND_RAW :
+	    return &cfio_backend_raw;
+	case CFIO_CONF_BACKEND_NULL :
+	    return &cfio_backend_null;
+	default :
+	    return &cfio_backend_pnetcdf;
+    }
+}
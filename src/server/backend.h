@@ -0,0 +1,183 @@
+/****************************************************************************
+ *       Filename:  backend.h
+ *
+ *    Description:  output engines of the server. io.c writes the nc files
+ *		    through the functions of the engine selected at init,
+ *		    see CFIO_CONF_ENV_BACKEND
+ *
+ *        Version:  1.0
+ *        Created:  10/17/2026 10:31:46 PM
+ *       Revision:  none
+ *       Compiler:  gcc
+ ***************************************************************************/
+#ifndef _BACKEND_H
+#define _BACKEND_H
+#include <stdint.h>
+
+#include "mpi.h"
+
+#include "cfio_types.h"
+#include "quicklist.h"
+
+/**
+ * an output engine. the functions follow the PnetCDF API they are named
+ * after and return NC_NOERR or an error code of the engine, which is turned
+ * into a message by strerror. the writes get the data as buf, bufcount and
+ * buftype like the flexible PnetCDF API. the create, the defs, the blocking
+ * writes, wait_all and close are collective over the comm the file is
+ * created with. iput_vara, iput_varn and wait_all are NULL if the engine
+ * can not post writes, then each var is written with a blocking write
+ **/
+typedef struct
+{
+    const char *name;
+    int (*create)(MPI_Comm comm, const char *path, int cmode, int *nc_id);
+    int (*def_dim)(int nc_id, const char *name, MPI_Offset len, int *dim_id);
+    int (*def_var)(int nc_id, const char *name, cfio_type type,
+	    int ndims, const int *dim_ids, int *var_id);
+    int (*put_att)(int nc_id, int var_id, const char *name,
+	    cfio_type type, MPI_Offset len, const void *data);
+    int (*enddef)(int nc_id);
+    int (*put_vara)(int nc_id, int var_id,
+	    const MPI_Offset *start, const MPI_Offset *count,
+	    const void *buf, MPI_Offset bufcount, MPI_Datatype buftype);
+    int (*put_varn)(int nc_id, int var_id, int num,
+	    MPI_Offset * const *starts, MPI_Offset * const *counts,
+	    const void *buf, MPI_Offset bufcount, MPI_Datatype buftype);
+    int (*iput_vara)(int nc_id, int var_id,
+	    const MPI_Offset *start, const MPI_Offset *count,
+	    const void *buf, MPI_Offset bufcount, MPI_Datatype buftype,
+	    int *req);
+    int (*iput_varn)(int nc_id, int var_id, int num,
+	    MPI_Offset * const *starts, MPI_Offset * const *counts,
+	    const void *buf, MPI_Offset bufcount, MPI_Datatype buftype,
+	    int *req);
+    int (*wait_all)(int nc_id, int num, int *reqs, int *statuses);
+    int (*close)(int nc_id);
+    const char *(*strerror)(int err);
+}cfio_backend_t;
+
+/**
+ * the raw engine writes a file as two files of each server, where rank is the
+ * rank of the server in the comm the file is created with :
+ *
+ *  path.rank.log   the data only. each block written to a var is appended
+ *		    with pwritev at a RAW_ALIGN aligned offset and padded to
+ *		    RAW_ALIGN, the log is opened with O_DIRECT if the file
+ *		    system allows it, so the data goes to the disk unbuffered
+ *		    and uncopied by the kernel
+ *  path.rank.idx   the sidecar index. it starts with a cfio_raw_head_t,
+ *		    followed by records, each starts with a cfio_raw_rec_t :
+ *  RAW_REC_DIM	    id = dim id, arg = 0, then int64 len, name
+ *  RAW_REC_VAR	    id = var id, arg = cfio_type, then int32 ndims,
+ *		    int32 dim_ids[ndims], name
+ *  RAW_REC_ATT	    id = var id or NC_GLOBAL, arg = cfio_type, then int64 len,
+ *		    name, data
+ *  RAW_REC_DATA    id = var id, arg = ndims, dtype = cfio_type, then
+ *		    int64 offset, int64 size, int64 start[ndims],
+ *		    int64 count[ndims]; the block is size bytes at offset of
+ *		    the log
+ * names end with '\0', the records are padded to 8 bytes. the files are read
+ * back into a nc file by cfio_raw2nc
+ *
+ * built with liburing, the raw engine can post writes : iput queues the
+ * writes of the blocks to an io_uring shared by the open files, up to
+ * RAW_URING_DEPTH of them in flight, and wait_all reaps them. only the raw
+ * engine uses io_uring, so subfiles use it only if they are written with
+ * CFIO_BACKEND=raw, with the default PnetCDF engine they are written by
+ * PnetCDF. the blocks not aligned in memory are copied to the engine's own
+ * RAW_URING_BUF_NUM buffers of RAW_BUF_SIZE registered to the ring, not to
+ * the assembly buffers of the server, each is reused as soon as its write
+ * completes
+ **/
+#define RAW_MAGIC	"CFIORAW"
+#define RAW_VERSION	2
+/* alignment of the blocks in the log, a multiple of the logical block size
+ * of the disks, which O_DIRECT requires */
+#define RAW_ALIGN	4096
+#define RAW_ALIGN_UP(size) \
+    (((size) + RAW_ALIGN - 1) & ~((uint64_t)RAW_ALIGN - 1))
+/* size of the aligned buffer the blocks which are not aligned in memory are
+ * copied through */
+#define RAW_BUF_SIZE	(4 * 1024 * 1024)
+/* max amount of the writes in flight in the io_uring */
+#define RAW_URING_DEPTH	    256
+/* amount of the registered RAW_BUF_SIZE buffers */
+#define RAW_URING_BUF_NUM   16
+/* max size of a write, a larger block is split */
+#define RAW_URING_IO_MAX    (1024 * 1024 * 1024)
+
+#define RAW_REC_DIM	1
+#define RAW_REC_VAR	2
+#define RAW_REC_ATT	3
+#define RAW_REC_DATA	4
+
+typedef struct
+{
+    char magic[8];	/* RAW_MAGIC */
+    uint32_t version;	/* RAW_VERSION */
+    int32_t rank;	/* rank of the server in the comm of the file */
+    int32_t size;	/* amount of servers writing the file */
+    int32_t cmode;	/* the creation mode flag */
+    uint32_t align;	/* RAW_ALIGN of the writer */
+    uint32_t reserved;
+}cfio_raw_head_t;
+
+typedef struct
+{
+    uint32_t type;	/* RAW_REC_* */
+    int32_t id;
+    int32_t arg;
+    uint32_t dtype;	/* cfio_type of the block of a RAW_REC_DATA, else 0 */
+    uint64_t size;	/* size of the record, with this head */
+}cfio_raw_rec_t;
+
+/** @brief: a file opened by the raw engine */
+typedef struct
+{
+    int nc_id;
+    int log_fd;		/* fd of the data log */
+    int idx_fd;		/* fd of the index */
+    uint64_t log_size;	/* where the next block is written in the log */
+    uint64_t idx_size;	/* where the next record is written in the index */
+    char *buf;		/* RAW_BUF_SIZE bytes, aligned to RAW_ALIGN */
+    int dim_num;	/* amount of dims defined */
+    int var_num;	/* amount of vars defined */
+    int var_max;	/* amount of vars var_type and var_ndims can hold */
+    cfio_type *var_type;
+    int *var_ndims;
+    qlist_head_t link;
+}cfio_raw_file_t;
+
+/** @brief: a write of the raw engine in flight in the io_uring */
+typedef struct
+{
+    int req;		/* index of the request it belongs to */
+    int buf;		/* index of the registered buffer it uses, -1 if none */
+    uint64_t len;	/* bytes to be written */
+}cfio_raw_io_t;
+
+/** @brief: a request posted by iput of the raw engine */
+typedef struct
+{
+    int used;
+    int pending;	/* amount of its writes in flight */
+    int status;		/* NC_NOERR or errno of the first failed write */
+    char *pack;		/* buf packed by the engine, freed at the wait */
+}cfio_raw_req_t;
+
+/* the engines, selected by CFIO_CONF_BACKEND_* */
+extern cfio_backend_t cfio_backend_pnetcdf;
+extern cfio_backend_t cfio_backend_raw;
+extern cfio_backend_t cfio_backend_null;
+
+/**
+ * @brief: get an output engine
+ *
+ * @param kind: CFIO_CONF_BACKEND_*
+ *
+ * @return: the engine, the PnetCDF engine if kind is unknown
+ */
+cfio_backend_t *cfio_backend_get(int kind);
+
+#endif
@@ -0,0 +1,116 @@
+/****************************************************************************
+ *       Filename:  backend_pnc.c
+ *
+ *    Description:  the PnetCDF output engine
+ *
+ *        Version:  1.0
+ *        Created:  10/17/2026 10:45:19 PM
+ *       Revision:  none
+ *       Compiler:  gcc
+ ***************************************************************************/
+#include <pnetcdf.h>
+
+#include "backend.h"
+
+static int _pnc_create(MPI_Comm comm, const char *path, int cmode,
+	int *nc_id)
+{
+    return ncmpi_create(comm, path, cmode, MPI_INFO_NULL, nc_id);
+}
+
+static int _pnc_def_dim(int nc_id, const char *name, MPI_Offset len,
+	int *dim_id)
+{
+    return ncmpi_def_dim(nc_id, name, len, dim_id);
+}
+
+static int _pnc_def_var(int nc_id, const char *name, cfio_type type,
+	int ndims, const int *dim_ids, int *var_id)
+{
+    return ncmpi_def_var(nc_id, name, cfio_type_to_nc(type), ndims,
+	    dim_ids, var_id);
+}
+
+static int _pnc_put_att(int nc_id, int var_id, const char *name,
+	cfio_type type, MPI_Offset len, const void *data)
+{
+    switch(type)
+    {
+	case CFIO_CHAR :
+	    return ncmpi_put_att_text(nc_id, var_id, name, len,
+		    (const char *)data);
+	case CFIO_INT :
+	    return ncmpi_put_att_int(nc_id, var_id, name,
+		    cfio_type_to_nc(type), len, (const int *)data);
+	case CFIO_FLOAT :
+	    return ncmpi_put_att_float(nc_id, var_id, name,
+		    cfio_type_to_nc(type), len, (const float *)data);
+	case CFIO_DOUBLE :
+	    return ncmpi_put_att_double(nc_id, var_id, name,
+		    cfio_type_to_nc(type), len, (const double *)data);
+	default :
+	    return NC_NOERR;
+    }
+}
+
+static int _pnc_enddef(int nc_id)
+{
+    return ncmpi_enddef(nc_id);
+}
+
+static int _pnc_put_vara(int nc_id, int var_id,
+	const MPI_Offset *start, const MPI_Offset *count,
+	const void *buf, MPI_Offset bufcount, MPI_Datatype buftype)
+{
+    return ncmpi_put_vara_all(nc_id, var_id, start, count,
+	    buf, bufcount, buftype);
+}
+
+static int _pnc_put_varn(int nc_id, int var_id, int num,
+	MPI_Offset * const *starts, MPI_Offset * const *counts,
+	const void *buf, MPI_Offset bufcount, MPI_Datatype buftype)
+{
+    return ncmpi_put_varn_all(nc_id, var_id, num, starts, counts,
+	    buf, bufcount, buftype);
+}
+
+static int _pnc_iput_vara(int nc_id, int var_id,
+	const MPI_Offset *start, const MPI_Offset *count,
+	const void *buf, MPI_Offset bufcount, MPI_Datatype buftype,
+	int *req)
+{
+    return ncmpi_iput_vara(nc_id, var_id, start, count,
+	    buf, bufcount, buftype, req);
+}
+
+static int _pnc_iput_varn(int nc_id, int var_id, int num,
+	MPI_Offset * const *starts, MPI_Offset * const *counts,
+	const void *buf, MPI_Offset bufcount, MPI_Datatype buftype,
+	int *req)
+{
+    return ncmpi_iput_varn(nc_id, var_id, num, starts, counts,
+	    buf, bufcount, buftype, req);
+}
+
+static int _pnc_wait_all(int nc_id, int num, int *reqs, int *statuses)
+{
+    return ncmpi_wait_all(nc_id, num, reqs, statuses);
+}
+
+static int _pnc_close(int nc_id)
+{
+    return ncmpi_close(nc_id);
+}
+
+static const char *_pnc_strerror(int err)
+{
+    return ncmpi_strerror(err);
+}
+
+cfio_backend_t cfio_backend_pnetcdf =
+{
+    "pnetcdf",
+    _pnc_create, _pnc_def_dim, _pnc_def_var, _pnc_put_att, _pnc_enddef,
+    _pnc_put_vara, _pnc_put_varn, _pnc_iput_vara, _pnc_iput_varn,
+    _pnc_wait_all, _pnc_close, _pnc_strerror
+};
@@ -0,0 +1,923 @@
+/****************************************************************************
+ *       Filename:  backend_raw.c
+ *
+ *    Description:  the raw output engine, each server appends the data of a
+ *		    file to its own log with aligned writes, and the defs and
+ *		    where the blocks are to a sidecar index, see backend.h for
+ *		    the layout of the files. the writes are posted to an
+ *		    io_uring if liburing is found by configure
+ *
+ *        Version:  1.0
+ *        Created:  10/17/2026 10:52:33 PM
+ *       Revision:  none
+ *       Compiler:  gcc
+ ***************************************************************************/
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE	/* O_DIRECT */
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#ifdef HAVE_LIBURING
+#include <liburing.h>
+#endif
+
+#include "backend.h"
+#include "debug.h"
+
+#ifndef O_DIRECT
+#define O_DIRECT 0
+#endif
+
+#define RAW_PAD(size) (((size) + 7) & ~((uint64_t)7))
+/* max amount of the iovecs of a record */
+#define RAW_IOV_NUM 6
+
+static QLIST_HEAD(raw_file_head);
+static int raw_file_id = 0;
+static const char raw_zero[8];
+
+#ifdef HAVE_LIBURING
+static struct io_uring raw_ring;
+/* 1 if the ring is set up, -1 if io_uring can not be used, 0 if not tried */
+static int raw_ring_state = 0;
+/* RAW_URING_BUF_NUM buffers of RAW_BUF_SIZE, and whether they are
+ * registered to the ring */
+static char *raw_bufs = NULL;
+static int raw_buf_fixed = 0;
+static int raw_buf_free[RAW_URING_BUF_NUM];
+static int raw_buf_free_num = 0;
+static cfio_raw_io_t raw_ios[RAW_URING_DEPTH];
+static cfio_raw_io_t *raw_io_free[RAW_URING_DEPTH];
+static int raw_io_free_num = 0;
+/* the requests, they are given in order and the table is reused from the
+ * start once all of them are waited */
+static cfio_raw_req_t *raw_reqs = NULL;
+static int raw_req_num = 0, raw_req_max = 0, raw_req_used = 0;
+#endif
+
+/**
+ * @brief: find an open file
+ *
+ * @param nc_id: id of the file
+ *
+ * @return: the file, NULL if not found
+ */
+static cfio_raw_file_t *_find(int nc_id)
+{
+    cfio_raw_file_t *file;
+
+    qlist_for_each_entry(file, &raw_file_head, link)
+    {
+	if(file->nc_id == nc_id)
+	{
+	    return file;
+	}
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief: close the fds of a file and free it
+ *
+ * @param file: the file
+ *
+ * @return: NC_NOERR or errno of the first close failed
+ */
+static int _free_file(cfio_raw_file_t *file)
+{
+    int ret = NC_NOERR;
+
+    if(file->log_fd >= 0 && close(file->log_fd) < 0)
+    {
+	ret = errno;
+    }
+    if(file->idx_fd >= 0 && close(file->idx_fd) < 0 && NC_NOERR == ret)
+    {
+	ret = errno;
+    }
+    free(file->buf);
+    free(file->var_type);
+    free(file->var_ndims);
+    free(file);
+
+    return ret;
+}
+
+/**
+ * @brief: write all the iovecs at an offset of a fd
+ *
+ * @param fd: the fd
+ * @param iov: the iovecs, changed on a partial write
+ * @param num: amount of the iovecs
+ * @param offset: where to write
+ *
+ * @return: NC_NOERR or errno
+ */
+static int _writev_at(int fd, struct iovec *iov, int num, uint64_t offset)
+{
+    ssize_t ret;
+
+    /* a regular file is written fully unless there is an error */
+    while(num > 0)
+    {
+	if((ret = pwritev(fd, iov, num, offset)) < 0)
+	{
+	    if(EINTR == errno)
+	    {
+		continue;
+	    }
+	    error("write raw fd(%d) fail(%s)", fd, strerror(errno));
+	    return errno;
+	}
+	offset += ret;
+	while(num > 0 && (size_t)ret >= iov[0].iov_len)
+	{
+	    ret -= iov[0].iov_len;
+	    iov ++;
+	    num --;
+	}
+	if(num > 0)
+	{
+	    iov[0].iov_base = (char *)iov[0].iov_base + ret;
+	    iov[0].iov_len -= ret;
+	}
+    }
+
+    return NC_NOERR;
+}
+
+/**
+ * @brief: append a record to the index of a file, the head and the padding
+ *	are added to the parts
+ *
+ * @param file: the file
+ * @param type: RAW_REC_*
+ * @param id: id in the record head
+ * @param arg: arg in the record head
+ * @param dtype: dtype in the record head
+ * @param iov: parts of the record after the head, the first is left for the
+ *	head and one after the parts for the padding
+ * @param num: amount of the parts
+ *
+ * @return: NC_NOERR or errno
+ */
+static int _append(cfio_raw_file_t *file, int type, int id, int arg,
+	int dtype, struct iovec *iov, int num)
+{
+    int i, ret;
+    cfio_raw_rec_t rec;
+
+    memset(&rec, 0, sizeof(cfio_raw_rec_t));
+    rec.type = type;
+    rec.id = id;
+    rec.arg = arg;
+    rec.dtype = dtype;
+    rec.size = sizeof(cfio_raw_rec_t);
+    for(i = 1; i <= num; i ++)
+    {
+	rec.size += iov[i].iov_len;
+    }
+    iov[0].iov_base = &rec;
+    iov[0].iov_len = sizeof(cfio_raw_rec_t);
+    iov[num + 1].iov_base = (void *)raw_zero;
+    iov[num + 1].iov_len = RAW_PAD(rec.size) - rec.size;
+    rec.size = RAW_PAD(rec.size);
+
+    if(NC_NOERR == (ret = _writev_at(file->idx_fd, iov, num + 2,
+		    file->idx_size)))
+    {
+	file->idx_size += rec.size;
+    }
+
+    return ret;
+}
+
+/**
+ * @brief: append a block to the log of a file at an aligned offset. the
+ *	block is written in place if it is aligned in memory, only its tail is
+ *	copied to be padded, else it is copied through the aligned buffer of
+ *	the file
+ *
+ * @param file: the file
+ * @param data: the block
+ * @param size: size of the block
+ *
+ * @return: NC_NOERR or errno
+ */
+static int _write_block(cfio_raw_file_t *file, const char *data,
+	uint64_t size)
+{
+    int num = 0, ret = NC_NOERR;
+    uint64_t body, tail, len, done;
+    struct iovec iov[2];
+
+    if(0 == ((uintptr_t)data & (RAW_ALIGN - 1)))
+    {
+	body = size & ~((uint64_t)RAW_ALIGN - 1);
+	tail = size - body;
+	if(body > 0)
+	{
+	    iov[num].iov_base = (void *)data;
+	    iov[num].iov_len = body;
+	    num ++;
+	}
+	if(tail > 0)
+	{
+	    memcpy(file->buf, data + body, tail);
+	    memset(file->buf + tail, 0, RAW_ALIGN - tail);
+	    iov[num].iov_base = file->buf;
+	    iov[num].iov_len = RAW_ALIGN;
+	    num ++;
+	}
+	ret = _writev_at(file->log_fd, iov, num, file->log_size);
+    }else
+    {
+	for(done = 0; done < size && NC_NOERR == ret; done += len)
+	{
+	    len = size - done < RAW_BUF_SIZE ? size - done : RAW_BUF_SIZE;
+	    memcpy(file->buf, data + done, len);
+	    memset(file->buf + len, 0, RAW_ALIGN_UP(len) - len);
+	    iov[0].iov_base = file->buf;
+	    iov[0].iov_len = RAW_ALIGN_UP(len);
+	    ret = _writev_at(file->log_fd, iov, 1, file->log_size + done);
+	}
+    }
+
+    if(NC_NOERR == ret)
+    {
+	file->log_size += RAW_ALIGN_UP(size);
+    }
+    return ret;
+}
+
+#ifdef HAVE_LIBURING
+/**
+ * @brief: set up the ring and its buffers if they are not. the raw engine
+ *	falls back to blocking writes if it fails
+ */
+static void _ring_init()
+{
+    int i, ret;
+    struct iovec iov[RAW_URING_BUF_NUM];
+
+    if(0 != raw_ring_state)
+    {
+	return;
+    }
+    if(0 != posix_memalign((void **)&raw_bufs, RAW_ALIGN,
+		(size_t)RAW_URING_BUF_NUM * RAW_BUF_SIZE))
+    {
+	error("malloc for raw bufs fail.");
+	raw_bufs = NULL;
+	raw_ring_state = -1;
+	return;
+    }
+    if((ret = io_uring_queue_init(RAW_URING_DEPTH, &raw_ring, 0)) < 0)
+    {
+	debug(DEBUG_IO, "io_uring unavailable(%s), raw writes are blocking",
+		strerror(-ret));
+	free(raw_bufs);
+	raw_bufs = NULL;
+	raw_ring_state = -1;
+	return;
+    }
+
+    for(i = 0; i < RAW_URING_BUF_NUM; i ++)
+    {
+	iov[i].iov_base = raw_bufs + (size_t)i * RAW_BUF_SIZE;
+	iov[i].iov_len = RAW_BUF_SIZE;
+	raw_buf_free[i] = i;
+    }
+    raw_buf_free_num = RAW_URING_BUF_NUM;
+    /* registering fails if the locked memory is limited, then the buffers
+     * are written like the others */
+    raw_buf_fixed = (0 == io_uring_register_buffers(&raw_ring, iov,
+		RAW_URING_BUF_NUM));
+    for(i = 0; i < RAW_URING_DEPTH; i ++)
+    {
+	raw_io_free[i] = &raw_ios[i];
+    }
+    raw_io_free_num = RAW_URING_DEPTH;
+    raw_ring_state = 1;
+}
+
+/**
+ * @brief: submit the writes queued and reap one write completed, its
+ *	buffer is given back and its request updated. there must be writes in
+ *	flight
+ *
+ * @return: NC_NOERR or errno
+ */
+static int _ring_reap()
+{
+    int ret;
+    struct io_uring_cqe *cqe;
+    cfio_raw_io_t *io;
+    cfio_raw_req_t *req;
+
+    io_uring_submit(&raw_ring);
+    while(-EINTR == (ret = io_uring_wait_cqe(&raw_ring, &cqe)));
+    if(ret < 0)
+    {
+	error("wait io_uring fail(%s)", strerror(-ret));
+	return -ret;
+    }
+
+    io = io_uring_cqe_get_data(cqe);
+    req = &raw_reqs[io->req];
+    if(NC_NOERR == req->status &&
+	    (cqe->res < 0 || (uint64_t)cqe->res != io->len))
+    {
+	/* a regular file is written fully unless there is an error */
+	req->status = cqe->res < 0 ? -cqe->res : EIO;
+	error("write raw req(%d) fail(%s)", io->req, strerror(req->status));
+    }
+    req->pending --;
+    if(io->buf >= 0)
+    {
+	raw_buf_free[raw_buf_free_num ++] = io->buf;
+    }
+    raw_io_free[raw_io_free_num ++] = io;
+    io_uring_cqe_seen(&raw_ring, cqe);
+
+    return NC_NOERR;
+}
+
+/**
+ * @brief: reap all the writes in flight
+ *
+ * @return: NC_NOERR or errno
+ */
+static int _ring_drain()
+{
+    int ret;
+
+    while(raw_io_free_num < RAW_URING_DEPTH)
+    {
+	if(NC_NOERR != (ret = _ring_reap()))
+	{
+	    return ret;
+	}
+    }
+
+    return NC_NOERR;
+}
+
+/**
+ * @brief: queue a write to the ring, some writes are reaped first if the
+ *	ring is full
+ *
+ * @param fd: fd to write
+ * @param req: index of the request the write belongs to
+ * @param buf: index of the registered buffer data is in, -1 if none
+ * @param data: the data
+ * @param len: size of the data
+ * @param offset: where to write
+ *
+ * @return: NC_NOERR or errno
+ */
+static int _ring_write(int fd, int req, int buf, const char *data,
+	uint64_t len, uint64_t offset)
+{
+    int ret;
+    struct io_uring_sqe *sqe;
+    cfio_raw_io_t *io;
+
+    while(0 == raw_io_free_num)
+    {
+	if(NC_NOERR != (ret = _ring_reap()))
+	{
+	    return ret;
+	}
+    }
+    if(NULL == (sqe = io_uring_get_sqe(&raw_ring)))
+    {
+	io_uring_submit(&raw_ring);
+	if(NULL == (sqe = io_uring_get_sqe(&raw_ring)))
+	{
+	    return EBUSY;
+	}
+    }
+
+    io = raw_io_free[-- raw_io_free_num];
+    io->req = req;
+    io->buf = buf;
+    io->len = len;
+    if(buf >= 0 && raw_buf_fixed)
+    {
+	io_uring_prep_write_fixed(sqe, fd, (void *)data, len, offset, buf);
+    }else
+    {
+	io_uring_prep_write(sqe, fd, data, len, offset);
+    }
+    io_uring_sqe_set_data(sqe, io);
+    raw_reqs[req].pending ++;
+
+    return NC_NOERR;
+}
+
+/**
+ * @brief: queue the writes of a block at the end of the log of a file, like
+ *	_write_block. the block must not be changed until the request is
+ *	waited
+ *
+ * @param file: the file
+ * @param req: index of the request the block belongs to
+ * @param data: the block
+ * @param size: size of the block
+ *
+ * @return: NC_NOERR or errno
+ */
+static int _ring_block(cfio_raw_file_t *file, int req, const char *data,
+	uint64_t size)
+{
+    int buf, ret = NC_NOERR;
+    uint64_t offset, body, len, done;
+    char *copy;
+
+    offset = file->log_size;
+    file->log_size += RAW_ALIGN_UP(size);
+
+    if(0 == ((uintptr_t)data & (RAW_ALIGN - 1)))
+    {
+	body = size & ~((uint64_t)RAW_ALIGN - 1);
+	for(done = 0; done < body && NC_NOERR == ret; done += len)
+	{
+	    len = body - done < RAW_URING_IO_MAX ?
+		body - done : RAW_URING_IO_MAX;
+	    ret = _ring_write(file->log_fd, req, -1, data + done, len,
+		    offset + done);
+	}
+	data += body;
+	offset += body;
+	size -= body;
+    }
+
+    /* the rest is copied to the registered buffers */
+    for(done = 0; done < size && NC_NOERR == ret; done += len)
+    {
+	while(0 == raw_buf_free_num)
+	{
+	    if(NC_NOERR != (ret = _ring_reap()))
+	    {
+		return ret;
+	    }
+	}
+	buf = raw_buf_free[-- raw_buf_free_num];
+	copy = raw_bufs + (size_t)buf * RAW_BUF_SIZE;
+	len = size - done < RAW_BUF_SIZE ? size - done : RAW_BUF_SIZE;
+	memcpy(copy, data + done, len);
+	memset(copy + len, 0, RAW_ALIGN_UP(len) - len);
+	if(NC_NOERR != (ret = _ring_write(file->log_fd, req, buf, copy,
+			RAW_ALIGN_UP(len), offset + done)))
+	{
+	    raw_buf_free[raw_buf_free_num ++] = buf;
+	}
+    }
+
+    return ret;
+}
+
+/**
+ * @brief: get a new request
+ *
+ * @param req: where the index of the request is to be stored
+ *
+ * @return: NC_NOERR or ENOMEM
+ */
+static int _new_req(int *req)
+{
+    cfio_raw_req_t *reqs;
+
+    if(raw_req_num == raw_req_max)
+    {
+	raw_req_max = raw_req_max > 0 ? raw_req_max * 2 : 64;
+	if(NULL == (reqs = realloc(raw_reqs,
+			sizeof(cfio_raw_req_t) * raw_req_max)))
+	{
+	    raw_req_max = raw_req_num;
+	    return ENOMEM;
+	}
+	raw_reqs = reqs;
+    }
+    *req = raw_req_num ++;
+    memset(&raw_reqs[*req], 0, sizeof(cfio_raw_req_t));
+    raw_reqs[*req].used = 1;
+    raw_req_used ++;
+
+    return NC_NOERR;
+}
+#endif
+
+static int _raw_create(MPI_Comm comm, const char *path, int cmode,
+	int *nc_id)
+{
+    int ret, flags;
+    char *file_path;
+    cfio_raw_file_t *file;
+    cfio_raw_head_t head;
+    struct iovec iov[1];
+
+    if(NULL == (file = malloc(sizeof(cfio_raw_file_t))) ||
+	    NULL == (file_path = malloc(strlen(path) + 32)))
+    {
+	free(file);
+	return ENOMEM;
+    }
+    memset(file, 0, sizeof(cfio_raw_file_t));
+    file->log_fd = file->idx_fd = -1;
+    if(0 != posix_memalign((void **)&file->buf, RAW_ALIGN, RAW_BUF_SIZE))
+    {
+	file->buf = NULL;
+	free(file_path);
+	_free_file(file);
+	return ENOMEM;
+    }
+
+    memset(&head, 0, sizeof(cfio_raw_head_t));
+    strcpy(head.magic, RAW_MAGIC);
+    head.version = RAW_VERSION;
+    head.cmode = cmode;
+    head.align = RAW_ALIGN;
+    MPI_Comm_rank(comm, &head.rank);
+    MPI_Comm_size(comm, &head.size);
+
+    flags = O_WRONLY | O_CREAT | O_TRUNC;
+    if(cmode & NC_NOCLOBBER)
+    {
+	flags |= O_EXCL;
+    }
+    sprintf(file_path, "%s.%d.log", path, head.rank);
+    /* some file systems, like tmpfs, do not take O_DIRECT */
+    if((file->log_fd = open(file_path, flags | O_DIRECT, 0644)) < 0 &&
+	    EINVAL == errno)
+    {
+	debug(DEBUG_IO, "%s is written without O_DIRECT", file_path);
+	file->log_fd = open(file_path, flags, 0644);
+    }
+    if(file->log_fd >= 0)
+    {
+	sprintf(file_path, "%s.%d.idx", path, head.rank);
+	file->idx_fd = open(file_path, flags, 0644);
+    }
+    if(file->log_fd < 0 || file->idx_fd < 0)
+    {
+	ret = errno;
+	error("create raw file(%s) fail(%s)", file_path, strerror(errno));
+	free(file_path);
+	_free_file(file);
+	return ret;
+    }
+    free(file_path);
+
+    iov[0].iov_base = &head;
+    iov[0].iov_len = sizeof(cfio_raw_head_t);
+    if(NC_NOERR != (ret = _writev_at(file->idx_fd, iov, 1, 0)))
+    {
+	_free_file(file);
+	return ret;
+    }
+    file->idx_size = sizeof(cfio_raw_head_t);
+
+    file->nc_id = *nc_id = raw_file_id ++;
+    qlist_add_tail(&(file->link), &raw_file_head);
+#ifdef HAVE_LIBURING
+    _ring_init();
+#endif
+
+    return NC_NOERR;
+}
+
+static int _raw_def_dim(int nc_id, const char *name, MPI_Offset len,
+	int *dim_id)
+{
+    int64_t dim_len = len;
+    struct iovec iov[RAW_IOV_NUM];
+    cfio_raw_file_t *file;
+
+    if(NULL == (file = _find(nc_id)))
+    {
+	return EBADF;
+    }
+    *dim_id = file->dim_num ++;
+
+    iov[1].iov_base = &dim_len;
+    iov[1].iov_len = sizeof(int64_t);
+    iov[2].iov_base = (void *)name;
+    iov[2].iov_len = strlen(name) + 1;
+    return _append(file, RAW_REC_DIM, *dim_id, 0, 0, iov, 2);
+}
+
+static int _raw_def_var(int nc_id, const char *name, cfio_type type,
+	int ndims, const int *dim_ids, int *var_id)
+{
+    int32_t var_ndims = ndims;
+    struct iovec iov[RAW_IOV_NUM];
+    cfio_raw_file_t *file;
+
+    if(NULL == (file = _find(nc_id)))
+    {
+	return EBADF;
+    }
+    if(file->var_num == file->var_max)
+    {
+	file->var_max = file->var_max > 0 ? file->var_max * 2 : 16;
+	file->var_type = realloc(file->var_type,
+		sizeof(cfio_type) * file->var_max);
+	file->var_ndims = realloc(file->var_ndims,
+		sizeof(int) * file->var_max);
+	if(NULL == file->var_type || NULL == file->var_ndims)
+	{
+	    return ENOMEM;
+	}
+    }
+    *var_id = file->var_num ++;
+    file->var_type[*var_id] = type;
+    file->var_ndims[*var_id] = ndims;
+
+    iov[1].iov_base = &var_ndims;
+    iov[1].iov_len = sizeof(int32_t);
+    iov[2].iov_base = (void *)dim_ids;
+    iov[2].iov_len = sizeof(int32_t) * ndims;
+    iov[3].iov_base = (void *)name;
+    iov[3].iov_len = strlen(name) + 1;
+    return _append(file, RAW_REC_VAR, *var_id, type, 0, iov, 3);
+}
+
+static int _raw_put_att(int nc_id, int var_id, const char *name,
+	cfio_type type, MPI_Offset len, const void *data)
+{
+    int ele_size = 0;
+    int64_t att_len = len;
+    struct iovec iov[RAW_IOV_NUM];
+    cfio_raw_file_t *file;
+
+    if(NULL == (file = _find(nc_id)))
+    {
+	return EBADF;
+    }
+    cfio_types_size(ele_size, type);
+
+    iov[1].iov_base = &att_len;
+    iov[1].iov_len = sizeof(int64_t);
+    iov[2].iov_base = (void *)name;
+    iov[2].iov_len = strlen(name) + 1;
+    iov[3].iov_base = (void *)data;
+    iov[3].iov_len = ele_size * len;
+    return _append(file, RAW_REC_ATT, var_id, type, 0, iov, 3);
+}
+
+static int _raw_enddef(int nc_id)
+{
+    return NULL == _find(nc_id) ? EBADF : NC_NOERR;
+}
+
+/**
+ * @brief: append the blocks of a var to the log, and a RAW_REC_DATA of each
+ *	block to the index
+ *
+ * @param nc_id: id of the file
+ * @param var_id: id of the var
+ * @param num: amount of the blocks
+ * @param starts: start of each block
+ * @param counts: count of each block
+ * @param buf: the data of the blocks one after another, described by
+ *	bufcount and buftype, it is packed first if buftype is not a basic type
+ * @param bufcount: amount of buftype in buf
+ * @param buftype: MPI type of buf
+ * @param req: index of the request the blocks are queued to the ring for,
+ *	-1 to write them now
+ *
+ * @return: NC_NOERR or errno
+ */
+static int _raw_put(int nc_id, int var_id, int num,
+	MPI_Offset * const *starts, MPI_Offset * const *counts,
+	const void *buf, MPI_Offset bufcount, MPI_Datatype buftype, int req)
+{
+    int i, j, ret = NC_NOERR;
+    int ndims, ele_size = 0, pack_size, pos = 0;
+    int num_ints, num_adds, num_types, combiner;
+    int64_t block[2];
+    char *pack = NULL;
+    const char *data = buf;
+    struct iovec iov[RAW_IOV_NUM];
+    cfio_raw_file_t *file;
+
+    if(NULL == (file = _find(nc_id)) || var_id < 0 ||
+	    var_id >= file->var_num)
+    {
+	return EBADF;
+    }
+    ndims = file->var_ndims[var_id];
+    cfio_types_size(ele_size, file->var_type[var_id]);
+
+    MPI_Type_get_envelope(buftype, &num_ints, &num_adds, &num_types,
+	    &combiner);
+    if(MPI_COMBINER_NAMED != combiner && bufcount > 0)
+    {
+	/* packed into an aligned buffer, so it is written in place */
+	MPI_Pack_size(bufcount, buftype, MPI_COMM_SELF, &pack_size);
+	if(0 != posix_memalign((void **)&pack, RAW_ALIGN, pack_size))
+	{
+	    return ENOMEM;
+	}
+	MPI_Pack((void *)buf, bufcount, buftype, pack, pack_size, &pos,
+		MPI_COMM_SELF);
+	data = pack;
+    }
+
+    for(i = 0; i < num && NC_NOERR == ret; i ++)
+    {
+	block[0] = file->log_size;
+	block[1] = ele_size;
+	for(j = 0; j < ndims; j ++)
+	{
+	    block[1] *= counts[i][j];
+	}
+#ifdef HAVE_LIBURING
+	if(req >= 0)
+	{
+	    ret = _ring_block(file, req, data, block[1]);
+	}else
+#endif
+	ret = _write_block(file, data, block[1]);
+	if(NC_NOERR != ret)
+	{
+	    break;
+	}
+	iov[1].iov_base = block;
+	iov[1].iov_len = sizeof(block);
+	iov[2].iov_base = starts[i];
+	iov[2].iov_len = sizeof(int64_t) * ndims;
+	iov[3].iov_base = counts[i];
+	iov[3].iov_len = sizeof(int64_t) * ndims;
+	ret = _append(file, RAW_REC_DATA, var_id, ndims,
+		file->var_type[var_id], iov, 3);
+	data += block[1];
+    }
+
+#ifdef HAVE_LIBURING
+    if(req >= 0)
+    {
+	/* the writes may still read it, it is freed at the wait */
+	raw_reqs[req].pack = pack;
+	io_uring_submit(&raw_ring);
+	return ret;
+    }
+#endif
+    free(pack);
+    return ret;
+}
+
+static int _raw_put_vara(int nc_id, int var_id,
+	const MPI_Offset *start, const MPI_Offset *count,
+	const void *buf, MPI_Offset bufcount, MPI_Datatype buftype)
+{
+    MPI_Offset *starts[1] = {(MPI_Offset *)start};
+    MPI_Offset *counts[1] = {(MPI_Offset *)count};
+
+    return _raw_put(nc_id, var_id, 1, starts, counts,
+	    buf, bufcount, buftype, -1);
+}
+
+static int _raw_put_varn(int nc_id, int var_id, int num,
+	MPI_Offset * const *starts, MPI_Offset * const *counts,
+	const void *buf, MPI_Offset bufcount, MPI_Datatype buftype)
+{
+    return _raw_put(nc_id, var_id, num, starts, counts,
+	    buf, bufcount, buftype, -1);
+}
+
+#ifdef HAVE_LIBURING
+static int _raw_iput_varn(int nc_id, int var_id, int num,
+	MPI_Offset * const *starts, MPI_Offset * const *counts,
+	const void *buf, MPI_Offset bufcount, MPI_Datatype buftype,
+	int *req)
+{
+    int ret;
+
+    if(1 != raw_ring_state)
+    {
+	/* written now, there is nothing to wait */
+	*req = NC_REQ_NULL;
+	return _raw_put(nc_id, var_id, num, starts, counts,
+		buf, bufcount, buftype, -1);
+    }
+    if(NC_NOERR != (ret = _new_req(req)))
+    {
+	*req = NC_REQ_NULL;
+	return ret;
+    }
+
+    return _raw_put(nc_id, var_id, num, starts, counts,
+	    buf, bufcount, buftype, *req);
+}
+
+static int _raw_iput_vara(int nc_id, int var_id,
+	const MPI_Offset *start, const MPI_Offset *count,
+	const void *buf, MPI_Offset bufcount, MPI_Datatype buftype,
+	int *req)
+{
+    MPI_Offset *starts[1] = {(MPI_Offset *)start};
+    MPI_Offset *counts[1] = {(MPI_Offset *)count};
+
+    return _raw_iput_varn(nc_id, var_id, 1, starts, counts,
+	    buf, bufcount, buftype, req);
+}
+
+static int _raw_wait_all(int nc_id, int num, int *reqs, int *statuses)
+{
+    int i, ret;
+    cfio_raw_req_t *req;
+
+    for(i = 0; i < num; i ++)
+    {
+	if(reqs[i] < 0 || reqs[i] >= raw_req_num || !raw_reqs[reqs[i]].used)
+	{
+	    statuses[i] = NC_REQ_NULL == reqs[i] ? NC_NOERR : EINVAL;
+	    continue;
+	}
+	req = &raw_reqs[reqs[i]];
+	while(req->pending > 0)
+	{
+	    if(NC_NOERR != (ret = _ring_reap()))
+	    {
+		return ret;
+	    }
+	}
+	statuses[i] = req->status;
+	free(req->pack);
+	req->pack = NULL;
+	req->used = 0;
+	raw_req_used --;
+    }
+    if(0 == raw_req_used)
+    {
+	raw_req_num = 0;
+    }
+
+    return NC_NOERR;
+}
+#endif
+
+static int _raw_close(int nc_id)
+{
+    int ret = NC_NOERR;
+    cfio_raw_file_t *file;
+
+    if(NULL == (file = _find(nc_id)))
+    {
+	return EBADF;
+    }
+    qlist_del(&(file->link));
+#ifdef HAVE_LIBURING
+    /* no write may be left on the fd, the ring is freed with the last file */
+    if(1 == raw_ring_state)
+    {
+	ret = _ring_drain();
+	if(qlist_empty(&raw_file_head))
+	{
+	    io_uring_queue_exit(&raw_ring);
+	    free(raw_bufs);
+	    raw_bufs = NULL;
+	    raw_ring_state = 0;
+	}
+    }
+#endif
+    if(NC_NOERR == ret)
+    {
+	ret = _free_file(file);
+    }else
+    {
+	_free_file(file);
+    }
+
+    return ret;
+}
+
+static const char *_raw_strerror(int err)
+{
+    return strerror(err);
+}
+
+cfio_backend_t cfio_backend_raw =
+{
+    "raw",
+    _raw_create, _raw_def_dim, _raw_def_var, _raw_put_att, _raw_enddef,
+#ifdef HAVE_LIBURING
+    _raw_put_vara, _raw_put_varn, _raw_iput_vara, _raw_iput_varn,
+    _raw_wait_all,
+#else
+    _raw_put_vara, _raw_put_varn, NULL, NULL, NULL,
+#endif
+    _raw_close, _raw_strerror
+};
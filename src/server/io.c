@@ -19,12 +19,16 @@
 #include <pnetcdf.h>
 #include <assert.h>
 #include <string.h>
+#include <limits.h>
 
 #include "mpi.h"
 
 #include "io.h"
+#include "assemble.h"
+#include "conf.h"
 #include "id.h"
 #include "msg.h"
+#include "recv.h"
 #include "buffer.h"
 #include "debug.h"
 #include "quickhash.h"
@@ -33,9 +37,19 @@
 #include "map.h"
 #include "define.h"
 #include "times.h"
+#include "mem.h"
+#include "backend.h"
 
 static struct qhash_table *io_table;
 static int server_id;
+/* nc files created from a template whose enddef is not done yet */
+static qlist_head_t template_wait_head;
+/* io requests with their client bitmap, and write jobs */
+static cfio_mem_slab_t val_slab, job_slab;
+/* scratch of the writes, released when all clients end an io step */
+static cfio_mem_arena_t scratch;
+/* output engine the nc files are written with */
+static cfio_backend_t *backend;
 //static double start_time;
 //static int file_num = 0;
 //static double write_time = 0.0;
@@ -74,7 +88,7 @@ static void _free(cfio_io_val_t *val)
 {
     if(NULL != val)
     {
-	free(val);
+	cfio_mem_slab_free(&val_slab, val);
 	val = NULL;
     }
 }
@@ -91,7 +105,7 @@ static inline void _add_bitmap(uint8_t *bitmap, int client_id)
     int i, j;
     int client_index;
 
-    assert(client_id < cfio_map_get_client_amount());
+    assert(cfio_map_proc_type(client_id) == CFIO_MAP_TYPE_CLIENT);
     assert(bitmap != NULL);
     
     client_index = cfio_map_get_client_index_of_server(client_id);
@@ -171,10 +185,17 @@ static inline int _recv_client_io(
 
     if(NULL == (link = qhash_search(io_table, &key)))
     {
-	val = malloc(sizeof(cfio_io_val_t));
+	/* the bitmap follows the val in one object of the pool */
+	val = cfio_mem_slab_alloc(&val_slab);
+	if(NULL == val)
+	{
+	    error("malloc for io val fail.");
+	    return CFIO_ERROR_MALLOC;
+	}
 
 	memcpy(val, &key, sizeof(cfio_io_key_t));
-	val->client_bitmap = malloc((client_num >> 3) + 1);
+	val->client_bitmap = (uint8_t *)val + 
+	    cfio_mem_align(sizeof(cfio_io_val_t));
 	memset(val->client_bitmap, 0, (client_num >> 3) + 1);
 	qhash_add(io_table, &key, &(val->hash_link));
 
@@ -203,118 +224,36 @@ static inline int _remove_client_io(
 
     qhash_del(&io_info->hash_link);
 
-    if(NULL != io_info->client_bitmap) 
-    {
-	free(io_info->client_bitmap);
-	io_info->client_bitmap = NULL;
-    }
-
-    free(io_info);
+    cfio_mem_slab_free(&val_slab, io_info);
 
     return CFIO_ERROR_NONE;
 }
 
-static void _inc_src_index(
-	const int ndims, const size_t ele_size, 
-	const size_t *dst_dims_len, char **dst_addr, 
-	const size_t *src_dims_len, size_t *src_index)
-{
-    int dim;
-    size_t sub_size, last_sub_size;
-
-    dim = ndims - 1;
-    src_index[dim] ++;
-
-    sub_size = ele_size;
-    while(src_index[dim] >= src_dims_len[dim])
-    {
-	*dst_addr -= (src_dims_len[dim] - 1) * sub_size;
-	src_index[dim] = 0;
-	sub_size *= dst_dims_len[dim];
-	dim --;
-	src_index[dim] ++;
-    }
-
-    *dst_addr += sub_size;
-}
 
 /**
- * @brief: put the src data array into the dst data array, src and dst both are
- *	sub-array of a total data array
- *
- * @param ndims: number of dimensions for the variable
- * @param ele_size: size of each element in the variable array
- * @param dst_start: start index of the dst data array
- * @param dst_count: count of teh dst data array
- * @param dst_data: pointer to the dst data array
- * @param src_start: start index of the src data array
- * @param src_count: count of teh src data array
- * @param src_data: pointer to the src data array
+ * @brief: write an attribute into the nc file
+ *
+ * @param nc_id: the server nc id
+ * @param var_id: the server var id, NC_GLOBAL for global attribute
+ * @param att: the attribute
+ *
+ * @return: error code
  */
-static int _put_var(
-	int ndims, size_t ele_size,
-	size_t *dst_start, size_t *dst_count, char *dst_data, 
-	size_t *src_start, size_t *src_count, char *src_data)
+static int _write_att(int nc_id, int var_id, cfio_id_att_t *att)
 {
-    int i;
-    size_t src_len;
-    size_t dst_offset, sub_size;
-    size_t *src_index;
-
-    //float *_data = src_data;
-    //for(i = 0; i < 4; i ++)
-    //{
-    //    printf("%f, ", _data[i]);
-    //}
-    //printf("\n");
-
-    assert(NULL != dst_start);
-    assert(NULL != dst_count);
-    assert(NULL != dst_data);
-    assert(NULL != src_start);
-    assert(NULL != src_count);
-    assert(NULL != src_data);
-
-    src_len = 1;
-    for(i = 0; i < ndims; i ++)
-    {
-	src_len *= src_count[i];
-    }
-
-    src_index = malloc(sizeof(size_t) * ndims);
-    if(NULL == src_index)
-    {
-	error("malloc for src_index fail.");
-	return CFIO_ERROR_MALLOC;
-    }
-    for(i = 0; i < ndims; i ++)
-    {
-	src_index[i] = 0;
-    }
-
-    sub_size = 1;
-    dst_offset = 0;
-    for(i = ndims - 1; i >= 0; i --)
-    {
-	dst_offset += (src_start[i] - dst_start[i]) * sub_size;
-	sub_size *= dst_count[i];
-    }
-    //debug(DEBUG_ID, "dst_offset = %d", dst_offset);
-    dst_data += ele_size * dst_offset;
+    int ret;
 
-    for(i = 0; i < src_len - 1; i ++)
+    ret = backend->put_att(nc_id, var_id, att->name, att->xtype, 
+	    att->len, att->data);
+    if(ret != NC_NOERR)
     {
-	memcpy(dst_data, src_data, ele_size);
-	_inc_src_index(ndims, ele_size, dst_count, &dst_data, 
-		src_count, src_index);
-	src_data += ele_size;
+	error("put attr(%s) error(%s)", att->name, backend->strerror(ret));
+	return CFIO_ERROR_NC;
     }
-    memcpy(dst_data, src_data, ele_size);
 
     return CFIO_ERROR_NONE;
 }
 
-
 static inline int _handle_def(cfio_id_val_t *val)
 {
     int ret, i;
@@ -332,74 +271,60 @@ static inline int _handle_def(cfio_id_val_t *val)
 	assert(nc->nc_id != CFIO_ID_NC_INVALID);
 	dim->nc_id = nc->nc_id;
 	debug(DEBUG_IO, "dim_len = %d", dim->dim_len);
-#ifndef SVR_NO_IO
-	ret = ncmpi_def_dim(nc->nc_id, dim->name, dim->global_dim_len, &dim->dim_id);
-#else
-	ret = NC_NOERR;
-	dim->dim_id = 10;
-#endif
+	ret = backend->def_dim(nc->nc_id, dim->name, 
+		cfio_map_get_subfile_amount() > 0 ? 
+		dim->sub_len : dim->global_dim_len, &dim->dim_id);
+	if(NC_NOERR != ret)
+	{
+	    error("def dim(%s) error(%s)", dim->name, backend->strerror(ret));
+	    return CFIO_ERROR_NC;
+	}
 	return CFIO_ERROR_NONE;
     }
 
     if(NULL != val->var)
     {
 	var = val->var;
+	cfio_types_size(ele_size, var->data_type);
+	var->global_size = ele_size;
 	for(i = 0; i < var->ndims; i ++)
 	{
 	    cfio_id_get_dim(val->client_nc_id, var->dim_ids[i], &dim);
 	    var->dim_ids[i] = dim->dim_id;
+	    if(dim->global_dim_len > 0)
+	    {
+		var->global_size *= dim->global_dim_len;
+	    }
 	}
 	var->nc_id = dim->nc_id;
 	debug(DEBUG_IO, "Def var : cfio_type(%d), nc_type(%d)", 
 		var->data_type, cfio_type_to_nc(var->data_type));
-#ifndef SVR_NO_IO
-	ret = ncmpi_def_var(var->nc_id, var->name, cfio_type_to_nc(var->data_type), var->ndims,
-		var->dim_ids, &var->var_id);
-#else
-	ret = NC_NOERR;
-	var->var_id = 10;
-#endif
+	ret = backend->def_var(var->nc_id, var->name, var->data_type, 
+		var->ndims, var->dim_ids, &var->var_id);
+	if(NC_NOERR != ret)
+	{
+	    error("def var(%s) error(%s)", var->name, backend->strerror(ret));
+	    return CFIO_ERROR_NC;
+	}
 	qlist_for_each_entry(att, var->att_head, link)
 	{
-	    switch(att->xtype)
+	    if((ret = _write_att(var->nc_id, var->var_id, att)) < 0)
 	    {
-		case CFIO_CHAR :
-#ifndef SVR_NO_IO
-		    ret = ncmpi_put_att_text(var->nc_id, var->var_id, att->name, att->len, att->data);
-#else
-		    ret = NC_NOERR;
-#endif
-		    break;
-		case CFIO_INT :
-#ifndef SVR_NO_IO
-		    ret = ncmpi_put_att_int(nc->nc_id, var->var_id, att->name, 
-			    cfio_type_to_nc(att->xtype), att->len, (const int*)att->data);
-#else
-		    ret = NC_NOERR;
-#endif
-		    break;
-		case CFIO_FLOAT :
-#ifndef SVR_NO_IO
-		    ret = ncmpi_put_att_float(nc->nc_id, var->var_id, att->name, cfio_type_to_nc(att->xtype), att->len, (const float*)att->data);
-#else
-		    ret = NC_NOERR;
-#endif
-		    break;
-		case CFIO_DOUBLE :
-#ifndef SVR_NO_IO
-		    ret = ncmpi_put_att_double(nc->nc_id, var->var_id, att->name, cfio_type_to_nc(att->xtype), att->len, (const double*)att->data);
-#else
-		    ret = NC_NOERR;
-#endif
-		    break;
+		error("put var(%s) attr(%s) error", var->name, att->name);
+		return ret;
 	    }
-	    if(ret != NC_NOERR)
+	}
+	/* where the var in the subfile is in the whole var */
+	if(NULL != var->sub_start)
+	{
+	    ret = backend->put_att(var->nc_id, var->var_id, ATT_NAME_START,
+		    CFIO_INT, var->ndims, var->sub_start);
+	    if(NC_NOERR != ret)
 	    {
-		error("put var(%s) attr(%s) error(%s)",
-			var->name, att->name, ncmpi_strerror(ret));
+		error("put var(%s) attr(%s) error(%s)", var->name, 
+			ATT_NAME_START, backend->strerror(ret));
 		return CFIO_ERROR_NC;
 	    }
-
 	}
 	
 	return CFIO_ERROR_NONE;
@@ -480,12 +405,12 @@ void _merge_var_data(
 
     for(i = 0; i < var->client_num; i ++)
     {
-	_put_var(var->ndims, ele_size, 
+	cfio_assemble_put(var->ndims, ele_size, 
 		start, count, data,
 		var->recv_data[i].start, var->recv_data[i].count,
 		var->recv_data[i].buf);
 
-	free(var->recv_data[i].buf);	
+	cfio_id_free_data(var->recv_data[i].buf);	
 	var->recv_data[i].buf = NULL;	
 	free(var->recv_data[i].start);	
 	var->recv_data[i].start = NULL;	
@@ -499,20 +424,44 @@ void _merge_var_data(
 
 int cfio_io_init()
 {
+    int client_num;
+
     io_table = qhash_init(_compare, _hash, IO_HASH_TABLE_SIZE);
+    INIT_QLIST_HEAD(&template_wait_head);
     MPI_Comm_rank(MPI_COMM_WORLD, &server_id);
 
+    client_num = cfio_map_get_client_num_of_server(server_id);
+    cfio_mem_slab_init(&val_slab, cfio_mem_align(sizeof(cfio_io_val_t)) + 
+	    (client_num >> 3) + 1, IO_SLAB_NUM);
+    cfio_mem_slab_init(&job_slab, sizeof(cfio_io_job_t), IO_SLAB_NUM);
+    cfio_mem_arena_init(&scratch, IO_SCRATCH_BLOCK_SIZE);
+    backend = cfio_backend_get(cfio_conf_get_backend());
+    debug(DEBUG_IO, "output engine : %s", backend->name);
+
     //start_time = times_cur();
     return CFIO_ERROR_NONE;
 }
 
 int cfio_io_final()
 {
+    cfio_io_wait_t *wait, *next;
+
+    qlist_for_each_entry_safe(wait, next, &template_wait_head, link)
+    {
+	error("nc(%d) is still waiting for template(%d)", 
+		wait->client_nc_id, wait->template_nc_id);
+	qlist_del(&(wait->link));
+	free(wait->path);
+	free(wait);
+    }
     if(NULL != io_table)
     {
 	qhash_destroy_and_finalize(io_table, cfio_io_val_t, hash_link, _free);
 	io_table = NULL;
     }
+    cfio_mem_slab_final(&val_slab);
+    cfio_mem_slab_final(&job_slab);
+    cfio_mem_arena_final(&scratch);
 
     return CFIO_ERROR_NONE;
 }
@@ -549,6 +498,233 @@ int cfio_io_writer_done(int client_id, int *server_done)
     return CFIO_ERROR_NONE;	
 }
 
+/**
+ * @brief: release the scratch of the writes, it is a job of the pipeline so
+ *	it is called after all the writes put before it
+ *
+ * @param job: the job
+ *
+ * @return: error code
+ */
+static int _reset_scratch(cfio_pipe_job_t *job)
+{
+    cfio_mem_arena_reset(&scratch);
+    free(job);
+
+    return CFIO_ERROR_NONE;
+}
+
+int cfio_io_end_step(cfio_msg_t *msg)
+{
+    int func_code = FUNC_IO_END;
+    cfio_io_val_t *io_info;
+    cfio_pipe_job_t *job;
+
+    _recv_client_io(msg->src, func_code, 0, 0, 0, &io_info);
+
+    if(_bitmap_full(io_info->client_bitmap))
+    {
+	_remove_client_io(io_info);
+
+	job = malloc(sizeof(cfio_pipe_job_t));
+	if(NULL == job)
+	{
+	    error("malloc for job fail.");
+	    return CFIO_ERROR_MALLOC;
+	}
+	job->assemble = NULL;
+	job->write = _reset_scratch;
+	return cfio_pipe_put(job);
+    }
+
+    return CFIO_ERROR_NONE;	
+}
+
+/**
+ * @brief: find the part of each dim written by the servers of a subfile, 
+ *	which is the bounding box of the vars of their clients, and store the 
+ *	start of it in each var, see CFIO_CONF_ENV_SUBFILE. it is called by all
+ *	servers of the subfile with the same defs, before the defs are handled,
+ *	and does nothing if all servers write one shared file
+ *
+ * @param client_nc_id: the client nc id
+ *
+ * @return: error code
+ */
+static int _sub_box(int client_nc_id)
+{
+    int i, n, dim_num;
+    long *box;
+    cfio_id_val_t *iter, *nc_val;
+    cfio_id_dim_t *dim;
+    cfio_id_var_t *var;
+
+    if(0 == cfio_map_get_subfile_amount())
+    {
+	return CFIO_ERROR_NONE;
+    }
+
+    cfio_id_get_val(client_nc_id, 0, 0, &nc_val);
+    dim_num = 0;
+    qlist_for_each_entry(iter, &(nc_val->link), link)
+    {
+	if(NULL != iter->dim)
+	{
+	    /* sub_len is the end of the part until the box is reduced */
+	    iter->dim->sub_start = INT_MAX;
+	    iter->dim->sub_len = 0;
+	    dim_num ++;
+	}
+    }
+    qlist_for_each_entry(iter, &(nc_val->link), link)
+    {
+	if(NULL == (var = iter->var) || NULL == var->start)
+	{
+	    continue;
+	}
+	for(i = 0; i < var->ndims; i ++)
+	{
+	    if(CFIO_ID_HASH_GET_NULL == 
+		    cfio_id_get_dim(client_nc_id, var->dim_ids[i], &dim))
+	    {
+		continue;
+	    }
+	    if((int)var->start[i] < dim->sub_start)
+	    {
+		dim->sub_start = var->start[i];
+	    }
+	    if((int)(var->start[i] + var->count[i]) > dim->sub_len)
+	    {
+		dim->sub_len = var->start[i] + var->count[i];
+	    }
+	}
+    }
+
+    /* the starts are negated, so one MPI_MAX reduces the whole box. one 
+     * spare element, so a nc of no dim does not malloc 0 */
+    if(NULL == (box = malloc(sizeof(long) * (2 * dim_num + 1))))
+    {
+	error("malloc for subfile box fail.");
+	return CFIO_ERROR_MALLOC;
+    }
+    n = 0;
+    qlist_for_each_entry(iter, &(nc_val->link), link)
+    {
+	if(NULL != iter->dim)
+	{
+	    box[n ++] = - (long)iter->dim->sub_start;
+	    box[n ++] = iter->dim->sub_len;
+	}
+    }
+    MPI_Allreduce(MPI_IN_PLACE, box, n, MPI_LONG, MPI_MAX, 
+	    cfio_map_get_subfile_comm());
+    n = 0;
+    qlist_for_each_entry(iter, &(nc_val->link), link)
+    {
+	if(NULL == (dim = iter->dim))
+	{
+	    continue;
+	}
+	/* the unlimited dim and the dims of no var are not split */
+	if(0 == dim->global_dim_len || 0 == box[n + 1])
+	{
+	    dim->sub_start = 0;
+	    dim->sub_len = dim->global_dim_len;
+	}else
+	{
+	    dim->sub_start = - box[n];
+	    dim->sub_len = box[n + 1] + box[n];
+	}
+	debug(DEBUG_IO, "dim(%s) : sub_start = %d; sub_len = %d", 
+		dim->name, dim->sub_start, dim->sub_len);
+	n += 2;
+    }
+    free(box);
+
+    qlist_for_each_entry(iter, &(nc_val->link), link)
+    {
+	if(NULL == (var = iter->var))
+	{
+	    continue;
+	}
+	if(NULL == var->sub_start && 
+		NULL == (var->sub_start = malloc(sizeof(int) * var->ndims)))
+	{
+	    error("malloc for subfile start fail.");
+	    return CFIO_ERROR_MALLOC;
+	}
+	for(i = 0; i < var->ndims; i ++)
+	{
+	    var->sub_start[i] = 0;
+	    if(CFIO_ID_HASH_GET_NULL != 
+		    cfio_id_get_dim(client_nc_id, var->dim_ids[i], &dim))
+	    {
+		var->sub_start[i] = dim->sub_start;
+	    }
+	}
+    }
+
+    return CFIO_ERROR_NONE;
+}
+
+/**
+ * @brief: get the start of the subfile in a var along a dim
+ *
+ * @param var: the var
+ * @param i: index of the dim in the var
+ *
+ * @return: the start, 0 if all servers write one shared file
+ */
+static inline int _sub_offset(cfio_id_var_t *var, int i)
+{
+    return NULL == var->sub_start ? 0 : var->sub_start[i];
+}
+
+/**
+ * @brief: create a nc file by all servers, or its subfile by the servers of 
+ *	this server's group, which is named path_index, and records the amount 
+ *	of subfiles in a global attribute, see CFIO_CONF_ENV_SUBFILE
+ *
+ * @param path: file name of the nc
+ * @param cmode: the creation mode flag
+ * @param nc_id: pointer to where the id of the file is to be stored
+ *
+ * @return: error code
+ */
+static int _create_nc(char *path, int cmode, int *nc_id)
+{
+    int ret, sub_amount;
+    char *sub_path = NULL;
+
+    if((sub_amount = cfio_map_get_subfile_amount()) > 0)
+    {
+	if(NULL == (sub_path = malloc(strlen(path) + 32)))
+	{
+	    error("malloc for subfile path fail.");
+	    return CFIO_ERROR_MALLOC;
+	}
+	sprintf(sub_path, "%s_%d", path, cfio_map_get_subfile_index());
+	path = sub_path;
+    }
+
+    ret = backend->create(cfio_map_get_subfile_comm(), path, cmode, nc_id);
+    if(NC_NOERR == ret && sub_amount > 0)
+    {
+	ret = backend->put_att(*nc_id, NC_GLOBAL, ATT_NAME_SUB_AMOUNT, 
+		CFIO_INT, 1, &sub_amount);
+    }
+    if(ret != NC_NOERR)
+    {
+	error("Error happened when open %s error(%s)", 
+		path, backend->strerror(ret));
+	free(sub_path);
+	return CFIO_ERROR_NC;
+    }
+
+    free(sub_path);
+    return CFIO_ERROR_NONE;
+}
+
 int cfio_io_create(cfio_msg_t *msg)
 {
     int ret, cmode;
@@ -559,7 +735,6 @@ int cfio_io_create(cfio_msg_t *msg)
     int return_code;
     int func_code = FUNC_NC_CREATE;
     char *path;
-    int sub_file_amount;
     int client_id = msg->src;
 
     //printf("create %d time : %f\n", (file_num ++) % 4, times_cur() - start_time);
@@ -576,7 +751,6 @@ int cfio_io_create(cfio_msg_t *msg)
     return CFIO_ERROR_NONE;
 #endif
 
-    /* TODO  */
     path = malloc(strlen(_path) + 32);
     sprintf(path, "%s", _path);
 
@@ -587,21 +761,14 @@ int cfio_io_create(cfio_msg_t *msg)
 	cfio_id_map_nc(client_nc_id, CFIO_ID_NC_INVALID);
 	//if(_bitmap_full(io_info->client_bitmap))
 	//{
-#ifndef SVR_NO_IO
-	ret = ncmpi_create(cfio_map_get_server_comm(), path, cmode, MPI_INFO_NULL, &nc_id);
-#else
-	ret = NC_NOERR;
-	nc_id = NC_NOERR;
-#endif
-	if(ret != NC_NOERR)
+	/* the nc functions are called in the same order with the writes in 
+	 * the pipeline in all servers */
+	cfio_pipe_drain();
+	if((ret = _create_nc(path, cmode, &nc_id)) < 0)
 	{
-	    error("Error happened when open %s error(%s)", 
-		    path, ncmpi_strerror(ret));
-	    return_code = CFIO_ERROR_NC;
-
+	    return_code = ret;
 	    goto RETURN;
 	}
-	//put attr of sub_amount
 
 	if(CFIO_ID_HASH_GET_NULL == cfio_id_get_nc(client_nc_id, &nc))
 	{
@@ -611,6 +778,7 @@ int cfio_io_create(cfio_msg_t *msg)
 	    assert(CFIO_ID_NC_INVALID == nc->nc_id);
 
 	    nc->nc_id = nc_id;
+	    nc->cmode = cmode;
 	}
     }
 
@@ -634,80 +802,270 @@ RETURN:
     return return_code;
 }
 
-int cfio_io_def_dim(cfio_msg_t *msg)
+/**
+ * @brief: create a mapped nc file from a ready template, the dims, vars and 
+ *	attributes of the template are defined and the file is put into 
+ *	DATA_MODE at once
+ *
+ * @param client_nc_id: the client nc id of the new nc
+ * @param template_nc_id: the client nc id of the template
+ * @param path: file name of the new nc
+ *
+ * @return: error code, CFIO_ERROR_NC_NO_EXIST if the template is not found
+ */
+static int _create_from_template(
+	int client_nc_id, int template_nc_id, char *path)
 {
-    int ret = 0;
-    int dim_id;
-    int client_nc_id, client_dim_id;
+    int ret, cmode;
     cfio_id_nc_t *nc;
-    cfio_id_dim_t *dim;
-    cfio_io_val_t *io_info;
-    size_t len;
-    char *name = NULL;
-    int client_id = msg->src;
-
-    int func_code = FUNC_NC_DEF_DIM;
-    int return_code;
+    cfio_id_att_t *att;
+    cfio_id_val_t *iter, *nc_val;
 
-    cfio_recv_unpack_def_dim(msg, &client_nc_id, &name, &len, &client_dim_id);
-    
-    debug(DEBUG_CFIO, "ncid = %d, name = %s, len = %lu",
-	    client_nc_id, name, len);
+    if(CFIO_ID_HASH_GET_NULL == cfio_id_map_nc_from_template(
+		client_nc_id, template_nc_id, &cmode))
+    {
+	return CFIO_ERROR_NC_NO_EXIST;
+    }
+    cfio_id_get_nc(client_nc_id, &nc);
 
-#ifdef SVR_UNPACK_ONLY
-    if(name != NULL)
+    cfio_pipe_drain();
+    if((ret = _create_nc(path, cmode, &nc->nc_id)) < 0)
     {
-	free(name);
-	name = NULL;
+	return ret;
     }
-    return CFIO_ERROR_NONE;
-#endif
 
-    //_recv_client_io(
-    //        client_id, func_code, client_nc_id, client_dim_id, 0, &io_info);
-	
-    if(CFIO_ID_HASH_GET_NULL == cfio_id_get_nc(client_nc_id, &nc))
+    qlist_for_each_entry(att, nc->att_head, link)
     {
-	return_code = CFIO_ERROR_INVALID_NC;
-	debug(DEBUG_IO, "Invalid NC ID.");
-	goto RETURN;
+	if((ret = _write_att(nc->nc_id, NC_GLOBAL, att)) < 0)
+	{
+	    return ret;
+	}
     }
 
-    if(CFIO_ID_HASH_GET_NULL == 
-            cfio_id_get_dim(client_nc_id, client_dim_id, &dim))
+    if((ret = _sub_box(client_nc_id)) < 0)
     {
-        cfio_id_map_dim(client_nc_id, client_dim_id, CFIO_ID_NC_INVALID, 
-        	CFIO_ID_DIM_INVALID, name, len);
-    }else
+	return ret;
+    }
+    cfio_id_get_val(client_nc_id, 0, 0, &nc_val);
+    qlist_for_each_entry(iter, &(nc_val->link), link)
     {
-	free(name);
+	if((ret = _handle_def(iter)) < 0)
+	{   
+	    return ret;
+	}
     }
+    ret = backend->enddef(nc->nc_id);
+    if(ret != NC_NOERR)
+    {
+	error("enddef error(%s)", backend->strerror(ret));
+	return CFIO_ERROR_NC;
+    }
+    nc->nc_status = DATA_MODE;
 
-    //if(_bitmap_full(io_info->client_bitmap))
-    //{
-    //    if(CFIO_ID_NC_INVALID == nc->nc_id)
-    //    {
-    //        return_code = CFIO_ERROR_INVALID_NC;
-    //        debug(DEBUG_IO, "Invalid NC ID.");
-    //        goto RETURN;
-    //    }
-    //    if(nc->nc_status != DEFINE_MODE)
-    //    {
-    //        return_code = CFIO_ERROR_NC_NOT_DEFINE;
-    //        debug(DEBUG_IO, "Only can define dim in DEFINE_MODE.");
-    //        goto RETURN;
-    //    }
+    debug(DEBUG_IO, "nc create(%s) from template(%d) success", 
+	    path, template_nc_id);
+    return CFIO_ERROR_NONE;
+}
 
-    //    ret = def_dim(nc->nc_id,name,len,&dim_id);
-    //    if( ret != NC_NOERR )
-    //    {
-    //        error("def dim(%s) error(%s)",name,ncmpi_strerror(ret));
-    //        return_code = CFIO_ERROR_NC;
-    //        goto RETURN;
-    //    }
-    //    
-    //    if(CFIO_ID_HASH_GET_NULL == 
-    //    	cfio_id_get_dim(client_nc_id, client_dim_id, &dim))
+/**
+ * @brief: create the nc files waiting for a template which is ready now
+ *
+ * @param template_nc_id: the client nc id of the template
+ *
+ * @return: error code
+ */
+static int _create_waiting(int template_nc_id)
+{
+    int ret, return_code = CFIO_ERROR_NONE;
+    cfio_io_wait_t *wait, *next;
+
+    qlist_for_each_entry_safe(wait, next, &template_wait_head, link)
+    {
+	if(wait->template_nc_id != template_nc_id)
+	{
+	    continue;
+	}
+	qlist_del(&(wait->link));
+	if((ret = _create_from_template(
+			wait->client_nc_id, template_nc_id, wait->path)) < 0)
+	{
+	    return_code = ret;
+	}
+	free(wait->path);
+	free(wait);
+    }
+
+    return return_code;
+}
+
+/**
+ * @brief: find the template a mapped nc is waiting for
+ *
+ * @param client_nc_id: the client nc id
+ *
+ * @return: the wait info, NULL if the nc is not waiting
+ */
+static cfio_io_wait_t *_find_waiting(int client_nc_id)
+{
+    cfio_io_wait_t *wait;
+
+    qlist_for_each_entry(wait, &template_wait_head, link)
+    {
+	if(wait->client_nc_id == client_nc_id)
+	{
+	    return wait;
+	}
+    }
+
+    return NULL;
+}
+
+int cfio_io_create_from_template(cfio_msg_t *msg)
+{
+    int ret;
+    char *path = NULL;
+    int client_nc_id, template_nc_id;
+    cfio_id_nc_t *nc, *template_nc;
+    cfio_io_wait_t *wait;
+    int return_code;
+
+    ret = cfio_recv_unpack_create_from_template(msg, 
+	    &path, &client_nc_id, &template_nc_id);
+    if( ret < 0 )
+    {
+	error("unpack_msg_create_from_template failed");
+	return CFIO_ERROR_MSG_UNPACK;
+    }
+
+#ifdef SVR_UNPACK_ONLY
+    return_code = CFIO_ERROR_NONE;
+    goto RETURN;
+#endif
+
+    /* the file is created by the first msg arrived */
+    if(CFIO_ID_HASH_GET_NULL != cfio_id_get_nc(client_nc_id, &nc))
+    {
+	return_code = CFIO_ERROR_NONE;
+	goto RETURN;
+    }
+    cfio_id_map_nc(client_nc_id, CFIO_ID_NC_INVALID);
+
+    return_code = _create_from_template(client_nc_id, template_nc_id, path);
+    if(CFIO_ERROR_NC_NO_EXIST != return_code)
+    {
+	goto RETURN;
+    }
+
+    /**
+     * the template's enddef is not done, which is possible since msgs from 
+     * different clients arrive in any order, wait for it
+     **/
+    if(CFIO_ID_HASH_GET_NULL == cfio_id_get_nc(template_nc_id, &template_nc)
+	    || DEFINE_MODE != template_nc->nc_status)
+    {
+	error("template(%d) of nc(%d) not found", 
+		template_nc_id, client_nc_id);
+	goto RETURN;
+    }
+    wait = malloc(sizeof(cfio_io_wait_t));
+    if(NULL == wait)
+    {
+	error("malloc fail.");
+	return_code = CFIO_ERROR_MALLOC;
+	goto RETURN;
+    }
+    wait->client_nc_id = client_nc_id;
+    wait->template_nc_id = template_nc_id;
+    wait->path = path;
+    path = NULL;
+    qlist_add_tail(&(wait->link), &template_wait_head);
+    debug(DEBUG_IO, "nc(%d) wait for template(%d)", 
+	    client_nc_id, template_nc_id);
+    return_code = CFIO_ERROR_NONE;
+
+RETURN:
+    if(NULL != path)
+    {
+	free(path);
+	path = NULL;
+    }
+    return return_code;
+}
+
+int cfio_io_def_dim(cfio_msg_t *msg)
+{
+    int ret = 0;
+    int dim_id;
+    int client_nc_id, client_dim_id;
+    cfio_id_nc_t *nc;
+    cfio_id_dim_t *dim;
+    cfio_io_val_t *io_info;
+    size_t len;
+    char *name = NULL;
+    int client_id = msg->src;
+
+    int func_code = FUNC_NC_DEF_DIM;
+    int return_code;
+
+    cfio_recv_unpack_def_dim(msg, &client_nc_id, &name, &len, &client_dim_id);
+    
+    debug(DEBUG_CFIO, "ncid = %d, name = %s, len = %lu",
+	    client_nc_id, name, len);
+
+#ifdef SVR_UNPACK_ONLY
+    if(name != NULL)
+    {
+	free(name);
+	name = NULL;
+    }
+    return CFIO_ERROR_NONE;
+#endif
+
+    //_recv_client_io(
+    //        client_id, func_code, client_nc_id, client_dim_id, 0, &io_info);
+	
+    if(CFIO_ID_HASH_GET_NULL == cfio_id_get_nc(client_nc_id, &nc))
+    {
+	return_code = CFIO_ERROR_INVALID_NC;
+	debug(DEBUG_IO, "Invalid NC ID.");
+	goto RETURN;
+    }
+
+    if(CFIO_ID_HASH_GET_NULL == 
+            cfio_id_get_dim(client_nc_id, client_dim_id, &dim))
+    {
+        cfio_id_map_dim(client_nc_id, client_dim_id, CFIO_ID_NC_INVALID, 
+        	CFIO_ID_DIM_INVALID, name, len);
+    }else
+    {
+	free(name);
+    }
+
+    //if(_bitmap_full(io_info->client_bitmap))
+    //{
+    //    if(CFIO_ID_NC_INVALID == nc->nc_id)
+    //    {
+    //        return_code = CFIO_ERROR_INVALID_NC;
+    //        debug(DEBUG_IO, "Invalid NC ID.");
+    //        goto RETURN;
+    //    }
+    //    if(nc->nc_status != DEFINE_MODE)
+    //    {
+    //        return_code = CFIO_ERROR_NC_NOT_DEFINE;
+    //        debug(DEBUG_IO, "Only can define dim in DEFINE_MODE.");
+    //        goto RETURN;
+    //    }
+
+    //    ret = def_dim(nc->nc_id,name,len,&dim_id);
+    //    if( ret != NC_NOERR )
+    //    {
+    //        error("def dim(%s) error(%s)",name,ncmpi_strerror(ret));
+    //        return_code = CFIO_ERROR_NC;
+    //        goto RETURN;
+    //    }
+    //    
+    //    if(CFIO_ID_HASH_GET_NULL == 
+    //    	cfio_id_get_dim(client_nc_id, client_dim_id, &dim))
     //    {
     //        cfio_id_map_dim(client_nc_id, client_dim_id, nc->nc_id, 
     //    	    dim_id, len);
@@ -733,6 +1091,41 @@ RETURN :
     return return_code;
 }
 
+/**
+ * @brief: merge a client's start and count into the var's start and count, 
+ *	and update each dim's len
+ *
+ * @param client_nc_id: the client nc id
+ * @param var: the var, its dim ids are still the client dim ids, or NULL if 
+ *	the leader's def_var hasn't arrived
+ * @param start: start of the client
+ * @param count: count of the client
+ */
+static void _update_var_decomp(int client_nc_id, cfio_id_var_t *var,
+	size_t *start, size_t *count)
+{
+    int i;
+    cfio_id_dim_t *dim;
+
+    _update_start_and_count(var->ndims, var->start, var->count, start, count);
+    if(NULL == var->dim_ids)
+    {
+	return;
+    }
+    for(i = 0; i < var->ndims; i ++)
+    {
+	if(CFIO_ID_HASH_GET_NULL == 
+		cfio_id_get_dim(client_nc_id, var->dim_ids[i], &dim))
+	{
+	    continue;
+	}
+	if((int)(var->count[i]) > (int)(dim->dim_len))
+	{
+	    dim->dim_len = var->count[i];
+	}
+    }
+}
+
 int cfio_io_def_var(cfio_msg_t *msg)
 {
     int ret = 0, i;
@@ -742,6 +1135,7 @@ int cfio_io_def_var(cfio_msg_t *msg)
     cfio_id_dim_t **dims = NULL; 
     cfio_id_var_t *var = NULL;
     cfio_io_val_t *io_info = NULL;
+    cfio_id_val_t *nc_val, *var_val;
     int *client_dim_ids = NULL;
     size_t *dims_len = NULL;
     char *name = NULL;
@@ -861,6 +1255,24 @@ int cfio_io_def_var(cfio_msg_t *msg)
 		    i, var->start[i], var->count[i]);
 	}
 
+	/**
+	 *the var is mapped by the decomp of a client which is not the meta 
+	 *leader, take the name and dims from the leader's def_var
+	 **/
+	if(NULL == var->dim_ids)
+	{
+	    var->name = name;
+	    var->dim_ids = client_dim_ids;
+	    name = NULL;
+	    client_dim_ids = NULL;
+	    /* defs are handled in list order at enddef, so move the var 
+	     * behind the dims which the leader defined before it */
+	    cfio_id_get_val(client_nc_id, 0, 0, &nc_val);
+	    cfio_id_get_val(client_nc_id, client_var_id, 0, &var_val);
+	    qlist_del(&(var_val->link));
+	    qlist_add_tail(&(var_val->link), &(nc_val->link));
+	}
+
 	/**
 	 *we need to free 4 pointer 
 	 **/
@@ -885,6 +1297,76 @@ RETURN :
     return return_code;
 }
 
+int cfio_io_def_var_decomp(cfio_msg_t *msg)
+{
+    int ret, ndims;
+    int client_nc_id, client_var_id;
+    cfio_id_nc_t *nc;
+    cfio_id_var_t *var;
+    size_t *start = NULL, *count = NULL;
+    cfio_type xtype;
+    int client_num;
+    int return_code;
+
+    ret = cfio_recv_unpack_def_var_decomp(msg, &client_nc_id, &xtype, &ndims, 
+	    &start, &count, &client_var_id);
+    if( ret < 0 )
+    {
+	error("unpack_msg_def_var_decomp failed");
+	return CFIO_ERROR_MSG_UNPACK;
+    }
+
+#ifdef SVR_UNPACK_ONLY
+    return_code = CFIO_ERROR_NONE;
+    goto RETURN;
+#endif
+
+    if(CFIO_ID_HASH_GET_NULL == cfio_id_get_nc(client_nc_id, &nc))
+    {
+	return_code = CFIO_ERROR_INVALID_NC;
+	debug(DEBUG_IO, "Invalid NC ID.");
+	goto RETURN;
+    }
+
+    if(CFIO_ID_HASH_GET_NULL == 
+	    cfio_id_get_var(client_nc_id, client_var_id, &var))
+    {
+	/**
+	 * the leader's def_var hasn't arrived, map the var without name and 
+	 * dims, so the client's put_vara can be kept in it, the leader's 
+	 * def_var will fill them. not need to free start and count
+	 **/
+	client_num = cfio_map_get_client_num_of_server(server_id);
+	cfio_id_map_var(NULL, client_nc_id, client_var_id, 
+		CFIO_ID_NC_INVALID, CFIO_ID_VAR_INVALID, 
+		ndims, NULL, start, count, xtype, client_num);
+	return CFIO_ERROR_NONE;
+    }
+
+    if(ndims != var->ndims)
+    {
+	return_code = CFIO_ERROR_WRONG_NDIMS;
+	debug(DEBUG_IO, "wrong ndims(%s), ndims(%d), var->ndims(%d)", 
+		var->name, ndims, var->ndims);
+	goto RETURN;
+    }
+    _update_var_decomp(client_nc_id, var, start, count);
+    return_code = CFIO_ERROR_NONE;
+
+RETURN :
+    if(start != NULL)
+    {
+	free(start);
+	start = NULL;
+    }
+    if(count != NULL)
+    {
+	free(count);
+	count = NULL;
+    }
+    return return_code;
+}
+
 int cfio_io_put_att(cfio_msg_t *msg)
 {
     int client_id = msg->src;
@@ -893,12 +1375,15 @@ int cfio_io_put_att(cfio_msg_t *msg)
     cfio_id_nc_t *nc;
     cfio_id_var_t *var;
     cfio_io_val_t *io_info;
+    cfio_id_att_t *att;
     char *name;
-    nc_type xtype;
+    cfio_type xtype;
     int len;
     char *data;
 
     int func_code = FUNC_PUT_ATT;
+    int meta_leader = cfio_conf_get_meta_leader();
+
     ret = cfio_recv_unpack_put_att(msg,
 	    &client_nc_id, &client_var_id, &name, &xtype, &len, (void **)&data);
     if( ret < 0 )
@@ -921,8 +1406,12 @@ int cfio_io_put_att(cfio_msg_t *msg)
     return CFIO_ERROR_NONE;
 #endif
     
-    _recv_client_io(
-	    client_id, func_code, client_nc_id, 0, client_var_id, &io_info);
+    /* only the meta leader sends the att, no need to wait other clients */
+    if(!meta_leader)
+    {
+	_recv_client_io(
+		client_id, func_code, client_nc_id, 0, client_var_id, &io_info);
+    }
 
     if(CFIO_ID_HASH_GET_NULL == cfio_id_get_nc(client_nc_id, &nc))
     {
@@ -931,61 +1420,30 @@ int cfio_io_put_att(cfio_msg_t *msg)
 	goto RETURN;
     }
 
-    if(_bitmap_full(io_info->client_bitmap))
+    if(meta_leader || _bitmap_full(io_info->client_bitmap))
     {
+	/* global attribute is also kept in the nc, so that the files created 
+	 * from it as a template get it */
+	if(CFIO_ID_HASH_GET_NULL == cfio_id_put_att(
+		    client_nc_id, client_var_id, name, xtype, len, data))
+	{
+	    error("");
+	    return_code = CFIO_ERROR_INVALID_NC;
+	    goto RETURN;
+	}
 	if(client_var_id == NC_GLOBAL)
 	{
-	    switch(xtype)
-	    {
-		case CFIO_CHAR :
-#ifndef SVR_NO_IO
-		    ret = ncmpi_put_att_text(nc->nc_id, NC_GLOBAL, name, len, data);
-#else
-		    ret = NC_NOERR;
-#endif
-		    break;
-		case CFIO_INT :
-#ifndef SVR_NO_IO
-		    ret = ncmpi_put_att_int(nc->nc_id, NC_GLOBAL, name, xtype, len, (const int*)data);
-#else
-		    ret = NC_NOERR;
-#endif
-		    break;
-		case CFIO_FLOAT :
-#ifndef SVR_NO_IO
-		    ret = ncmpi_put_att_float(nc->nc_id, NC_GLOBAL, name, xtype, len, (const float*)data);
-#else
-		    ret = NC_NOERR;
-#endif
-		    break;
-		case CFIO_DOUBLE :
-#ifndef SVR_NO_IO
-		    ret = ncmpi_put_att_double(nc->nc_id, NC_GLOBAL, name, xtype, len, (const double*)data);
-#else
-		    ret = NC_NOERR;
-#endif
-		    break;
-	    }
-	    if(ret != NC_NOERR)
+	    att = qlist_entry(nc->att_head->prev, cfio_id_att_t, link);
+	    cfio_pipe_drain();
+	    if((return_code = _write_att(nc->nc_id, NC_GLOBAL, att)) < 0)
 	    {
-		error("Error happened when put attr error(%s)", 
-			ncmpi_strerror(ret));
-		return_code = CFIO_ERROR_NC;
-
 		goto RETURN;
 	    }
 	}
-	else
+	if(!meta_leader)
 	{
-	    if(CFIO_ID_HASH_GET_NULL == cfio_id_put_att(
-			client_nc_id, client_var_id, name, xtype, len, data))
-	    {
-		error("");
-		return_code = CFIO_ERROR_INVALID_NC;
-		goto RETURN;
-	    }
+	    _remove_client_io(io_info);
 	}
-	_remove_client_io(io_info);
     }
     return_code = CFIO_ERROR_NONE;
 
@@ -1025,8 +1483,15 @@ int cfio_io_enddef(cfio_msg_t *msg)
 	    return CFIO_ERROR_INVALID_NC;
 	}
 
+	cfio_pipe_drain();
 	if(DEFINE_MODE == nc->nc_status)
 	{
+	    /* save before the dim ids of vars become server ids */
+	    cfio_id_save_template(client_nc_id);
+	    if((ret = _sub_box(client_nc_id)) < 0)
+	    {
+		return ret;
+	    }
 	    cfio_id_get_val(client_nc_id, 0, 0, &nc_val);
 	    qlist_for_each_entry(iter, &(nc_val->link), link)
 	    {
@@ -1035,44 +1500,1091 @@ int cfio_io_enddef(cfio_msg_t *msg)
 		    return ret;
 		}
 	    }
-#ifndef SVR_NO_IO
-	    ret = ncmpi_enddef(nc->nc_id);
-#else
-	    ret = NC_NOERR;
-#endif
-	    if(ret < 0)
+	    ret = backend->enddef(nc->nc_id);
+	    if(ret != NC_NOERR)
 	    {
-		error("enddef error(%s)",ncmpi_strerror(ret));
+		error("enddef error(%s)", backend->strerror(ret));
 		return CFIO_ERROR_NC;
 	    }
 
 	    nc->nc_status = DATA_MODE;
+	    _create_waiting(client_nc_id);
 	}
 	_remove_client_io(io_info);
     }
     return CFIO_ERROR_NONE;
 }
 
-int cfio_io_put_vara(cfio_msg_t *msg)
+/**
+ * @brief: check that a chunk is in the var's bound defined by def_var
+ *
+ * @param var: the var
+ * @param start: start of the chunk
+ * @param count: count of the chunk
+ *
+ * @return: error code, CFIO_ERROR_EXCEED_BOUND if the chunk is out of it
+ */
+static int _check_chunk_bound(cfio_id_var_t *var, size_t *start, 
+	size_t *count)
 {
-    int i,ret = 0, ndims;
-    cfio_id_nc_t *nc;
-    cfio_id_var_t *var;
-    cfio_io_val_t *io_info;
-    int client_nc_id, client_var_id;
-    size_t *start, *count;
-    size_t *total_start = NULL, *total_count = NULL;
+    int i;
+
+    for(i = 0; i < var->ndims; i ++)
+    {
+	if(start[i] < var->start[i] || 
+		start[i] + count[i] > var->start[i] + var->count[i])
+	{
+	    error("chunk of var(%s) exceeds the defined bound, dim %d : "
+		    "start(%lu), count(%lu); var : start(%lu), count(%lu)",
+		    var->name, i, start[i], count[i], 
+		    var->start[i], var->count[i]);
+	    return CFIO_ERROR_EXCEED_BOUND;
+	}
+    }
+
+    return CFIO_ERROR_NONE;
+}
+
+/**
+ * @brief: allocate the var's assemble buffer with the var's start and count,
+ *	and copy the chunks waiting for it
+ *
+ * @param var: the var
+ * @param ele_size: size of each element of the var
+ *
+ * @return: error code, CFIO_ERROR_EXCEED_BOUND if a waiting chunk is out of 
+ *	the var's bound
+ */
+static int _alloc_assemble_buf(cfio_id_var_t *var, size_t ele_size)
+{
+    int i, ret, return_code = CFIO_ERROR_NONE;
     size_t data_size;
+    cfio_id_chunk_t *chunk, *next;
+
+    if(NULL != var->data)
+    {
+	return CFIO_ERROR_NONE;
+    }
+
+    data_size = ele_size;
+    for(i = 0; i < var->ndims; i ++)
+    {
+	data_size *= var->count[i];
+    }
+    var->data = malloc(data_size);
+    if(NULL == var->data)
+    {
+	error("malloc for var(%s) data fail.", var->name);
+	return CFIO_ERROR_MALLOC;
+    }
+    debug(DEBUG_IO, "malloc for var(%s) data, size = %lu", 
+	    var->name, data_size);
+
+    /* the chunks kept in define mode are checked against the bound only 
+     * now, a chunk out of it is dropped */
+    qlist_for_each_entry_safe(chunk, next, var->chunk_head, link)
+    {
+	if((ret = _check_chunk_bound(var, chunk->start, chunk->count)) < 0)
+	{
+	    return_code = ret;
+	}else
+	{
+	    cfio_assemble_put(var->ndims, ele_size, 
+		    var->start, var->count, var->data,
+		    chunk->start, chunk->count, chunk->buf);
+	}
+	qlist_del(&(chunk->link));
+	free(chunk->buf);
+	free(chunk->start);
+	free(chunk->count);
+	free(chunk);
+    }
+
+    return return_code;
+}
+
+/**
+ * @brief: copy a chunk into the var's assemble buffer
+ *
+ * @param var: the var
+ * @param ele_size: size of each element of the var
+ * @param start: start of the chunk
+ * @param count: count of the chunk
+ * @param data: data of the chunk
+ *
+ * @return: error code
+ */
+static int _assemble_chunk(cfio_id_var_t *var, size_t ele_size,
+	size_t *start, size_t *count, char *data)
+{
+    int ret;
+
+    if((ret = _check_chunk_bound(var, start, count)) < 0)
+    {
+	return ret;
+    }
+
+    if((ret = _alloc_assemble_buf(var, ele_size)) < 0)
+    {
+	return ret;
+    }
+
+    cfio_assemble_put(var->ndims, ele_size, 
+	    var->start, var->count, var->data, start, count, data);
+
+    return CFIO_ERROR_NONE;
+}
+
+/**
+ * @brief: whether the vars are posted with iput and waited together, the 
+ *	engine must be able to post writes
+ *
+ * @return: 1 if yes, 0 if each var is written with a blocking put
+ */
+static inline int _is_aggregate()
+{
+    return NULL != backend->iput_vara && 
+	cfio_conf_get_flush_size() >= CFIO_CONF_FLUSH_AT_CLOSE;
+}
+
+/**
+ * @brief: get the amount of elements of a block
+ *
+ * @param ndims: number of dims of the block
+ * @param count: count of the block
+ *
+ * @return: amount of elements
+ */
+static inline MPI_Offset _ele_num(int ndims, const MPI_Offset *count)
+{
+    int i;
+    MPI_Offset num = 1;
+
+    for(i = 0; i < ndims; i ++)
+    {
+	num *= count[i];
+    }
+    return num;
+}
+
+/**
+ * @brief: allocate a non-blocking put request, it is allocated before the 
+ *	iput of the engine so that a posted request can always be recorded
+ *
+ * @param buf_num: number of data buffers the request will own
+ *
+ * @return: the request, NULL if malloc fail
+ */
+static cfio_id_req_t *_new_req(int buf_num)
+{
+    cfio_id_req_t *req;
+
+    if(NULL == (req = malloc(sizeof(cfio_id_req_t))))
+    {
+	error("malloc for req fail.");
+	return NULL;
+    }
+    req->req = NC_REQ_NULL;
+    req->buf_num = buf_num;
+    req->buf_type = MPI_DATATYPE_NULL;
+    if(NULL == (req->bufs = malloc(sizeof(char *) * buf_num)))
+    {
+	error("malloc for req bufs fail.");
+	free(req);
+	return NULL;
+    }
+    memset(req->bufs, 0, sizeof(char *) * buf_num);
+
+    return req;
+}
+
+/**
+ * @brief: wait all the non-blocking put requests of the nc with one 
+ *	wait_all of the engine, and free their data. It is collective, all 
+ *	servers call it at the same point because they post the same vars
+ *
+ * @param nc: the nc
+ *
+ * @return: error code
+ */
+static int _wait_nc(cfio_id_nc_t *nc)
+{
+    int i, num, ret = NC_NOERR;
+    int return_code = CFIO_ERROR_NONE;
+    int *reqs = NULL, *statuses = NULL;
+    cfio_id_req_t *req, *next;
+
+    num = qlist_count(nc->req_head);
+    if(num > 0)
+    {
+	reqs = malloc(sizeof(int) * num);
+	statuses = malloc(sizeof(int) * num);
+	if(NULL == reqs || NULL == statuses)
+	{
+	    error("malloc for wait fail.");
+	    return_code = CFIO_ERROR_MALLOC;
+	    goto RETURN;
+	}
+    }
+    i = 0;
+    qlist_for_each_entry(req, nc->req_head, link)
+    {
+	reqs[i ++] = req->req;
+    }
+
+    debug(DEBUG_IO, "nc(%d) wait %d reqs, size = %lu", 
+	    nc->nc_id, num, nc->req_size);
+
+    ret = backend->wait_all(nc->nc_id, num, reqs, statuses);
+    if(ret != NC_NOERR)
+    {
+	error("wait nc(%d) failure(%s)", nc->nc_id, backend->strerror(ret));
+	return_code = CFIO_ERROR_NC;
+	goto RETURN;
+    }
+    for(i = 0; i < num; i ++)
+    {
+	if(NC_NOERR != statuses[i])
+	{
+	    error("write nc(%d) req(%d) failure(%s)", 
+		    nc->nc_id, reqs[i], backend->strerror(statuses[i]));
+	    return_code = CFIO_ERROR_NC;
+	}
+    }
+
+RETURN :
+    qlist_for_each_entry_safe(req, next, nc->req_head, link)
+    {
+	qlist_del(&(req->link));
+	cfio_id_req_free(req);
+    }
+    nc->req_size = 0;
+    if(NULL != reqs)
+    {
+	free(reqs);
+	reqs = NULL;
+    }
+    if(NULL != statuses)
+    {
+	free(statuses);
+	statuses = NULL;
+    }
+    return return_code;
+}
+
+/**
+ * @brief: write the block recieved from each client directly with one 
+ *	multi-region put_varn, or post it with an iput_varn if the
+ *	writes are aggregated. The blocks are described by a hindexed datatype 
+ *	on MPI_BOTTOM, so no merge buffer is needed and the blocks need not 
+ *	form a rectangle
+ *
+ * @param nc: the nc which the var belongs to
+ * @param var: the var whose data is recieved from all clients
+ *
+ * @return: error code
+ */
+static int _write_var_varn(cfio_id_nc_t *nc, cfio_id_var_t *var)
+{
+    int i, j, num, ret = NC_NOERR;
+    int return_code = CFIO_ERROR_NONE;
+    int *blocklens = NULL;
+    size_t ele_num;
+    MPI_Aint *displs = NULL;
+    MPI_Offset *pnc_offset = NULL;
+    MPI_Offset **pnc_starts = NULL, **pnc_counts = NULL;
+    MPI_Datatype ele_type, buf_type = MPI_DATATYPE_NULL;
+    cfio_id_req_t *nc_req;
+
+    ele_type = cfio_type_to_mpi(var->data_type);
+    if(MPI_DATATYPE_NULL == ele_type)
+    {
+	error("var(%s) has unknown type(%d)", var->name, var->data_type);
+	return CFIO_ERROR_INVALID_VAR;
+    }
+
+    num = 0;
+    for(i = 0; i < var->client_num; i ++)
+    {
+	if(NULL != var->recv_data[i].buf)
+	{
+	    num ++;
+	}
+    }
+
+    if(num > 0)
+    {
+	blocklens = cfio_mem_arena_alloc(&scratch, sizeof(int) * num);
+	displs = cfio_mem_arena_alloc(&scratch, sizeof(MPI_Aint) * num);
+	pnc_starts = cfio_mem_arena_alloc(&scratch, 
+		sizeof(MPI_Offset *) * num);
+	pnc_counts = cfio_mem_arena_alloc(&scratch, 
+		sizeof(MPI_Offset *) * num);
+	pnc_offset = cfio_mem_arena_alloc(&scratch, 
+		sizeof(MPI_Offset) * num * var->ndims * 2);
+	if(NULL == blocklens || NULL == displs || NULL == pnc_starts ||
+		NULL == pnc_counts || NULL == pnc_offset)
+	{
+	    error("malloc for varn request fail.");
+	    return_code = CFIO_ERROR_MALLOC;
+	    goto RETURN;
+	}
+    }
+
+    num = 0;
+    for(i = 0; i < var->client_num; i ++)
+    {
+	if(NULL == var->recv_data[i].buf)
+	{
+	    continue;
+	}
+	pnc_starts[num] = pnc_offset + num * var->ndims * 2;
+	pnc_counts[num] = pnc_starts[num] + var->ndims;
+	ele_num = 1;
+	for(j = 0; j < var->ndims; j ++)
+	{
+	    pnc_starts[num][j] = 
+		var->recv_data[i].start[j] - _sub_offset(var, j);
+	    pnc_counts[num][j] = var->recv_data[i].count[j];
+	    ele_num *= var->recv_data[i].count[j];
+	}
+	blocklens[num] = ele_num;
+	MPI_Get_address(var->recv_data[i].buf, &displs[num]);
+	num ++;
+    }
+    
+    debug(DEBUG_IO, "nc_id = %d, var_id = %d, %d blocks", 
+	    nc->nc_id, var->var_id, num);
+
+    if(_is_aggregate())
+    {
+	if(num > 0)
+	{
+	    /* the blocks must stay until the wait, the request owns them */
+	    if(NULL == (nc_req = _new_req(num)))
+	    {
+		return_code = CFIO_ERROR_MALLOC;
+		goto RETURN;
+	    }
+	    MPI_Type_create_hindexed(num, blocklens, displs, 
+		    ele_type, &nc_req->buf_type);
+	    MPI_Type_commit(&nc_req->buf_type);
+	    ret = backend->iput_varn(nc->nc_id, var->var_id, num,
+		    pnc_starts, pnc_counts, MPI_BOTTOM, 1, nc_req->buf_type, 
+		    &nc_req->req);
+	    num = 0;
+	    for(i = 0; i < var->client_num; i ++)
+	    {
+		if(NULL != var->recv_data[i].buf)
+		{
+		    nc_req->bufs[num ++] = var->recv_data[i].buf;
+		    var->recv_data[i].buf = NULL;
+		}
+	    }
+	    qlist_add_tail(&(nc_req->link), nc->req_head);
+	}
+    }else
+    {
+	if(num > 0)
+	{
+	    MPI_Type_create_hindexed(num, blocklens, displs, 
+		    ele_type, &buf_type);
+	    MPI_Type_commit(&buf_type);
+	    ret = backend->put_varn(nc->nc_id, var->var_id, num,
+		    pnc_starts, pnc_counts, MPI_BOTTOM, 1, buf_type);
+	    MPI_Type_free(&buf_type);
+	}else
+	{
+	    /* take part in the collective call even with nothing to write */
+	    ret = backend->put_varn(nc->nc_id, var->var_id, 0,
+		    NULL, NULL, NULL, 0, ele_type);
+	}
+    }
+
+    if( ret != NC_NOERR )
+    {
+	error("write nc(%d) var (%d) failure(%s)",
+		nc->nc_id,var->var_id,backend->strerror(ret));
+	return_code = CFIO_ERROR_NC;
+    }
+
+RETURN :
+    for(i = 0; i < var->client_num; i ++)
+    {
+	cfio_id_free_data(var->recv_data[i].buf);	
+	var->recv_data[i].buf = NULL;	
+	free(var->recv_data[i].start);	
+	var->recv_data[i].start = NULL;	
+	free(var->recv_data[i].count);	
+	var->recv_data[i].count = NULL;	
+    }
+    return return_code;
+}
+
+/**
+ * @brief: post an iput_vara of a var's data, the data is owned by the 
+ *	request until the wait
+ *
+ * @param nc: the nc which the var belongs to
+ * @param var: the var
+ * @param start: start of the data in the var
+ * @param count: count of the data
+ * @param data: pointer to the data, set to NULL if the request owns it
+ *
+ * @return: error code
+ */
+static int _iput_vara(cfio_id_nc_t *nc, cfio_id_var_t *var, 
+	MPI_Offset *start, MPI_Offset *count, char **data)
+{
+    int ret = NC_NOERR;
+    cfio_id_req_t *req;
+
+    /* not written, the same as the blocking put */
+    if(CFIO_BYTE == var->data_type || CFIO_CHAR == var->data_type)
+    {
+	return CFIO_ERROR_NONE;
+    }
+
+    if(NULL == (req = _new_req(1)))
+    {
+	return CFIO_ERROR_MALLOC;
+    }
+
+    ret = backend->iput_vara(nc->nc_id, var->var_id, start, count, 
+	    *data, _ele_num(var->ndims, count), 
+	    cfio_type_to_mpi(var->data_type), &req->req);
+    req->bufs[0] = *data;
+    *data = NULL;
+    qlist_add_tail(&(req->link), nc->req_head);
+
+    if( ret != NC_NOERR )
+    {
+	error("post nc(%d) var (%d) failure(%s)",
+		nc->nc_id,var->var_id,backend->strerror(ret));
+	return CFIO_ERROR_NC;
+    }
+
+    return CFIO_ERROR_NONE;
+}
+
+/**
+ * @brief: merge a var's data into one buffer, if some data is put in chunks 
+ *	or assembled when it arrives, the var's assemble buffer is used, and 
+ *	grown to the bounding box of it and the data kept, else the bounding box
+ *	of all recieved data
+ *
+ * @param var: the var
+ * @param total_start: where the start of the merged data is to be stored
+ * @param total_count: where the count of the merged data is to be stored
+ * @param total_data: pointer to where the merged data is to be stored
+ *
+ * @return: error code
+ */
+static int _merge_var(cfio_id_var_t *var, 
+	size_t *total_start, size_t *total_count, char **total_data)
+{
+    int i, grown = 0;
+    int ret;
+    size_t ele_size, data_size;
     char *data;
-    char *total_data = NULL;
-    int data_len, data_type, client_index;
-    size_t *put_start;
-    int client_id = msg->src;
+
+    if(NULL != var->data || !qlist_empty(var->chunk_head))
+    {
+	cfio_types_size(ele_size, var->data_type);
+	if((ret = _alloc_assemble_buf(var, ele_size)) < 0)
+	{
+	    return ret;
+	}
+	for(i = 0; i < var->ndims; i ++)
+	{
+	    total_start[i] = var->start[i];
+	    total_count[i] = var->count[i];
+	}
+	/* data put before the nc enters data mode, or out of the var's 
+	 * start and count, is kept */
+	for(i = 0; i < var->client_num; i ++)
+	{
+	    if(NULL != var->recv_data[i].buf)
+	    {
+		_update_start_and_count(var->ndims, total_start, total_count,
+			var->recv_data[i].start, var->recv_data[i].count);
+	    }
+	}
+	data = var->data;
+	for(i = 0; i < var->ndims; i ++)
+	{
+	    grown |= (total_count[i] != var->count[i]);
+	}
+	if(grown)
+	{
+	    data_size = ele_size;
+	    for(i = 0; i < var->ndims; i ++)
+	    {
+		data_size *= total_count[i];
+	    }
+	    if(NULL == (data = malloc(data_size)))
+	    {
+		error("malloc for var(%s) data fail.", var->name);
+		return CFIO_ERROR_MALLOC;
+	    }
+	    cfio_assemble_put(var->ndims, ele_size, total_start, total_count, 
+		    data, var->start, var->count, var->data);
+	    free(var->data);
+	}
+	var->data = NULL;
+	for(i = 0; i < var->client_num; i ++)
+	{
+	    if(NULL == var->recv_data[i].buf)
+	    {
+		continue;
+	    }
+	    cfio_assemble_put(var->ndims, ele_size, 
+		    total_start, total_count, data,
+		    var->recv_data[i].start, var->recv_data[i].count,
+		    var->recv_data[i].buf);
+	    cfio_id_free_data(var->recv_data[i].buf);	
+	    var->recv_data[i].buf = NULL;	
+	    free(var->recv_data[i].start);	
+	    var->recv_data[i].start = NULL;	
+	    free(var->recv_data[i].count);	
+	    var->recv_data[i].count = NULL;	
+	}
+	*total_data = data;
+    }else
+    {
+	_merge_var_data(var, total_start, total_count, total_data);
+    }
+
+    return CFIO_ERROR_NONE;
+}
+
+/**
+ * @brief: write a var's merged data with vara
+ *
+ * @param nc: the nc which the var belongs to
+ * @param var: the var
+ * @param total_start: start of the merged data
+ * @param total_count: count of the merged data
+ * @param _total_data: pointer to the merged data, set to NULL when it is 
+ *	freed or owned by a request
+ *
+ * @return: error code
+ */
+static int _write_var_merge(cfio_id_nc_t *nc, cfio_id_var_t *var,
+	size_t *total_start, size_t *total_count, char **_total_data)
+{
+    int i, ret = NC_NOERR;
+    int return_code = CFIO_ERROR_NONE;
+    char *total_data = *_total_data;
+    MPI_Offset *pnc_start = NULL, *pnc_count = NULL;
+
+    *_total_data = NULL;
+
+    for(i = 0; i < var->ndims; i ++)
+    {
+	debug(DEBUG_IO, "dim %d: start(%lu), count(%lu)", 
+		i, total_start[i], total_count[i]);
+    //    printf( "server %d: dim %d: start(%lu), count(%lu)\n", 
+    //	    server_id, i, total_start[i], total_count[i]);
+    }
+    debug(DEBUG_IO, "nc_id = %d, var_id = %d", nc->nc_id, var->var_id);
+    debug(DEBUG_IO, "first data = %f", ((float *)total_data)[0]);
+    
+    pnc_start = cfio_mem_arena_alloc(&scratch, 
+	    sizeof(MPI_Offset) * var->ndims);
+    pnc_count = cfio_mem_arena_alloc(&scratch, 
+	    sizeof(MPI_Offset) * var->ndims);
+    if(NULL == pnc_start || NULL == pnc_count)
+    {
+	return_code = CFIO_ERROR_MALLOC;
+	goto RETURN;
+    }
+    for(i = 0; i < var->ndims; i ++)
+    {
+	pnc_start[i] = total_start[i] - _sub_offset(var, i);
+	pnc_count[i] = total_count[i];
+    }
+    
+    for(i = 0; i < var->ndims; i ++)
+    {
+	debug(DEBUG_IO, "dim %d: start(%lu), count(%lu)", 
+		i, total_start[i], total_count[i]);
+	debug(DEBUG_IO, "dim %d: start(%lld), count(%lld)", 
+		i, pnc_start[i], pnc_count[i]);
+    }
+
+    if(_is_aggregate())
+    {
+	return_code = _iput_vara(nc, var, pnc_start, pnc_count, &total_data);
+	goto RETURN;
+    }
+
+    /* byte and char vars are not written */
+    if(CFIO_BYTE != var->data_type && CFIO_CHAR != var->data_type)
+    {
+	ret = backend->put_vara(nc->nc_id, var->var_id, pnc_start, pnc_count,
+		total_data, _ele_num(var->ndims, pnc_count), 
+		cfio_type_to_mpi(var->data_type));
+    }
+    //end_time = times_cur();
+    //write_time += end_time - start_time;
+
+    if( ret != NC_NOERR )
+    {
+	error("write nc(%d) var (%d) failure(%s)",
+		nc->nc_id,var->var_id,backend->strerror(ret));
+	return_code = CFIO_ERROR_NC;
+    }
+
+RETURN :
+    if(total_data != NULL)
+    {
+	free(total_data);
+	total_data = NULL;
+    }
+    return return_code;
+}
+
+/**
+ * @brief: free a write job and the data it still owns
+ *
+ * @param job: the job
+ */
+static void _free_job(cfio_io_job_t *job)
+{
+    cfio_id_chunk_t *chunk, *next;
+    int i;
+
+    if(NULL != job->var.recv_data)
+    {
+	for(i = 0; i < job->var.client_num; i ++)
+	{
+	    cfio_id_free_data(job->var.recv_data[i].buf);
+	    free(job->var.recv_data[i].start);
+	    free(job->var.recv_data[i].count);
+	}
+	free(job->var.recv_data);
+    }
+    qlist_for_each_entry_safe(chunk, next, &(job->chunk_head), link)
+    {
+	qlist_del(&(chunk->link));
+	free(chunk->buf);
+	free(chunk->start);
+	free(chunk->count);
+	free(chunk);
+    }
+    free(job->var.data);
+    free(job->start);
+    free(job->count);
+    free(job->data);
+    cfio_mem_slab_free(&job_slab, job);
+}
+
+/**
+ * @brief: merge the data of a write job, called in an assemble thread
+ *
+ * @param _job: the job
+ *
+ * @return: error code
+ */
+static int _assemble_job(cfio_pipe_job_t *_job)
+{
+    cfio_io_job_t *job = (cfio_io_job_t *)_job;
+
+    return _merge_var(&job->var, job->start, job->count, &job->data);
+}
+
+/**
+ * @brief: write the data of a write job and free the job, called in the io
+ *	thread. If the writes are aggregated, wait all the posted writes of the
+ *	nc once their global size reaches the flush size
+ *
+ * @param _job: the job
+ *
+ * @return: error code
+ */
+static int _write_job(cfio_pipe_job_t *_job)
+{
+    cfio_io_job_t *job = (cfio_io_job_t *)_job;
+    cfio_id_nc_t *nc = job->nc;
+    int flush_size = cfio_conf_get_flush_size();
+    int ret = job->job.ret, wait_ret;
+
+    if(ret >= 0)
+    {
+	if(job->varn)
+	{
+	    ret = _write_var_varn(nc, &job->var);
+	}else
+	{
+	    ret = _write_var_merge(nc, &job->var, job->start, job->count,
+		    &job->data);
+	}
+    }
+
+    /* global size is the same in all servers, so they wait together. it is
+     * counted even if the var failed here, else this server would leave 
+     * the others in the collective wait */
+    if(_is_aggregate())
+    {
+	nc->req_size += job->var.global_size;
+	if(CFIO_CONF_FLUSH_AT_CLOSE != flush_size && 
+		nc->req_size >= (size_t)flush_size * 1024 * 1024)
+	{
+	    wait_ret = _wait_nc(nc);
+	    if(ret >= 0)
+	    {
+		ret = wait_ret;
+	    }
+	}
+    }
+
+    _free_job(job);
+    return ret;
+}
+
+/**
+ * @brief: write a var's data which is recieved from all clients, in varn 
+ *	output mode the blocks of clients are written directly, else they are 
+ *	merged. The data is taken from the var into a job of the server 
+ *	pipeline, so it is merged and written while the next msgs are decoded
+ *
+ * @param nc: the nc which the var belongs to
+ * @param var: the var
+ *
+ * @return: error code
+ */
+static int _write_var(cfio_id_nc_t *nc, cfio_id_var_t *var)
+{
+    cfio_io_job_t *job;
+    int i;
+
+    job = cfio_mem_slab_alloc(&job_slab);
+    if(NULL == job)
+    {
+	error("malloc for job fail.");
+	return CFIO_ERROR_MALLOC;
+    }
+    job->nc = nc;
+    job->var = *var;
+    job->data = NULL;
+    INIT_QLIST_HEAD(&(job->chunk_head));
+    job->var.chunk_head = &(job->chunk_head);
+    job->var.data = NULL;
+    job->start = malloc(sizeof(size_t) * var->ndims);
+    job->count = malloc(sizeof(size_t) * var->ndims);
+    job->var.recv_data = malloc(sizeof(cfio_id_data_t) * var->client_num);
+    if(NULL == job->start || NULL == job->count || 
+	    NULL == job->var.recv_data)
+    {
+	error("malloc for job fail.");
+	free(job->var.recv_data);
+	job->var.recv_data = NULL;
+	_free_job(job);
+	return CFIO_ERROR_MALLOC;
+    }
+
+    memcpy(job->var.recv_data, var->recv_data, 
+	    sizeof(cfio_id_data_t) * var->client_num);
+    for(i = 0; i < var->client_num; i ++)
+    {
+	var->recv_data[i].buf = NULL;
+	var->recv_data[i].start = NULL;
+	var->recv_data[i].count = NULL;
+    }
+    job->var.data = var->data;
+    var->data = NULL;
+    qlist_splice(var->chunk_head, &(job->chunk_head));
+    INIT_QLIST_HEAD(var->chunk_head);
+
+    /* a var put in chunks is assembled in var->data, write it with vara */
+    job->varn = (CFIO_CONF_OUTPUT_VARN == cfio_conf_get_output_mode() &&
+	    NULL == job->var.data && qlist_empty(&(job->chunk_head)));
+    job->job.assemble = job->varn ? NULL : _assemble_job;
+    job->job.write = _write_job;
+
+    return cfio_pipe_put(&(job->job));
+}
+
+/**
+ * @brief: get the nc and var of a put_vara which data is recieved from all 
+ *	clients, and check them
+ *
+ * @param client_nc_id: the client nc id
+ * @param client_var_id: the client var id
+ * @param ndims: ndims of the put_vara
+ * @param nc: pointer to where the nc is to be stored
+ * @param var: pointer to where the var is to be stored
+ *
+ * @return: error code
+ */
+static inline int _get_put_var(int client_nc_id, int client_var_id, int ndims,
+	cfio_id_nc_t **nc, cfio_id_var_t **var)
+{
+    if(CFIO_ID_HASH_GET_NULL == cfio_id_get_nc(client_nc_id, nc) ||
+	    CFIO_ID_NC_INVALID == (*nc)->nc_id)
+    {
+	debug(DEBUG_IO, "Invalid nc.");
+	return CFIO_ERROR_INVALID_NC;
+    }
+    if(CFIO_ID_HASH_GET_NULL == 
+	    cfio_id_get_var(client_nc_id, client_var_id, var) ||
+	    CFIO_ID_VAR_INVALID == (*var)->var_id)
+    {
+	debug(DEBUG_IO, "Invalid var.");
+	return CFIO_ERROR_INVALID_VAR;
+    }
+
+    if(ndims != (*var)->ndims)
+    {
+	debug(DEBUG_IO, "wrong ndims(%s), ndims(%d), var->ndims(%d)", 
+		(*var)->name, ndims, (*var)->ndims);
+	return CFIO_ERROR_WRONG_NDIMS;
+    }
+
+    return CFIO_ERROR_NONE;
+}
+
+/**
+ * @brief: map a var without name and dims for a put of a nc which is waiting 
+ *	for its template, so the data can be kept until the template is ready
+ *
+ * @param client_nc_id: the client nc id
+ * @param client_var_id: the client var id
+ * @param ndims: the dimensionality of the var
+ * @param start: start of the put
+ * @param count: count of the put
+ * @param data_type: type of the var
+ */
+static void _map_waiting_var(int client_nc_id, int client_var_id, int ndims,
+	size_t *start, size_t *count, int data_type)
+{
+    cfio_id_var_t *var;
+    size_t *_start, *_count;
+    int client_num;
+
+    if(NULL == _find_waiting(client_nc_id) || CFIO_ID_HASH_GET_NULL != 
+	    cfio_id_get_var(client_nc_id, client_var_id, &var))
+    {
+	return;
+    }
+
+    _start = malloc(sizeof(size_t) * ndims);
+    _count = malloc(sizeof(size_t) * ndims);
+    memcpy(_start, start, sizeof(size_t) * ndims);
+    memcpy(_count, count, sizeof(size_t) * ndims);
+    client_num = cfio_map_get_client_num_of_server(server_id);
+    cfio_id_map_var(NULL, client_nc_id, client_var_id, 
+	    CFIO_ID_NC_INVALID, CFIO_ID_VAR_INVALID, 
+	    ndims, NULL, _start, _count, data_type, client_num);
+}
+
+/**
+ * @brief: whether the data of a put_vara can be copied into the var's 
+ *	assemble buffer when it arrives. The buffer is of the decomposition 
+ *	declared in def_var, so the nc must be in data mode and the data must 
+ *	lie in the decomposition. In varn output mode the data of each client 
+ *	is kept to be written without merge
+ *
+ * @param client_nc_id: the client nc id
+ * @param client_var_id: the client var id
+ * @param ndims: ndims of the put_vara
+ * @param start: start of the put_vara
+ * @param count: count of the put_vara
+ * @param data_type: type of the data
+ * @param var: pointer to where the var is to be stored
+ *
+ * @return: 1 if yes, 0 if not
+ */
+static inline int _is_in_place(int client_nc_id, int client_var_id, 
+	int ndims, size_t *start, size_t *count, int data_type,
+	cfio_id_var_t **var)
+{
+    cfio_id_nc_t *nc;
+    int i;
+
+    if(CFIO_CONF_OUTPUT_VARN == cfio_conf_get_output_mode() ||
+	    CFIO_ID_HASH_GET_NULL == cfio_id_get_nc(client_nc_id, &nc) ||
+	    CFIO_ID_NC_INVALID == nc->nc_id || DATA_MODE != nc->nc_status ||
+	    CFIO_ID_HASH_GET_NULL == 
+	    cfio_id_get_var(client_nc_id, client_var_id, var) ||
+	    CFIO_ID_VAR_INVALID == (*var)->var_id ||
+	    ndims != (*var)->ndims || data_type != (*var)->data_type)
+    {
+	return 0;
+    }
+
+    for(i = 0; i < ndims; i ++)
+    {
+	if(start[i] < (*var)->start[i] || 
+		start[i] + count[i] > (*var)->start[i] + (*var)->count[i])
+	{
+	    return 0;
+	}
+    }
+
+    return 1;
+}
+
+/**
+ * @brief: keep the data of a put_vara until the var is written. it is kept in
+ *	the recv buffer without copy if the var is written once all clients put
+ *	it, else it is copied, for the recv buffer must not be held by data 
+ *	waiting for later msgs, the enddef of a nc in define mode, the template
+ *	of a nc waiting for it, or the close which waits the requests of varn
+ *
+ * @param client_nc_id: the client nc id
+ * @param size: size of the data
+ * @param data: the data in the recv buffer
+ * @param _data: pointer to where the kept data is to be stored, it is freed 
+ *	by cfio_id_free_data
+ *
+ * @return: error code
+ */
+static int _keep_data(int client_nc_id, size_t size, char *data, 
+	char **_data)
+{
+    cfio_id_nc_t *nc;
+    int ret;
+
+    if(size > 0 && 
+	    CFIO_ID_HASH_GET_NULL != cfio_id_get_nc(client_nc_id, &nc) &&
+	    CFIO_ID_NC_INVALID != nc->nc_id && DATA_MODE == nc->nc_status &&
+	    !(CFIO_CONF_OUTPUT_VARN == cfio_conf_get_output_mode() && 
+		_is_aggregate()))
+    {
+	if((ret = cfio_recv_hold_last()) < 0)
+	{
+	    return ret;
+	}
+	*_data = data;
+	return CFIO_ERROR_NONE;
+    }
+
+    *_data = malloc(size);
+    if(NULL == *_data && size > 0)
+    {
+	error("malloc for data fail.");
+	return CFIO_ERROR_MALLOC;
+    }
+    memcpy(*_data, data, size);
+
+    return CFIO_ERROR_NONE;
+}
+
+/**
+ * @brief: put the data of a put_vara from a client into its var, and write the
+ *	var if all clients have put it
+ *
+ * @param client_id: id of the client
+ * @param client_nc_id: netCDF ID of the client
+ * @param client_var_id: variable ID of the client
+ * @param ndims: dimensionality of the variable
+ * @param start: start of the data, freed here unless it is kept in the var
+ * @param count: count of the data, freed here unless it is kept in the var
+ * @param data_len: amount of elements of the data
+ * @param data_type: type of the data
+ * @param data: the data, in the recv buffer
+ *
+ * @return: error code
+ */
+static int _put_vara(int client_id, int client_nc_id, int client_var_id,
+	int ndims, size_t *start, size_t *count, 
+	int data_len, int data_type, char *data)
+{
+    cfio_id_nc_t *nc;
+    cfio_id_var_t *var;
+    cfio_io_val_t *io_info;
+    size_t ele_size;
+    char *_data;
+    int client_index;
 
     int func_code = FUNC_NC_PUT_VARA;
     int return_code;
 
-    MPI_Offset *pnc_start = NULL, *pnc_count = NULL;
+    _recv_client_io(
+	    client_id, func_code, client_nc_id, 0, client_var_id, &io_info);
+
+    _map_waiting_var(client_nc_id, client_var_id, ndims, start, count, 
+	    data_type);
+    client_index = cfio_map_get_client_index_of_server(client_id);
+    cfio_types_size(ele_size, data_type);
+    if(_is_in_place(client_nc_id, client_var_id, ndims, start, count, 
+		data_type, &var))
+    {
+	/* the data is copied from the recv buffer into its place at once, so
+	 * its recv space is reused and no copy is kept for the merge */
+	if((return_code = _assemble_chunk(var, ele_size, start, count, data))
+		< 0)
+	{
+	    goto RETURN;
+	}
+    }else
+    {
+	if(CFIO_ID_HASH_GET_NULL != cfio_id_get_var(client_nc_id, 
+		    client_var_id, &var) && data_type != var->data_type)
+	{
+	    error("put var(%d) of nc(%d) with type(%d), defined as type(%d)",
+		    client_var_id, client_nc_id, data_type, var->data_type);
+	    return_code = CFIO_ERROR_PUT_VAR;
+	    goto RETURN;
+	}
+	if((return_code = _keep_data(client_nc_id, ele_size * data_len, 
+			data, &_data)) < 0)
+	{
+	    goto RETURN;
+	}
+	if(CFIO_ID_HASH_GET_NULL == cfio_id_put_var(
+		    client_nc_id, client_var_id, client_index, 
+		    start, count, _data))
+	{
+	    cfio_id_free_data(_data);
+	    return_code = CFIO_ERROR_INVALID_VAR;
+	    debug(DEBUG_IO, "Invalid var.");
+	    goto RETURN;
+	}
+	start = count = NULL;
+    }
+
+    if(_bitmap_full(io_info->client_bitmap))
+    {
+        debug(DEBUG_IO, "bit map full");
+
+	if((return_code = _get_put_var(client_nc_id, client_var_id, ndims,
+			&nc, &var)) < 0)
+	{
+	    goto RETURN;
+	}
+	if((return_code = _write_var(nc, var)) < 0)
+	{
+	    goto RETURN;
+	}
+        _remove_client_io(io_info);
+    }
+
+    return_code = CFIO_ERROR_NONE;	
+
+RETURN :
+    if(start != NULL)
+    {
+	free(start);
+	start = NULL;
+    }
+    if(count != NULL)
+    {
+	free(count);
+	count = NULL;
+    }
+    return return_code;
+}
+
+int cfio_io_put_vara(cfio_msg_t *msg)
+{
+    int i,ret = 0, ndims;
+    int client_nc_id, client_var_id;
+    size_t *start, *count;
+    char *data;
+    int data_len, data_type;
 
     //double start_time, end_time;
 
@@ -1107,170 +2619,193 @@ int cfio_io_put_vara(cfio_msg_t *msg)
 	free(count);
 	count = NULL;
     }
-    if(data != NULL)
+    return CFIO_ERROR_NONE;
+#endif
+
+    return _put_vara(msg->src, client_nc_id, client_var_id, ndims, 
+	    start, count, data_len, data_type, data);
+}
+
+int cfio_io_put_vara_batch(cfio_msg_t *msg)
+{
+    int i, ret, ndims, rec_num;
+    int client_nc_id, client_var_id;
+    size_t *start, *count;
+    char *data;
+    int data_len, data_type;
+    int return_code = CFIO_ERROR_NONE;
+
+    if((ret = cfio_recv_unpack_put_vara_batch(msg, &client_nc_id, &rec_num))
+	    < 0)
     {
-	free(data);
-	data = NULL;
+	error("");
+	return CFIO_ERROR_MSG_UNPACK;
     }
-    return CFIO_ERROR_NONE;
+
+    /* the records are independent puts, one failed does not stop the others*/
+    for(i = 0; i < rec_num; i ++)
+    {
+	if((ret = cfio_recv_unpack_put_vara_rec(msg, &client_var_id, &ndims, 
+			&start, &count, &data_len, &data_type, &data)) < 0)
+	{
+	    error("");
+	    return CFIO_ERROR_MSG_UNPACK;
+	}
+	debug(DEBUG_IO, "record %d: client_var_id = %d", i, client_var_id);
+
+#if defined(SVR_UNPACK_ONLY) || defined(SVR_META_ONLY)
+	free(start);
+	free(count);
+	continue;
 #endif
 
-    _recv_client_io(
-	    client_id, func_code, client_nc_id, 0, client_var_id, &io_info);
+	if((ret = _put_vara(msg->src, client_nc_id, client_var_id, ndims, 
+			start, count, data_len, data_type, data)) < 0)
+	{
+	    return_code = ret;
+	}
+    }
 
-    client_index = cfio_map_get_client_index_of_server(client_id);
-    //TODO  check whether data_type is right
-    if(CFIO_ID_HASH_GET_NULL == cfio_id_put_var(
-		client_nc_id, client_var_id, client_index, 
-		start, count, (char*)data))
+    return return_code;
+}
+
+int cfio_io_put_vara_chunk(cfio_msg_t *msg)
+{
+    int i, ret = 0, ndims;
+    cfio_id_nc_t *nc;
+    cfio_id_var_t *var;
+    cfio_id_chunk_t *chunk;
+    cfio_io_val_t *io_info;
+    int client_nc_id, client_var_id;
+    size_t *start = NULL, *count = NULL;
+    size_t total_len, ele_size;
+    char *data;
+    int data_len, data_type, client_index;
+    int client_id = msg->src;
+
+    /* share the bitmap with put_vara, a client may put in one msg while 
+     * another client put in chunks */
+    int func_code = FUNC_NC_PUT_VARA;
+    int return_code;
+
+    ret = cfio_recv_unpack_put_vara_chunk(msg, 
+	    &client_nc_id, &client_var_id, &ndims, &start, &count,
+	    &total_len, &data_len, &data_type, &data);	
+    if( ret < 0 )
+    {
+	error("");
+	return CFIO_ERROR_MSG_UNPACK;
+    }
+
+#if defined(SVR_UNPACK_ONLY) || defined(SVR_META_ONLY)
+    free(start);
+    free(count);
+    return CFIO_ERROR_NONE;
+#endif
+
+    if(CFIO_ID_HASH_GET_NULL == cfio_id_get_nc(client_nc_id, &nc))
+    {
+	return_code = CFIO_ERROR_INVALID_NC;
+	debug(DEBUG_IO, "Invalid nc.");
+	goto RETURN;
+    }
+    _map_waiting_var(client_nc_id, client_var_id, ndims, start, count, 
+	    data_type);
+    if(CFIO_ID_HASH_GET_NULL == 
+	    cfio_id_get_var(client_nc_id, client_var_id, &var))
     {
 	return_code = CFIO_ERROR_INVALID_VAR;
 	debug(DEBUG_IO, "Invalid var.");
 	goto RETURN;
     }
-
-    if(_bitmap_full(io_info->client_bitmap))
+    if(ndims != var->ndims)
     {
-        debug(DEBUG_IO, "bit map full");
+	return_code = CFIO_ERROR_WRONG_NDIMS;
+	debug(DEBUG_IO, "wrong ndims(%s), ndims(%d), var->ndims(%d)", 
+		var->name, ndims, var->ndims);
+	goto RETURN;
+    }
+    if(data_type != var->data_type)
+    {
+	error("put var(%d) of nc(%d) with type(%d), defined as type(%d)",
+		client_var_id, client_nc_id, data_type, var->data_type);
+	return_code = CFIO_ERROR_PUT_VAR;
+	goto RETURN;
+    }
+    cfio_types_size(ele_size, var->data_type);
 
-        if(CFIO_ID_HASH_GET_NULL == cfio_id_get_nc(client_nc_id, &nc) ||
-        	CFIO_ID_NC_INVALID == nc->nc_id)
-        {
-            return_code = CFIO_ERROR_INVALID_NC;
-            debug(DEBUG_IO, "Invalid nc.");
-            goto RETURN;
-        }
-        if(CFIO_ID_HASH_GET_NULL == 
-        	cfio_id_get_var(client_nc_id, client_var_id, &var) ||
-        	CFIO_ID_VAR_INVALID == var->var_id)
-        {
-            return_code = CFIO_ERROR_INVALID_VAR;
-            debug(DEBUG_IO, "Invalid var.");
-            goto RETURN;
-        }
-
-        if(ndims != var->ndims)
-        {
-            debug(DEBUG_IO, "wrong ndims(%s), ndims(%d), var->ndims(%d)", 
-		    var->name, ndims, var->ndims);
-            return_code = CFIO_ERROR_WRONG_NDIMS;
-            goto RETURN;
-        }
-
-	total_start = malloc(sizeof(size_t) * var->ndims);
-	total_count = malloc(sizeof(size_t) * var->ndims);
-        _merge_var_data(var, total_start, total_count, &total_data);
-	
-	for(i = 0; i < var->ndims; i ++)
+    if(DATA_MODE == nc->nc_status)
+    {
+	if((return_code = _assemble_chunk(var, ele_size, start, count, data)) 
+		< 0)
 	{
-	    debug(DEBUG_IO, "dim %d: start(%lu), count(%lu)", 
-		    i, total_start[i], total_count[i]);
-	//    printf( "server %d: dim %d: start(%lu), count(%lu)\n", 
-	//	    server_id, i, total_start[i], total_count[i]);
+	    goto RETURN;
 	}
-	debug(DEBUG_IO, "nc_id = %d, var_id = %d", nc->nc_id, var->var_id);
-	debug(DEBUG_IO, "first data = %f", ((float *)total_data)[0]);
-	
-	pnc_start = malloc(sizeof(size_t) * var->ndims);
-	pnc_count = malloc(sizeof(size_t) * var->ndims);
-	for(i = 0; i < var->ndims; i ++)
+    }else
+    {
+	/**
+	 * the var's start and count are known only after def_var of all 
+	 * clients, so keep the chunk until enddef
+	 **/
+	chunk = malloc(sizeof(cfio_id_chunk_t));
+	if(NULL == chunk || 
+		NULL == (chunk->buf = malloc(data_len * ele_size)))
 	{
-	    pnc_start[i] = total_start[i];
-	    pnc_count[i] = total_count[i];
+	    error("malloc for chunk fail.");
+	    free(chunk);
+	    return_code = CFIO_ERROR_MALLOC;
+	    goto RETURN;
 	}
-	
-	for(i = 0; i < var->ndims; i ++)
+	memcpy(chunk->buf, data, data_len * ele_size);
+	chunk->start = start;
+	chunk->count = count;
+	start = count = NULL;
+	qlist_add_tail(&(chunk->link), var->chunk_head);
+    }
+
+    client_index = cfio_map_get_client_index_of_server(client_id);
+    var->recv_data[client_index].recv_len += data_len;
+    if(var->recv_data[client_index].recv_len < total_len)
+    {
+	return_code = CFIO_ERROR_NONE;
+	goto RETURN;
+    }
+
+    debug(DEBUG_IO, "all chunks of var(%s) from client(%d) recieved", 
+	    var->name, client_id);
+    var->recv_data[client_index].recv_len = 0;
+    _recv_client_io(
+	    client_id, func_code, client_nc_id, 0, client_var_id, &io_info);
+    if(_bitmap_full(io_info->client_bitmap))
+    {
+        debug(DEBUG_IO, "bit map full");
+
+	if((return_code = _get_put_var(client_nc_id, client_var_id, ndims,
+			&nc, &var)) < 0)
 	{
-	    debug(DEBUG_IO, "dim %d: start(%lu), count(%lu)", 
-		    i, total_start[i], total_count[i]);
-	    debug(DEBUG_IO, "dim %d: start(%lld), count(%lld)", 
-		    i, pnc_start[i], pnc_count[i]);
+	    goto RETURN;
 	}
-
-	switch(var->data_type)
+	if((return_code = _write_var(nc, var)) < 0)
 	{
-	    case CFIO_BYTE :
-		break;
-	    case CFIO_CHAR :
-		break;
-	    case CFIO_SHORT :
-#ifndef SVR_NO_IO
-		ret = ncmpi_put_vara_short_all(nc->nc_id, var->var_id, 
-			pnc_start, pnc_count, (short*)total_data);
-#else
-		ret = NC_NOERR;
-#endif
-		break;
-	    case CFIO_INT :
-#ifndef SVR_NO_IO
-		ret = ncmpi_put_vara_int_all(nc->nc_id, var->var_id, 
-			pnc_start, pnc_count, (int*)total_data);
-#else
-		ret = NC_NOERR;
-#endif
-		break;
-	    case CFIO_FLOAT :
-#ifndef SVR_NO_IO
-		ret = ncmpi_put_vara_float_all(nc->nc_id, var->var_id, 
-			pnc_start, pnc_count, (float*)total_data);
-#else
-		ret = NC_NOERR;
-#endif
-		break;
-	    case CFIO_DOUBLE :
-#ifndef SVR_NO_IO
-		ret = ncmpi_put_vara_double_all(nc->nc_id, var->var_id, 
-			pnc_start, pnc_count, (double*)total_data);
-#else
-		ret = NC_NOERR;
-#endif
-		break;
+	    goto RETURN;
 	}
-	//end_time = times_cur();
-	//write_time += end_time - start_time;
-
-        if( ret != NC_NOERR )
-        {
-            error("write nc(%d) var (%d) failure(%s)",
-        	    nc->nc_id,var->var_id,ncmpi_strerror(ret));
-            return_code = CFIO_ERROR_NC;
-        }
         _remove_client_io(io_info);
     }
 
     return_code = CFIO_ERROR_NONE;	
-    //printf("proc : %d, write_time : %f\n", server_id, write_time);
 
 RETURN :
-
-    if(total_data != NULL)
-    {
-	free(total_data);
-	total_data = NULL;
-    }
-    if(total_count != NULL)
-    {
-	free(total_count);
-	total_count = NULL;
-    }
-    if(total_start != NULL)
-    {
-	free(total_start);
-	total_start = NULL;
-    }
-    if(pnc_count != NULL)
+    if(start != NULL)
     {
-	free(pnc_count);
-	pnc_count = NULL;
+	free(start);
+	start = NULL;
     }
-    if(pnc_start != NULL)
+    if(count != NULL)
     {
-	free(pnc_start);
-	pnc_start = NULL;
+	free(count);
+	count = NULL;
     }
     return return_code;
-
-
 }
 
 int cfio_io_close(cfio_msg_t *msg)
@@ -1306,15 +2841,17 @@ int cfio_io_close(cfio_msg_t *msg)
 	    debug(DEBUG_IO, "Invalid NC.");
 	    return CFIO_ERROR_INVALID_NC;
 	}
-#ifndef SVR_NO_IO
-	ret = ncmpi_close(nc->nc_id);
-#else
-	ret = NC_NOERR;
-#endif
+	/* the writes of the nc may be still in the pipeline */
+	cfio_pipe_drain();
+	if(_is_aggregate() && (ret = _wait_nc(nc)) < 0)
+	{
+	    return ret;
+	}
+	ret = backend->close(nc->nc_id);
 
 	if( ret != NC_NOERR )
 	{
-	    error("close nc(%d) file failure,%s\n",nc->nc_id,ncmpi_strerror(ret));
+	    error("close nc(%d) file failure,%s\n",nc->nc_id,backend->strerror(ret));
 	    return CFIO_ERROR_NC;
 	}
 	_remove_client_io(io_info);
@@ -19,8 +19,14 @@
 #define _IO_H
 
 #include "msg.h"
+#include "id.h"
+#include "pipeline.h"
 
 #define IO_HASH_TABLE_SIZE 32
+/* amount of io requests or write jobs malloced at a time */
+#define IO_SLAB_NUM 256
+/* min size of a block of the scratch of the writes */
+#define IO_SCRATCH_BLOCK_SIZE ((size_t)64*1024)
 
 /* the msg is delt, the buffer could be reused inmmediately */
 #define DEALT_MSG 2
@@ -53,11 +59,37 @@ typedef struct
     //qlist_head_t queue_link;
 }cfio_io_val_t;
 
+/* a nc file created from a template which is not ready, it is created when 
+ * the enddef of the template is done */
+typedef struct
+{
+    int client_nc_id;
+    int template_nc_id;
+    char *path;
+
+    qlist_head_t link;
+}cfio_io_wait_t;
+
 /**
  * @brief: initialize
  *
  * @return: error code
  */
+/* the write of a var's data in the server pipeline, the data is taken from 
+ * the var when all clients' data has arrived, so the var can recv its next 
+ * put while this one is assembled and written */
+typedef struct
+{
+    cfio_pipe_job_t job;
+    cfio_id_nc_t *nc;
+    cfio_id_var_t var;	    /* copy of the var, owns the taken data */
+    qlist_head_t chunk_head;/* chunks taken from the var */
+    int varn;		    /* 1 if the blocks are written without merge */
+    size_t *start;	    /* start of the merged data */
+    size_t *count;	    /* count of the merged data */
+    char *data;		    /* the merged data */
+}cfio_io_job_t;
+
 int cfio_io_init();
 /**
  * @brief: finalize
@@ -67,11 +99,24 @@ int cfio_io_init();
 int cfio_io_final();
 int cfio_io_reader_done(int client_id, int *server_done);
 int cfio_io_writer_done(int client_id, int *server_done);
+/**
+ * @brief: a client ends an io step, when all clients of the server end it the
+ *	scratch of the writes in the step is released
+ *
+ * @param msg: the FUNC_IO_END msg
+ *
+ * @return: error code
+ */
+int cfio_io_end_step(cfio_msg_t *msg);
 int cfio_io_create(cfio_msg_t *msg);
+int cfio_io_create_from_template(cfio_msg_t *msg);
 int cfio_io_def_dim(cfio_msg_t *msg);
 int cfio_io_def_var(cfio_msg_t *msg);
+int cfio_io_def_var_decomp(cfio_msg_t *msg);
 int cfio_io_enddef(cfio_msg_t *msg);
 int cfio_io_put_vara(cfio_msg_t *msg);
+int cfio_io_put_vara_chunk(cfio_msg_t *msg);
+int cfio_io_put_vara_batch(cfio_msg_t *msg);
 int cfio_io_close(cfio_msg_t *msg);
 
 #endif
@@ -0,0 +1,341 @@
+/****************************************************************************
+ *       Filename:  pipeline.c
+ *
+ *    Description:  stages of the server after decode, the data of a var is
+ *		    assembled by a pool of threads and written by an io thread,
+ *		    while the main thread keeps recving and decoding msgs
+ *
+ *        Version:  1.0
+ *        Created:  10/17/2026 07:52:03 PM
+ *       Revision:  none
+ *       Compiler:  gcc
+ ***************************************************************************/
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <sched.h>
+#include <pthread.h>
+
+#include "mpi.h"
+#include "pipeline.h"
+#include "conf.h"
+#include "debug.h"
+#include "cfio_error.h"
+
+static int started = 0;
+static int stop;
+static int assembler_num;
+static pthread_t *assembler;	/* the assemble threads */
+static cfio_pipe_deque_t *deque;/* tasks of each assemble thread */
+static int next_deque;		/* deque the next task is put into */
+static int task_num;		/* amount of tasks in all deques */
+static pthread_t writer;	/* the io thread */
+/* jobs put but not written, in the order they are put */
+static qlist_head_t job_head;
+static int job_num;
+static int job_max;		/* max of job_num */
+static int job_ret;		/* error code of the first failed job */
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t new_cond = PTHREAD_COND_INITIALIZER;
+				/* a job is put, or stop */
+static pthread_cond_t assembled_cond = PTHREAD_COND_INITIALIZER;
+				/* a job is assembled, or stop */
+static pthread_cond_t written_cond = PTHREAD_COND_INITIALIZER;
+				/* a job is written */
+
+/**
+ * @brief: take a task for an assemble thread, its own oldest task, or the 
+ *	newest task of another thread
+ *
+ * @param index: index of the assemble thread
+ *
+ * @return: the job of the task, NULL if no task is left
+ */
+static inline cfio_pipe_job_t *_take_task(int index)
+{
+    cfio_pipe_deque_t *d;
+    cfio_pipe_job_t *job = NULL;
+    int i;
+
+    for(i = 0; i < assembler_num; i ++)
+    {
+	d = &deque[(index + i) % assembler_num];
+	pthread_mutex_lock(&(d->lock));
+	if(!qlist_empty(&(d->task_head)))
+	{
+	    job = qlist_entry((0 == i) ? d->task_head.next : d->task_head.prev,
+		    cfio_pipe_job_t, task_link);
+	    qlist_del(&(job->task_link));
+	    job->status = PIPE_JOB_ASSEMBLING;
+	}
+	pthread_mutex_unlock(&(d->lock));
+	if(NULL != job)
+	{
+	    __atomic_sub_fetch(&task_num, 1, __ATOMIC_RELAXED);
+	    debug(DEBUG_SERVER, "assemble thread %d %s a task", index, 
+		    0 == i ? "takes" : "steals");
+	    break;
+	}
+    }
+
+    return job;
+}
+
+static void *_assemble_thread(void *argv)
+{
+    int index = (int)(long)argv;
+    cfio_pipe_job_t *job;
+
+    while(1)
+    {
+	if(NULL == (job = _take_task(index)))
+	{
+	    pthread_mutex_lock(&mutex);
+	    while(!stop && 0 == __atomic_load_n(&task_num, __ATOMIC_RELAXED))
+	    {
+		pthread_cond_wait(&new_cond, &mutex);
+	    }
+	    if(stop && 0 == __atomic_load_n(&task_num, __ATOMIC_RELAXED))
+	    {
+		pthread_mutex_unlock(&mutex);
+		break;
+	    }
+	    pthread_mutex_unlock(&mutex);
+	    continue;
+	}
+
+	job->ret = job->assemble(job);
+
+	pthread_mutex_lock(&mutex);
+	job->status = PIPE_JOB_ASSEMBLED;
+	pthread_cond_signal(&assembled_cond);
+	pthread_mutex_unlock(&mutex);
+    }
+
+    return ((void *)0);
+}
+
+/**
+ * @brief: get the amount of cores the server can run on
+ *
+ * @return: amount of cores
+ */
+static int _core_num()
+{
+    cpu_set_t cpuset;
+
+    if(0 != sched_getaffinity(0, sizeof(cpu_set_t), &cpuset))
+    {
+	return 1;
+    }
+
+    return CPU_COUNT(&cpuset);
+}
+
+static void *_io_thread(void *argv)
+{
+    cfio_pipe_job_t *job;
+    int ret;
+
+    pthread_mutex_lock(&mutex);
+    while(1)
+    {
+	/* jobs are written in order, so wait for the first one */
+	while(!(stop && qlist_empty(&job_head)) && (qlist_empty(&job_head) ||
+		    PIPE_JOB_ASSEMBLED != qlist_entry(job_head.next,
+			cfio_pipe_job_t, link)->status))
+	{
+	    pthread_cond_wait(&assembled_cond, &mutex);
+	}
+	if(qlist_empty(&job_head))
+	{
+	    break;
+	}
+	job = qlist_entry(job_head.next, cfio_pipe_job_t, link);
+	qlist_del(&(job->link));
+	pthread_mutex_unlock(&mutex);
+
+	ret = job->write(job);
+
+	pthread_mutex_lock(&mutex);
+	if(ret < 0 && CFIO_ERROR_NONE == job_ret)
+	{
+	    job_ret = ret;
+	}
+	job_num --;
+	pthread_cond_broadcast(&written_cond);
+    }
+    pthread_mutex_unlock(&mutex);
+
+    return ((void *)0);
+}
+
+int cfio_pipe_init()
+{
+    int i, provided;
+
+    INIT_QLIST_HEAD(&job_head);
+    job_num = 0;
+    job_ret = CFIO_ERROR_NONE;
+    stop = 0;
+    started = 0;
+
+    assembler_num = cfio_conf_get_assemble_thread();
+    if(0 == assembler_num)
+    {
+	return CFIO_ERROR_NONE;
+    }
+    /* leave a core to the recv and to the io */
+    if(assembler_num < 0)
+    {
+	assembler_num = _core_num() - 2;
+	assembler_num = assembler_num < 1 ? 1 : assembler_num;
+    }
+    /* the io thread calls MPI in the nc functions while the main thread
+     * recvs msgs */
+    MPI_Query_thread(&provided);
+    if(provided < MPI_THREAD_MULTIPLE)
+    {
+	debug(DEBUG_SERVER, "MPI_THREAD_MULTIPLE is not provided, server "
+		"runs in one thread.");
+	return CFIO_ERROR_NONE;
+    }
+
+    assembler = malloc(assembler_num * sizeof(pthread_t));
+    deque = malloc(assembler_num * sizeof(cfio_pipe_deque_t));
+    if(NULL == assembler || NULL == deque)
+    {
+	error("malloc fail.");
+	return CFIO_ERROR_MALLOC;
+    }
+    for(i = 0; i < assembler_num; i ++)
+    {
+	pthread_mutex_init(&(deque[i].lock), NULL);
+	INIT_QLIST_HEAD(&(deque[i].task_head));
+    }
+    next_deque = 0;
+    task_num = 0;
+    /* enough jobs to keep every thread busy */
+    job_max = PIPE_QUEUE_LEN > 4 * assembler_num ? 
+	PIPE_QUEUE_LEN : 4 * assembler_num;
+    for(i = 0; i < assembler_num; i ++)
+    {
+	if(pthread_create(&assembler[i], NULL, _assemble_thread, 
+		    (void *)(long)i) != 0)
+	{
+	    error("Thread Assembler create error()");
+	    return CFIO_ERROR_PTHREAD_CREATE;
+	}
+    }
+    if(pthread_create(&writer, NULL, _io_thread, NULL) != 0)
+    {
+	error("Thread Writer create error()");
+	return CFIO_ERROR_PTHREAD_CREATE;
+    }
+    started = 1;
+
+    debug(DEBUG_SERVER, "%d assemble threads started", assembler_num);
+    return CFIO_ERROR_NONE;
+}
+
+int cfio_pipe_final()
+{
+    int i, ret;
+
+    if(!started)
+    {
+	return CFIO_ERROR_NONE;
+    }
+
+    ret = cfio_pipe_drain();
+
+    pthread_mutex_lock(&mutex);
+    stop = 1;
+    pthread_cond_broadcast(&new_cond);
+    pthread_cond_broadcast(&assembled_cond);
+    pthread_mutex_unlock(&mutex);
+
+    for(i = 0; i < assembler_num; i ++)
+    {
+	pthread_join(assembler[i], NULL);
+    }
+    pthread_join(writer, NULL);
+    for(i = 0; i < assembler_num; i ++)
+    {
+	pthread_mutex_destroy(&(deque[i].lock));
+    }
+    free(deque);
+    deque = NULL;
+    free(assembler);
+    assembler = NULL;
+    started = 0;
+
+    return ret;
+}
+
+int cfio_pipe_put(cfio_pipe_job_t *job)
+{
+    cfio_pipe_deque_t *d;
+    int ret;
+
+    if(!started)
+    {
+	job->ret = CFIO_ERROR_NONE;
+	if(NULL != job->assemble)
+	{
+	    job->ret = job->assemble(job);
+	}
+	job->status = PIPE_JOB_ASSEMBLED;
+	return job->write(job);
+    }
+
+    pthread_mutex_lock(&mutex);
+    while(job_num >= job_max)
+    {
+	pthread_cond_wait(&written_cond, &mutex);
+    }
+    job->ret = CFIO_ERROR_NONE;
+    if(NULL == job->assemble)
+    {
+	job->status = PIPE_JOB_ASSEMBLED;
+	pthread_cond_signal(&assembled_cond);
+    }else
+    {
+	/* tasks are spread over the threads, an idle thread steals */
+	job->status = PIPE_JOB_NEW;
+	d = &deque[next_deque];
+	next_deque = (next_deque + 1) % assembler_num;
+	pthread_mutex_lock(&(d->lock));
+	qlist_add_tail(&(job->task_link), &(d->task_head));
+	pthread_mutex_unlock(&(d->lock));
+	__atomic_add_fetch(&task_num, 1, __ATOMIC_RELAXED);
+	pthread_cond_signal(&new_cond);
+    }
+    qlist_add_tail(&(job->link), &job_head);
+    job_num ++;
+    ret = job_ret;
+    job_ret = CFIO_ERROR_NONE;
+    pthread_mutex_unlock(&mutex);
+
+    return ret;
+}
+
+int cfio_pipe_drain()
+{
+    int ret;
+
+    if(!started)
+    {
+	return CFIO_ERROR_NONE;
+    }
+
+    pthread_mutex_lock(&mutex);
+    while(job_num > 0)
+    {
+	pthread_cond_wait(&written_cond, &mutex);
+    }
+    ret = job_ret;
+    job_ret = CFIO_ERROR_NONE;
+    pthread_mutex_unlock(&mutex);
+
+    return ret;
+}
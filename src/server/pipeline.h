@@ -0,0 +1,92 @@
+/****************************************************************************
+ *       Filename:  pipeline.h
+ *
+ *    Description:  stages of the server after decode, the data of a var is
+ *		    assembled by a pool of threads and written by an io thread,
+ *		    while the main thread keeps recving and decoding msgs
+ *
+ *        Version:  1.0
+ *        Created:  10/17/2026 07:40:26 PM
+ *       Revision:  none
+ *       Compiler:  gcc
+ ***************************************************************************/
+#ifndef _PIPELINE_H
+#define _PIPELINE_H
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "quicklist.h"
+
+/* min of the max amount of jobs put but not written, the max is raised to 
+ * keep all assemble threads busy. the decode waits when it is reached, so 
+ * the recv pool fills and the clients are held back */
+#define PIPE_QUEUE_LEN 16
+
+#define PIPE_JOB_NEW	    0	/* waiting for an assemble thread */
+#define PIPE_JOB_ASSEMBLING 1
+#define PIPE_JOB_ASSEMBLED  2	/* waiting for the io thread */
+
+/**
+ * tasks of an assemble thread, the thread takes its oldest task first, and
+ * steals the newest task of another thread when it has none
+ **/
+typedef struct
+{
+    pthread_mutex_t lock;
+    qlist_head_t task_head;
+}cfio_pipe_deque_t;
+
+/**
+ * a job of the pipeline, it is usually the first member of a larger struct
+ * which holds the data. jobs are assembled in any order but written in the
+ * order they are put, so the collective writes are called in the same order
+ * in all servers
+ **/
+typedef struct cfio_pipe_job
+{
+    int (*assemble)(struct cfio_pipe_job *job);
+			/* called in an assemble thread, can be NULL */
+    int (*write)(struct cfio_pipe_job *job);
+			/* called in the io thread, must free the job */
+    int status;		/* PIPE_JOB_NEW, PIPE_JOB_ASSEMBLING or
+			   PIPE_JOB_ASSEMBLED */
+    int ret;		/* error code of assemble */
+    qlist_head_t link;	/* link in the jobs to write */
+    qlist_head_t task_link;
+			/* link in the tasks of an assemble thread */
+}cfio_pipe_job_t;
+
+/**
+ * @brief: start the assemble threads and the io thread, if configured and
+ *	MPI_THREAD_MULTIPLE is provided. with a negative amount configured, an
+ *	assemble thread is started for each core the server can run on, except
+ *	the cores for recv and io
+ *
+ * @return: error code
+ */
+int cfio_pipe_init();
+/**
+ * @brief: write all jobs put and stop the threads
+ *
+ * @return: error code
+ */
+int cfio_pipe_final();
+/**
+ * @brief: put a job at the tail of the pipeline, wait if the pipeline is
+ *	full. if no thread is started the job is assembled and written at once
+ *
+ * @param job: the job
+ *
+ * @return: error code of the job if it is written at once, else error code of
+ *	a job written before
+ */
+int cfio_pipe_put(cfio_pipe_job_t *job);
+/**
+ * @brief: wait until all jobs put are written, it must be called before
+ *	any nc function is called out of the pipeline
+ *
+ * @return: error code of the first failed job since last drain
+ */
+int cfio_pipe_drain();
+
+#endif
@@ -14,6 +14,7 @@
  ***************************************************************************/
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <assert.h>
 
 #include "msg.h"
@@ -27,54 +28,651 @@
 #include "cfio_types.h"
 #include "cfio_error.h"
 #include "define.h"
+#include "shm.h"
+#include "rma.h"
+#include "mem.h"
 
+/* msgs received from all clients, kept in arrival order */
 static cfio_msg_t *msg_head;
-//use two buffer swap, in client :writer for pack, reader for send
+/* buffer of each client, the clients who send msgs by MPI or are pulled share
+ * the pool, the ring of a client using shared memory is read in place */
 static cfio_buf_t **buffer;
-static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
-static pthread_cond_t empty_cond = PTHREAD_COND_INITIALIZER;
-static pthread_mutex_t empty_mutex = PTHREAD_MUTEX_INITIALIZER;
-static pthread_cond_t full_cond = PTHREAD_COND_INITIALIZER;
-static pthread_mutex_t full_mutex = PTHREAD_MUTEX_INITIALIZER;
+static cfio_buf_t *pool = NULL;	/* recv pool shared by the clients */
+static int pool_client_num;	/* amount of clients whose msgs are in the pool */
+static size_t *pool_used;	/* pool space taken by the msgs of each client */
 static int rank;
 static int client_num;
-/* index used when call cfio_recv_get_first */
-static int client_get_index = 0;
 static int max_msg_size;
+static MPI_Comm comm;
+static int *client_id;		/* client id of each client index */
+static int *client_done;	/* 1 if FUNC_FINAL has arrived from the client */
+static MPI_Message *matched;	/* probed msg of each client not recved yet */
+static size_t *pending_size;	/* size of the msg of each client which waits 
+				   for pool space, 0 if none */
+static cfio_shm_t **shm;	/* shared memory of each client, NULL if the 
+				   client sends msgs by MPI */
+static int *rma;		/* 1 if the server pulls the msgs of the client */
+static size_t (*rma_desc)[RMA_DESC_LEN];
+				/* place of the msg to pull of each client */
+static int last_index = -1;	/* client index of the last msg got */
+static char *last_end;		/* end of the last msg got */
+static size_t last_size;	/* size of the last msg got */
+static int last_held;		/* 1 if the last msg got is kept */
+/* msgs kept after decode in the ring of each client, and in the pool at 
+ * client_num, oldest first */
+static qlist_head_t *hold_head;
+static char **decoded_end;	/* end of the msgs decoded in each ring, and in
+				   the pool at client_num */
+static int released;		/* 1 if a kept msg is released since the space 
+				   is given back */
+static pthread_mutex_t hold_mutex = PTHREAD_MUTEX_INITIALIZER;
+static cfio_mem_slab_t hold_slab = 
+    CFIO_MEM_SLAB_INITIALIZER(sizeof(cfio_recv_hold_t), RECV_HOLD_SLAB_NUM);
 size_t total_size = 0, min_size = 0, max_size = 0;
 
+/**
+ * @brief: put a msg which has arrived at the free_addr of a client's buffer 
+ *	at the tail of the msg queue
+ *
+ * @param client_index: index of the client in the server
+ * @param size: size of the msg
+ *
+ * @return: error code
+ */
+static inline int _msg_arrive(int client_index, size_t size)
+{
+    cfio_msg_t *msg;
+
+    msg = cfio_msg_create();
+    if(NULL == msg)
+    {
+	return CFIO_ERROR_MALLOC;
+    }
+    msg->addr = buffer[client_index]->free_addr;
+    msg->size = size;
+    msg->src = client_id[client_index];
+    msg->dst = rank;
+    // get the func_code but not unpack it
+    msg->func_code = cfio_msg_peek_func(msg->addr);
+    debug(DEBUG_RECV, "func_code = %u", msg->func_code);
+
+    if(FUNC_FINAL == msg->func_code)
+    {
+	client_done[client_index] = 1;
+    }
+
+#ifdef SVR_RECV_ONLY
+    if(FUNC_FINAL != msg->func_code)
+    {
+	cfio_msg_free(msg);
+	return CFIO_ERROR_NONE;
+    }
+#endif
+
+    use_buf(buffer[client_index], size);
+    if(buffer[client_index] == pool)
+    {
+	pool_used[client_index] += size;
+    }
+    qlist_add_tail(&(msg->link), &(msg_head->link));
+
+    return CFIO_ERROR_NONE;
+}
+
+/**
+ * @brief: check whether a msg of a client can be put into the pool. a client 
+ *	can always use the pool up to its quota, an even share of the pool. 
+ *	beyond the quota it can only use the space which is not kept for the 
+ *	clients still under theirs, so the pool goes to the clients producing 
+ *	data while no client is starved
+ *
+ * @param client_index: index of the client in the server
+ * @param size: size of the msg
+ *
+ * @return: 1 if yes, and the pool's free_addr is where the msg is to be put,
+ *	0 if not
+ */
+static inline int _pool_allow(int client_index, size_t size)
+{
+    size_t quota = pool->size / pool_client_num;
+    size_t reserve = 0;
+    int i;
+
+    if(pool_used[client_index] + size > quota)
+    {
+	for(i = 0; i < client_num; i ++)
+	{
+	    if(i != client_index && buffer[i] == pool && !client_done[i] &&
+		    pool_used[i] + max_msg_size <= quota)
+	    {
+		reserve += max_msg_size;
+	    }
+	}
+	if(free_buf_size(pool) < size + reserve)
+	{
+	    return 0;
+	}
+    }
+
+    return is_free_space_enough(pool, size) == CFIO_BUF_FREE_SPACE_ENOUGH;
+}
+
+/**
+ * @brief: pull the msg whose place has been received from a client into the 
+ *	free space of the pool, and give back its space in the client
+ *
+ * @param client_index: index of the client in the server
+ *
+ * @return: error code
+ */
+static inline int _rma_pull(int client_index)
+{
+    size_t off = rma_desc[client_index][0];
+    size_t size = rma_desc[client_index][1];
+    int ret;
+
+    if((ret = cfio_rma_get(client_id[client_index], off, size, 
+		    pool->free_addr)) < 0)
+    {
+	return ret;
+    }
+    /* msgs are pulled in order, so the space before the end of this one is 
+     * free in the client */
+    cfio_rma_release(client_id[client_index], off + size);
+
+    return CFIO_ERROR_NONE;
+}
+
+/**
+ * @brief: move the free_addr of the pool to a place aligned to CFIO_MSG_ALIGN,
+ *	so the v2 msgs and the data in them are aligned in the pool
+ */
+static inline void _pool_align()
+{
+    size_t pad = (pool->free_addr - pool->start_addr) % CFIO_MSG_ALIGN;
+
+    pad = (0 == pad) ? 0 : CFIO_MSG_ALIGN - pad;
+    if(pad > 0 && free_buf_size(pool) > pad)
+    {
+	use_buf(pool, pad);
+    }
+}
+
+/**
+ * @brief: get the size of the msg probed from a client, the msg waits in 
+ *	matched until the pool has room for it
+ *
+ * @param client_index: index of the client in the server
+ * @param status: status of the probe
+ */
+static inline void _pool_matched(int client_index, MPI_Status *status)
+{
+    int count;
+
+    /* only the place of the msg is sent, the msg is pulled when the pool has 
+     * room for it */
+    if(rma[client_index])
+    {
+	MPI_Mrecv(rma_desc[client_index], sizeof(rma_desc[0]), MPI_BYTE,
+		&matched[client_index], status);
+	pending_size[client_index] = rma_desc[client_index][1];
+    }else
+    {
+	MPI_Get_count(status, MPI_BYTE, &count);
+	pending_size[client_index] = count;
+    }
+}
+
+/**
+ * @brief: block in MPI until a client sends a msg, only when every client 
+ *	sends its msgs by MPI and none waits for pool space, else a msg in 
+ *	shared memory or space freed by decode would not wake the server
+ *
+ * @return: 1 if a msg is probed, 0 if the server can not block in MPI, or 
+ *	error code
+ */
+static inline int _pool_wait()
+{
+    MPI_Message message;
+    MPI_Status status;
+    int i;
+
+    if(pool_client_num < client_num)
+    {
+	return 0;
+    }
+    for(i = 0; i < client_num; i ++)
+    {
+	if(!client_done[i] && 0 != pending_size[i])
+	{
+	    return 0;
+	}
+    }
+
+    MPI_Mprobe(MPI_ANY_SOURCE, MPI_ANY_TAG, comm, &message, &status);
+    for(i = 0; i < client_num; i ++)
+    {
+	if(client_id[i] == status.MPI_SOURCE)
+	{
+	    break;
+	}
+    }
+    if(i == client_num || client_done[i])
+    {
+	error("server %d probed msg from proc %d which is not its client", 
+		rank, status.MPI_SOURCE);
+	return CFIO_ERROR_UNEXPECTED_MSG;
+    }
+    matched[i] = message;
+    _pool_matched(i, &status);
+
+    return 1;
+}
+
+/**
+ * @brief: recv the msgs a client has sent into the pool, each msg is probed 
+ *	first and recved with its exact size. a msg which the pool has no room 
+ *	for is left in MPI until decode frees some space
+ *
+ * @param client_index: index of the client in the server
+ *
+ * @return: amount of arrived msgs, or error code
+ */
+static inline int _pool_arrive(int client_index)
+{
+    int id = client_id[client_index];
+    MPI_Status status;
+    size_t size;
+    int flag, ret, num = 0;
+
+    while(!client_done[client_index])
+    {
+	if(0 == pending_size[client_index])
+	{
+	    MPI_Improbe(id, id, comm, &flag, &matched[client_index], &status);
+	    if(!flag)
+	    {
+		break;
+	    }
+	    _pool_matched(client_index, &status);
+	}
+
+	size = pending_size[client_index];
+	_pool_align();
+	if(!_pool_allow(client_index, size))
+	{
+	    debug(DEBUG_RECV, "pool is full for client(%d)", id);
+	    break;
+	}
+
+	if(rma[client_index])
+	{
+	    ret = _rma_pull(client_index);
+	}else if(MPI_SUCCESS != MPI_Mrecv(pool->free_addr, size, MPI_BYTE,
+		    &matched[client_index], &status))
+	{
+	    ret = CFIO_ERROR_MPI_RECV;
+	}else
+	{
+	    ret = CFIO_ERROR_NONE;
+	}
+	if(ret < 0)
+	{
+	    return ret;
+	}
+	debug(DEBUG_RECV, "recv: size = %lu", size);
+	pending_size[client_index] = 0;
+
+	if((ret = _msg_arrive(client_index, size)) < 0)
+	{
+	    return ret;
+	}
+	num ++;
+    }
+
+    return num;
+}
+
+/**
+ * @brief: get the msgs a client put into the queue of shared memory, the msgs
+ *	are decoded in the ring of the client without copy
+ *
+ * @param client_index: index of the client in the server
+ *
+ * @return: amount of arrived msgs, or error code
+ */
+static inline int _shm_arrive(int client_index)
+{
+    cfio_buf_t *buf = buffer[client_index];
+    cfio_msg_t *msg;
+    size_t off, size;
+    int num = 0;
+
+    while(cfio_shm_get(shm[client_index], &off, &size))
+    {
+	msg = cfio_msg_create();
+	if(NULL == msg)
+	{
+	    return CFIO_ERROR_MALLOC;
+	}
+	msg->addr = buf->start_addr + off;
+	msg->size = size;
+	msg->src = client_id[client_index];
+	msg->dst = rank;
+	msg->func_code = cfio_msg_peek_func(msg->addr);
+	debug(DEBUG_RECV, "shm: size = %lu, func_code = %u", size, 
+		msg->func_code);
+	num ++;
+
+	/* the client may skip the tail of the ring, so free_addr follows the 
+	 * msgs instead of the sizes */
+	buf->free_addr = msg->addr;
+	use_buf(buf, size);
+
+	if(FUNC_FINAL == msg->func_code)
+	{
+	    client_done[client_index] = 1;
+	}
+#ifdef SVR_RECV_ONLY
+	if(FUNC_FINAL != msg->func_code)
+	{
+	    cfio_shm_release(shm[client_index], 
+		    (msg->addr + size - buf->start_addr) % buf->size);
+	    cfio_msg_free(msg);
+	    continue;
+	}
+#endif
+	qlist_add_tail(&(msg->link), &(msg_head->link));
+    }
+
+    return num;
+}
+
+/**
+ * @brief: get the index of the ring which a client's msgs are put in, the 
+ *	pool is at client_num
+ *
+ * @param client_index: index of the client in the server
+ *
+ * @return: index of the ring
+ */
+static inline int _ring_index(int client_index)
+{
+    return buffer[client_index] == pool ? client_num : client_index;
+}
+
+/**
+ * @brief: give back the space of a ring before its oldest kept msg, or before 
+ *	the end of the msgs decoded if no msg is kept, to the client if the 
+ *	ring is in shared memory, or to the pool
+ *
+ * @param ring: index of the ring
+ */
+static void _give_back(int ring)
+{
+    cfio_recv_hold_t *hold;
+    cfio_buf_t *buf;
+    char *end;
+
+    pthread_mutex_lock(&hold_mutex);
+    while(!qlist_empty(&hold_head[ring]))
+    {
+	hold = qlist_entry(hold_head[ring].next, cfio_recv_hold_t, link);
+	if(hold->ref > 0)
+	{
+	    break;
+	}
+	qlist_del(&(hold->link));
+	if(client_num == ring)
+	{
+	    pool_used[hold->client_index] -= hold->size;
+	}
+	cfio_mem_slab_free(&hold_slab, hold);
+    }
+    if(qlist_empty(&hold_head[ring]))
+    {
+	end = decoded_end[ring];
+    }else
+    {
+	end = qlist_entry(hold_head[ring].next, cfio_recv_hold_t, link)->addr;
+    }
+    pthread_mutex_unlock(&hold_mutex);
+
+    if(NULL == end)
+    {
+	return;
+    }
+    if(client_num == ring)
+    {
+	pool->used_addr = end;
+    }else
+    {
+	buf = buffer[ring];
+	cfio_shm_release(shm[ring], (end - buf->start_addr) % buf->size);
+    }
+}
+
+/**
+ * @brief: give back the space of the rings in which a kept msg is released
+ */
+static inline void _give_back_released()
+{
+    int i;
+
+    if(!__atomic_exchange_n(&released, 0, __ATOMIC_ACQ_REL))
+    {
+	return;
+    }
+    for(i = 0; i < client_num; i ++)
+    {
+	if(NULL != shm[i])
+	{
+	    _give_back(i);
+	}
+    }
+    if(NULL != pool)
+    {
+	_give_back(client_num);
+    }
+}
+
+/**
+ * @brief: give back the space of the last msg got, to its client if the client
+ *	uses shared memory, or to the client's pool quota, unless it is kept. 
+ *	msgs are decoded one by one, so the last msg is decoded when the next is
+ *	got or when recvs are progressed
+ */
+static inline void _release_last()
+{
+    int ring;
+
+    if(last_index >= 0)
+    {
+	ring = _ring_index(last_index);
+	decoded_end[ring] = last_end;
+	/* the quota of a kept msg is given back when it is released */
+	if(!last_held && buffer[last_index] == pool)
+	{
+	    pool_used[last_index] -= last_size;
+	}
+	_give_back(ring);
+    }
+    last_index = -1;
+    last_held = 0;
+    _give_back_released();
+}
+
+int cfio_recv_hold_last()
+{
+    cfio_recv_hold_t *hold;
+    int ring;
+
+    assert(last_index >= 0);
+
+    ring = _ring_index(last_index);
+    pthread_mutex_lock(&hold_mutex);
+    if(last_held)
+    {
+	hold = qlist_entry(hold_head[ring].prev, cfio_recv_hold_t, link);
+	hold->ref ++;
+	pthread_mutex_unlock(&hold_mutex);
+	return CFIO_ERROR_NONE;
+    }
+    pthread_mutex_unlock(&hold_mutex);
+
+    hold = cfio_mem_slab_alloc(&hold_slab);
+    if(NULL == hold)
+    {
+	error("malloc for hold fail.");
+	return CFIO_ERROR_MALLOC;
+    }
+    hold->client_index = last_index;
+    hold->addr = last_end - last_size;
+    hold->size = last_size;
+    hold->ref = 1;
+    pthread_mutex_lock(&hold_mutex);
+    qlist_add_tail(&(hold->link), &hold_head[ring]);
+    pthread_mutex_unlock(&hold_mutex);
+    last_held = 1;
+
+    return CFIO_ERROR_NONE;
+}
+
+void cfio_recv_free_data(void *data)
+{
+    cfio_recv_hold_t *hold;
+    char *addr = data;
+    int i, ring = -1;
+
+    if(NULL == data)
+    {
+	return;
+    }
+
+    if(NULL != pool && addr >= pool->start_addr && 
+	    addr < pool->start_addr + pool->size)
+    {
+	ring = client_num;
+    }
+    for(i = 0; i < client_num && ring < 0; i ++)
+    {
+	if(NULL != shm[i] && addr >= buffer[i]->start_addr &&
+		addr < buffer[i]->start_addr + buffer[i]->size)
+	{
+	    ring = i;
+	}
+    }
+    if(ring < 0)
+    {
+	free(data);
+	return;
+    }
+
+    pthread_mutex_lock(&hold_mutex);
+    qlist_for_each_entry(hold, &hold_head[ring], link)
+    {
+	if(addr >= hold->addr && addr < hold->addr + hold->size)
+	{
+	    hold->ref --;
+	    break;
+	}
+    }
+    pthread_mutex_unlock(&hold_mutex);
+    /* the space is given back by the main thread */
+    __atomic_store_n(&released, 1, __ATOMIC_RELEASE);
+}
+
 int cfio_recv_init()
 {
     int i, error;
 
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    comm = cfio_map_get_comm();
+    /* the msgs are freed by the assemble and io threads */
+    cfio_msg_init(1);
 
     client_num = cfio_map_get_client_num_of_server(rank);
 
-    msg_head = malloc(client_num * sizeof(cfio_msg_t));
+    msg_head = malloc(sizeof(cfio_msg_t));
     if(NULL == msg_head)
     {
 	return CFIO_ERROR_MALLOC;
     }
-    for(i = 0; i < client_num; i ++)
+    INIT_QLIST_HEAD(&(msg_head->link));
+
+    client_id = malloc(client_num * sizeof(int));
+    client_done = malloc(client_num * sizeof(int));
+    matched = malloc(client_num * sizeof(MPI_Message));
+    pending_size = malloc(client_num * sizeof(size_t));
+    pool_used = malloc(client_num * sizeof(size_t));
+    hold_head = malloc((client_num + 1) * sizeof(qlist_head_t));
+    decoded_end = malloc((client_num + 1) * sizeof(char *));
+    shm = malloc(client_num * sizeof(cfio_shm_t *));
+    rma = malloc(client_num * sizeof(int));
+    rma_desc = malloc(client_num * sizeof(rma_desc[0]));
+    if(NULL == client_id || NULL == client_done || NULL == matched ||
+	    NULL == pending_size || NULL == pool_used || NULL == shm ||
+	    NULL == rma || NULL == rma_desc || NULL == hold_head || 
+	    NULL == decoded_end)
     {
-	INIT_QLIST_HEAD(&(msg_head[i].link));
+	error("malloc fail.");
+	return CFIO_ERROR_MALLOC;
     }
+    cfio_map_get_clients(rank, client_id);
 
     buffer = malloc(client_num *sizeof(cfio_buf_t*));
     if(NULL == buffer)
     {
 	return CFIO_ERROR_MALLOC;
     }
+    pool_client_num = 0;
     for(i = 0; i < client_num; i ++)
     {
-	buffer[i] = cfio_buf_open(RECV_BUF_SIZE / client_num, &error);
-	if(NULL == buffer[i])
+	/* the ring of a client on the same node is read in place */
+	shm[i] = cfio_shm_get_client(client_id[i]);
+	if(NULL != shm[i])
+	{
+	    buffer[i] = cfio_buf_attach(cfio_shm_ring(shm[i]), 
+		    cfio_shm_get_buf_size(client_id[i]), &error);
+	    if(NULL == buffer[i])
+	    {
+		error("");
+		return error;
+	    }
+	}else
+	{
+	    pool_client_num ++;
+	}
+    }
+    if(pool_client_num > 0)
+    {
+	pool = cfio_buf_open(RECV_BUF_SIZE, &error);
+	if(NULL == pool)
 	{
 	    error("");
 	    return error;
 	}
     }
+    for(i = 0; i < client_num; i ++)
+    {
+	if(NULL == shm[i])
+	{
+	    buffer[i] = pool;
+	}
+	rma[i] = cfio_rma_used(client_id[i]);
+	client_done[i] = 0;
+	matched[i] = MPI_MESSAGE_NULL;
+	pending_size[i] = 0;
+	pool_used[i] = 0;
+    }
+    for(i = 0; i <= client_num; i ++)
+    {
+	INIT_QLIST_HEAD(&hold_head[i]);
+	decoded_end[i] = NULL;
+    }
+    last_index = -1;
+    last_held = 0;
+    released = 0;
 
     max_msg_size = cfio_msg_get_max_size(rank);
 
@@ -84,7 +682,7 @@ int cfio_recv_init()
 int cfio_recv_final()
 {
     cfio_msg_t *msg, *next;
-    MPI_Status status;
+    cfio_recv_hold_t *hold, *next_hold;
     int i = 0;
 
 //    printf("Server %d ; recv size : %f M; max size : %f M; min size : %lu B\n",
@@ -92,129 +690,162 @@ int cfio_recv_final()
 
     if(msg_head != NULL)
     {
+	qlist_for_each_entry_safe(msg, next, &(msg_head->link), link)
+	{
+	    cfio_msg_free(msg);
+	}
 	free(msg_head);
+	msg_head = NULL;
     }
 
     if(buffer != NULL)
     {
 	for(i = 0; i < client_num; i ++)
 	{
-	    cfio_buf_close(buffer[i]);
+	    if(buffer[i] != pool)
+	    {
+		cfio_buf_close(buffer[i]);
+	    }
 	}
 	free(buffer);
+	buffer = NULL;
+    }
+    if(pool != NULL)
+    {
+	cfio_buf_close(pool);
+	pool = NULL;
     }
 
-    return CFIO_ERROR_NONE;
-}
-
-static void cfio_recv_server_buf_free()
-{
-    assert(1 == 2);
-    return;
-}
-
-int cfio_iprobe(
-	int *src, int src_len, MPI_Comm comm, int *flag)
-{
-    int i;
-    MPI_Status status;
-    int _flag;
-
-    for(i = 0; i < src_len; i ++)
+    if(client_id != NULL)
+    {
+	free(client_id);
+	client_id = NULL;
+    }
+    if(client_done != NULL)
+    {
+	free(client_done);
+	client_done = NULL;
+    }
+    if(matched != NULL)
+    {
+	free(matched);
+	free(pending_size);
+	free(pool_used);
+	matched = NULL;
+	pending_size = NULL;
+	pool_used = NULL;
+    }
+    if(shm != NULL)
+    {
+	free(shm);
+	shm = NULL;
+    }
+    if(hold_head != NULL)
     {
-	MPI_Iprobe(src[i], src[i], comm, &_flag, &status);
-	if(_flag == 1)
+	for(i = 0; i <= client_num; i ++)
 	{
-	    *flag = 1;
-	    return CFIO_ERROR_NONE;
+	    qlist_for_each_entry_safe(hold, next_hold, &hold_head[i], link)
+	    {
+		cfio_mem_slab_free(&hold_slab, hold);
+	    }
 	}
+	free(hold_head);
+	free(decoded_end);
+	hold_head = NULL;
+	decoded_end = NULL;
     }
-    *flag = 0;
+    cfio_mem_slab_final(&hold_slab);
+    cfio_msg_final();
+    if(rma != NULL)
+    {
+	free(rma);
+	free(rma_desc);
+	rma = NULL;
+	rma_desc = NULL;
+    }
+
     return CFIO_ERROR_NONE;
 }
 
-int cfio_recv(
-	int src, int rank, MPI_Comm comm, uint32_t *func_code)
+int cfio_recv_progress(int block, int *recv_num)
 {
-    MPI_Status status;
-    int size;
-    cfio_msg_t *msg;
-    int client_index;
+    int i, ret, num, active;
+    int spin = 0;
 
-    client_index = cfio_map_get_client_index_of_server(src);
-    //times_start();
-    debug(DEBUG_RECV, "client_index = %d", client_index);
-    if(is_free_space_enough(buffer[client_index], max_msg_size)
-	    == CFIO_BUF_FREE_SPACE_NOT_ENOUGH)
-    {
-	return CFIO_RECV_BUF_FULL;
-    }
-//    ensure_free_space(buffer[client_index], max_msg_size, 
-//	    cfio_recv_server_buf_free);
+    _release_last();
 
-    MPI_Recv(buffer[client_index]->free_addr, max_msg_size, MPI_BYTE, src,  
-	    MPI_ANY_TAG, comm, &status);
-    MPI_Get_count(&status, MPI_BYTE, &size);
-    debug(DEBUG_RECV, "recv: size = %d", size);
-    //total_size += size;
-    //if(min_size == 0 || min_size > size)
-    //{
-    //    min_size = size;
-    //}
-    //if(max_size == 0 || max_size < size)
-    //{
-    //    max_size = size;
-    //}
-
-    //printf("proc %d , recv: size = %d, from %d\n",rank, size, src);
-    //debug(DEBUG_RECV, "code = %u", *((uint32_t *)buffer->free_addr));
-
-    if(status.MPI_SOURCE != status.MPI_TAG)
+    /* all clients are polled, the msgs which are left in MPI or in shared 
+     * memory for the pool is full arrive after decode frees some space */
+    do
     {
-	return CFIO_ERROR_MPI_RECV;
-    }
+	num = 0;
+	active = 0;
+	for(i = 0; i < client_num; i ++)
+	{
+	    if(client_done[i])
+	    {
+		continue;
+	    }
+	    active = 1;
+	    if(NULL != shm[i])
+	    {
+		ret = _shm_arrive(i);
+	    }else
+	    {
+		ret = _pool_arrive(i);
+	    }
+	    if(ret < 0)
+	    {
+		error("recv from client(%d) error.", client_id[i]);
+		return ret;
+	    }
+	    num += ret;
+	}
 
-    msg = cfio_msg_create();
-    msg->addr = buffer[client_index]->free_addr;
-    msg->size = size;
-    msg->src = status.MPI_SOURCE;
-    msg->dst = rank;
-    // get the func_code but not unpack it
-    msg->func_code = *((uint32_t*)(msg->addr + sizeof(size_t))); 
-    *func_code = msg->func_code;
-    debug(DEBUG_RECV, "func_code = %u", *func_code);
+	if(block && active && 0 == num)
+	{
+	    if((ret = _pool_wait()) < 0)
+	    {
+		return ret;
+	    }
+	    if(0 == ret)
+	    {
+		times_backoff(&spin);
+		/* the pool may be full of kept msgs released by other 
+		 * threads */
+		_give_back_released();
+	    }
+	}
+    }while(block && active && 0 == num);
 
-#ifndef SVR_RECV_ONLY
-    use_buf(buffer[client_index], size);
-#endif
-    
-    /* need lock */
-    if((*func_code) != FUNC_IO_END)
+    if(NULL != recv_num)
     {
-#ifndef SVR_RECV_ONLY
-	qlist_add_tail(&(msg->link), &(msg_head[client_index].link));
-#endif
+	*recv_num = num;
     }
-    
-    //debug(DEBUG_RECV, "uesd_size = %lu", used_buf_size(buffer));
-    debug(DEBUG_RECV, "success return");
-    
+
+    debug(DEBUG_RECV, "success return, %d msg arrived", num);
     return CFIO_ERROR_NONE;
 }
 
+int cfio_recv_msg_empty()
+{
+    return qlist_empty(&(msg_head->link));
+}
+
 cfio_msg_t *cfio_recv_get_first()
 {
     cfio_msg_t *_msg = NULL, *msg;
     qlist_head_t *link;
     size_t size;
 
-    debug(DEBUG_RECV, "client_get_index = %d", client_get_index);
-    if(qlist_empty(&(msg_head[client_get_index].link)))
+    _release_last();
+
+    if(qlist_empty(&(msg_head->link)))
     {
 	link = NULL;
     }else
     {
-	link = msg_head[client_get_index].link.next;
+	link = msg_head->link.next;
     }
 
     if(NULL == link)
@@ -233,16 +864,19 @@ cfio_msg_t *cfio_recv_get_first()
 	    msg->size -= size;
 	    _msg = cfio_msg_create();
 	    _msg->addr = msg->addr;
+	    _msg->size = size;
 	    _msg->src = msg->src;
 	    _msg->dst = msg->dst;
 	    msg->addr += size;
 	}
-	client_get_index = (client_get_index + 1) % client_num;
     }
 
     if(_msg != NULL)
     {
 	debug(DEBUG_RECV, "get msg size : %lu", _msg->size);
+	last_index = cfio_map_get_client_index_of_server(_msg->src);
+	last_end = _msg->addr + _msg->size;
+	last_size = _msg->size;
     }
 
     return _msg;
@@ -284,6 +918,68 @@ int cfio_recv_unpack_func_code(cfio_msg_t *msg, uint32_t *func_code)
     //}
 
     cfio_buf_unpack_data(func_code, sizeof(uint32_t), buffer[client_index]);
+    /* the body of a v2 msg follows its fixed head */
+    if(CFIO_MSG_V2 == cfio_msg_version(*func_code))
+    {
+	buffer[client_index]->used_addr = msg->addr + 
+	    ((cfio_msg_head_t *)msg->addr)->body_off;
+    }
+    *func_code = cfio_msg_func(*func_code);
+
+    return CFIO_ERROR_NONE;
+}
+
+/**
+ * @brief: get the head of a v2 msg
+ *
+ * @param msg: the msg
+ * @param head: pointer to where the head is to be stored
+ *
+ * @return: 1 if the msg is v2, 0 if it is v1
+ */
+static inline int _get_head(cfio_msg_t *msg, cfio_msg_head_t *head)
+{
+    memcpy(head, msg->addr, sizeof(cfio_msg_head_t));
+
+    return CFIO_MSG_V2 == cfio_msg_version(head->code);
+}
+
+/**
+ * @brief: unpack a v2 put_vara or put_vara_chunk from its head, the start and
+ *	count are copied, the data is not
+ *
+ * @return: error code
+ */
+static int _unpack_put_vara_v2(cfio_msg_t *msg, cfio_msg_head_t *head,
+	int *ncid, int *varid, int *ndims, size_t **start, size_t **count, 
+	int *data_len, int *fp_type, char **fp)
+{
+    size_t vec_size = head->ndims * sizeof(size_t);
+    cfio_buf_t *buf = 
+	buffer[cfio_map_get_client_index_of_server(msg->src)];
+
+    *ncid = head->ncid;
+    *varid = head->varid;
+    *ndims = head->ndims;
+    *fp_type = head->type;
+    *data_len = head->data_len;
+
+    *start = malloc(vec_size);
+    *count = malloc(vec_size);
+    if(NULL == *start || NULL == *count)
+    {
+	error("malloc for start and count fail.");
+	free(*start);
+	free(*count);
+	*start = *count = NULL;
+	return CFIO_ERROR_MALLOC;
+    }
+    memcpy(*start, msg->addr + head->body_off, vec_size);
+    memcpy(*count, msg->addr + head->body_off + vec_size, vec_size);
+
+    *fp = msg->addr + head->data_off;
+    buf->used_addr = msg->addr;
+    free_buf(buf, msg->size);
 
     return CFIO_ERROR_NONE;
 }
@@ -305,6 +1001,24 @@ int cfio_recv_unpack_create(
     return CFIO_ERROR_NONE;
 }
 
+int cfio_recv_unpack_create_from_template(
+	cfio_msg_t *msg,
+	char **path, int *ncid, int *template_ncid)
+{
+    int client_index;
+
+    client_index = cfio_map_get_client_index_of_server(msg->src);
+    
+    cfio_buf_unpack_str(path, buffer[client_index]);
+    cfio_buf_unpack_data(ncid, sizeof(int), buffer[client_index]);
+    cfio_buf_unpack_data(template_ncid, sizeof(int), buffer[client_index]);
+
+    debug(DEBUG_RECV, "path = %s; ncid = %d, template_ncid = %d", 
+	    *path, *ncid, *template_ncid);
+
+    return CFIO_ERROR_NONE;
+}
+
 int cfio_recv_unpack_def_dim(
 	cfio_msg_t *msg,
 	int *ncid, char **name, size_t *len, int *dimid)
@@ -348,6 +1062,28 @@ int cfio_recv_unpack_def_var(
 
     return CFIO_ERROR_NONE;
 }
+int cfio_recv_unpack_def_var_decomp(
+	cfio_msg_t *msg,
+	int *ncid, cfio_type *xtype, int *ndims, 
+	size_t **start, size_t **count, int *varid)
+{
+    int client_index;
+
+    client_index = cfio_map_get_client_index_of_server(msg->src);
+    
+    cfio_buf_unpack_data(ncid, sizeof(int), buffer[client_index]);
+    cfio_buf_unpack_data(xtype, sizeof(cfio_type), buffer[client_index]);
+    cfio_buf_unpack_data_array((void **)start, ndims, 
+	    sizeof(size_t), buffer[client_index]);
+    cfio_buf_unpack_data_array((void **)count, ndims, 
+	    sizeof(size_t), buffer[client_index]);
+    cfio_buf_unpack_data(varid, sizeof(int), buffer[client_index]);
+    
+    debug(DEBUG_RECV, "ncid = %d, varid = %d, ndims = %u", 
+	    *ncid, *varid, *ndims);
+
+    return CFIO_ERROR_NONE;
+}
 int cfio_recv_unpack_put_att(
 	cfio_msg_t *msg,
 	int *ncid, int *varid, char **name, 
@@ -393,8 +1129,15 @@ int cfio_recv_unpack_put_vara(
 	size_t **start, size_t **count,
 	int *data_len, int *fp_type, char **fp)
 {
-    int i;
     int client_index;
+    size_t ele_size;
+    cfio_msg_head_t head;
+
+    if(_get_head(msg, &head))
+    {
+	return _unpack_put_vara_v2(msg, &head, ncid, varid, ndims, 
+		start, count, data_len, fp_type, fp);
+    }
 
     client_index = cfio_map_get_client_index_of_server(msg->src);
     
@@ -407,37 +1150,11 @@ int cfio_recv_unpack_put_vara(
     cfio_buf_unpack_data_array((void**)count, ndims, sizeof(size_t),
 	    buffer[client_index]);
 
-//    cfio_buf_unpack_data_array_ptr((void**)fp, data_len, 
-//	    sizeof(float), buffer[client_index]);
-//
+    /* the data is not copied, a msg never wraps in the buffer */
     cfio_buf_unpack_data(fp_type, sizeof(int), buffer[client_index]);
-    switch(*fp_type)
-    {
-	case CFIO_BYTE :
-	    cfio_buf_unpack_data_array((void**)fp, data_len, 1, 
-		    buffer[client_index]);
-	    break;
-	case CFIO_CHAR :
-	    cfio_buf_unpack_data_array((void**)fp, data_len, 1, 
-		    buffer[client_index]);
-	    break;
-	case CFIO_SHORT :
-	    cfio_buf_unpack_data_array((void**)fp, data_len, sizeof(short), 
-		    buffer[client_index]);
-	    break;
-	case CFIO_INT :
-	    cfio_buf_unpack_data_array((void**)fp, data_len, sizeof(int), 
-		    buffer[client_index]);
-	    break;
-	case CFIO_FLOAT :
-	    cfio_buf_unpack_data_array((void**)fp, data_len, sizeof(float), 
-		    buffer[client_index]);
-	    break;
-	case CFIO_DOUBLE :
-	    cfio_buf_unpack_data_array((void**)fp, data_len, sizeof(double), 
-		    buffer[client_index]);
-	    break;
-    }
+    cfio_types_size(ele_size, *fp_type);
+    cfio_buf_unpack_data_array_ptr((void**)fp, data_len, ele_size, 
+	    buffer[client_index]);
 
     debug(DEBUG_RECV, "ncid = %d, varid = %d, ndims = %d, data_len = %u", 
 	    *ncid, *varid, *ndims, *data_len);
@@ -446,6 +1163,110 @@ int cfio_recv_unpack_put_vara(
     return CFIO_ERROR_NONE;
 }
 	
+int cfio_recv_unpack_put_vara_chunk(
+	cfio_msg_t *msg,
+	int *ncid, int *varid, int *ndims, 
+	size_t **start, size_t **count, size_t *total_len,
+	int *data_len, int *fp_type, char **fp)
+{
+    int client_index;
+    size_t ele_size;
+    cfio_buf_t *buf;
+    cfio_msg_head_t head;
+
+    if(_get_head(msg, &head))
+    {
+	*total_len = head.total_len;
+	return _unpack_put_vara_v2(msg, &head, ncid, varid, ndims, 
+		start, count, data_len, fp_type, fp);
+    }
+
+    client_index = cfio_map_get_client_index_of_server(msg->src);
+    buf = buffer[client_index];
+
+    cfio_buf_unpack_data(ncid, sizeof(int), buf);
+    cfio_buf_unpack_data(varid, sizeof(int), buf);
+    cfio_buf_unpack_data_array((void**)start, ndims, sizeof(size_t), buf);
+    cfio_buf_unpack_data_array((void**)count, ndims, sizeof(size_t), buf);
+    cfio_buf_unpack_data(fp_type, sizeof(int), buf);
+    cfio_buf_unpack_data(total_len, sizeof(size_t), buf);
+
+    /* the data is not copied, a msg never wraps in the buffer */
+    cfio_types_size(ele_size, *fp_type);
+    cfio_buf_unpack_data(data_len, sizeof(int), buf);
+    *fp = buf->used_addr;
+    free_buf(buf, (size_t)(*data_len) * ele_size);
+
+    debug(DEBUG_RECV, "ncid = %d, varid = %d, ndims = %d, data_len = %d, "
+	    "total_len = %lu", *ncid, *varid, *ndims, *data_len, *total_len);
+    
+    return CFIO_ERROR_NONE;
+}
+
+int cfio_recv_unpack_put_vara_batch(
+	cfio_msg_t *msg,
+	int *ncid, int *rec_num)
+{
+    cfio_msg_head_t head;
+
+    if(!_get_head(msg, &head))
+    {
+	error("batch msg from client %d is not v2.", msg->src);
+	return CFIO_ERROR_MSG_UNPACK;
+    }
+
+    /* the records start at the body, where the func code is unpacked to */
+    *ncid = head.ncid;
+    *rec_num = head.data_len;
+
+    debug(DEBUG_RECV, "ncid = %d, rec_num = %d", *ncid, *rec_num);
+
+    return CFIO_ERROR_NONE;
+}
+
+int cfio_recv_unpack_put_vara_rec(
+	cfio_msg_t *msg,
+	int *varid, int *ndims, 
+	size_t **start, size_t **count,
+	int *data_len, int *fp_type, char **fp)
+{
+    cfio_msg_rec_t rec;
+    size_t vec_size;
+    cfio_buf_t *buf;
+
+    buf = buffer[cfio_map_get_client_index_of_server(msg->src)];
+    memcpy(&rec, buf->used_addr, sizeof(cfio_msg_rec_t));
+    vec_size = rec.ndims * sizeof(size_t);
+
+    *varid = rec.varid;
+    *ndims = rec.ndims;
+    *fp_type = rec.type;
+    *data_len = rec.data_len;
+
+    *start = malloc(vec_size);
+    *count = malloc(vec_size);
+    if(NULL == *start || NULL == *count)
+    {
+	error("malloc for start and count fail.");
+	free(*start);
+	free(*count);
+	*start = *count = NULL;
+	return CFIO_ERROR_MALLOC;
+    }
+    memcpy(*start, buf->used_addr + sizeof(cfio_msg_rec_t), vec_size);
+    memcpy(*count, buf->used_addr + sizeof(cfio_msg_rec_t) + vec_size, 
+	    vec_size);
+
+    /* the data is not copied, a msg never wraps in the buffer */
+    *fp = buf->used_addr + rec.data_off;
+    free_buf(buf, rec.size);
+
+    debug(DEBUG_RECV, "varid = %d, ndims = %d, data_len = %d", 
+	    *varid, *ndims, *data_len);
+
+    return CFIO_ERROR_NONE;
+}
+
 int cfio_recv_unpack_close(
 	cfio_msg_t *msg,
 	int *ncid)
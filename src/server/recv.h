@@ -17,14 +17,32 @@
 #include <stdlib.h>
 
 #include "msg.h"
+#include "quicklist.h"
 #include "cfio_types.h"
 
 #define RECV_BUF_SIZE ((size_t)1*1024*1024*1024)
 
 #define CFIO_RECV_BUF_FULL 1
+/* amount of cfio_recv_hold_t malloced at a time */
+#define RECV_HOLD_SLAB_NUM 256
 
 /**
- * @brief: init the buffer and msg queue
+ * a msg whose space is kept after it is decoded, for some data in it is used
+ * without copy. the space of a buffer is given back in order, so the space 
+ * after a kept msg is given back after the msg is released
+ **/
+typedef struct
+{
+    int client_index;	/* index of the client which sent the msg */
+    char *addr;		/* start of the msg */
+    size_t size;	/* size of the msg */
+    int ref;		/* amount of data in the msg which is not freed */
+    qlist_head_t link;
+}cfio_recv_hold_t;
+
+/**
+ * @brief: init the recv pool shared by the clients, the ring of each client 
+ *	using shared memory, and the msg queue
  *
  * @return: error code
  */
@@ -35,27 +53,51 @@ int cfio_recv_init();
  * @return: error code
  */
 int cfio_recv_final();
-int cfio_iprobe(
-	int *src, int src_len, MPI_Comm comm, int *flag);
 /**
- * @brief: recv msg from client
+ * @brief: poll all clients for msgs, every arrived msg is put at the tail of 
+ *	the msg queue. a msg sent by MPI is probed and recved with its exact 
+ *	size into the pool, if the client is within its quota of the pool or 
+ *	the pool has room to spare. when blocked, the server waits in 
+ *	MPI_Mprobe if no client uses shared memory, else it backs off
  *
- * @param rank: the rank of server who recv the msg
- * @param comm: MPI communicator
- * @param _msg: point to the msg which is recieved
+ * @param block: 1 if wait until at least one msg arrive, 0 if return at once
+ * @param recv_num: pointer to where the number of arrived msgs is to be 
+ *	stored, can be NULL
  *
  * @return: error code
  */
-int cfio_recv(
-	int src, int rank, MPI_Comm comm, uint32_t *func_code);
+int cfio_recv_progress(int block, int *recv_num);
+/**
+ * @brief: check whether the msg queue is empty
+ *
+ * @return: 1 if empty, 0 if not
+ */
+int cfio_recv_msg_empty();
 
 /**
- * @brief: get the first msg in msg queue
+ * @brief: get the first msg in msg queue, msgs are in the order they arrived
  *
  * @return: pointer to the first msg
  */
 cfio_msg_t* cfio_recv_get_first();
 int cfio_recv_unpack_msg_size(cfio_msg_t *msg, size_t *size);
+/**
+ * @brief: keep the space of the msg being decoded after it is decoded, so the
+ *	data in it can be used without copy until it is freed by 
+ *	cfio_recv_free_data. a kept msg holds back the space of the msgs after
+ *	it, so data must not be kept for a msg which comes later
+ *
+ * @return: error code
+ */
+int cfio_recv_hold_last();
+/**
+ * @brief: free data, if the data is in a msg kept by cfio_recv_hold_last, the
+ *	msg is released, else the data is freed with free. it can be called in 
+ *	any thread
+ *
+ * @param data: the data, can be NULL
+ */
+void cfio_recv_free_data(void *data);
 /**
  * @brief: unpack funciton code from the buffer
  *
@@ -80,6 +122,20 @@ int cfio_recv_unpack_func_code(
 int cfio_recv_unpack_create(
 	cfio_msg_t *msg,
 	char **path, int *cmode, int *ncid);
+/**
+ * @brief: unpack arguments for cfio_create_from_template function
+ *
+ * @param path: poiter to where the file anme of the new netCDF dataset is to be 
+ *	stored
+ * @param ncid: pointer to where the ncid assigned by client is to be stored
+ * @param template_ncid: pointer to where the ncid of the template is to be 
+ *	stored
+ *
+ * @return: error code
+ */
+int cfio_recv_unpack_create_from_template(
+	cfio_msg_t *msg,
+	char **path, int *ncid, int *template_ncid);
 /**
  * @brief: unpack arguments for ifow_def_dim function
  *
@@ -117,6 +173,26 @@ int cfio_recv_unpack_def_var(
 	int *ncid, char **name, cfio_type *xtype,
 	int *ndims, int **dimids, 
 	size_t **start, size_t **count, int *varid);
+/**
+ * @brief: unpack the start and count of a def_var sent by a client which is 
+ *	not the meta leader
+ *
+ * @param ncid: pointer to where netCDF ID is to be stored
+ * @param xtype: pointer to where netCDF external data types is to be stored
+ * @param ndims: pointer to where number of dimensions for the variable is to 
+ *	be stored
+ * @param start: pointer to where the start index of to be written data value 
+ *	to be stored, need to be freed by the caller
+ * @param count: pointer to where the size of to be written data dimension len
+ *	value to be stored, need to be freed by the caller
+ * @param varid: pointer to where the varid assigned by client is to be stored
+ *
+ * @return: error code
+ */
+int cfio_recv_unpack_def_var_decomp(
+	cfio_msg_t *msg,
+	int *ncid, cfio_type *xtype, int *ndims, 
+	size_t **start, size_t **count, int *varid);
 /**
  * @brief: unpack arguments for cfio_put_att
  *
@@ -159,7 +235,9 @@ int cfio_recv_unpack_enddef(
  * @param data_len: pointer to the size of data 
  * @param fp_type: pointer to type of data, can be CFIO_BYTE, CFIO_CHAR, 
  *	CFIO_SHROT, CFIO_INT, CFIO_FLOAT, CFIO_DOUBLE
- * @param fp: where the data is stored
+ * @param fp: pointer to where the address of data is to be stored, the data 
+ *	is not copied, it points into the recv buffer and is only valid until 
+ *	the msg is decoded, unless the msg is kept by cfio_recv_hold_last
  *
  * @return: error code
  */
@@ -168,6 +246,63 @@ int cfio_recv_unpack_put_vara(
 	int *ncid, int *varid, int *ndims, 
 	size_t **start, size_t **count,
 	int *data_len, int *fp_type, char **fp);
+/**
+ * @brief: unpack arguments for a chunk of put_vara
+ *
+ * @param ncid: pointer to where netCDF ID is to be stored
+ * @param varid: pointer to where variable ID is to be stored 
+ * @param ndims: pointer to where the dimensionality of to be written variable
+ *	 is to be stored 
+ * @param start: pointer to where the start index of the chunk is to be stored
+ * @param count: pointer to where the count of the chunk is to be stored
+ * @param total_len: pointer to where the amount of elements of the whole 
+ *	put_vara is to be stored
+ * @param data_len: pointer to where the amount of elements in the chunk is to
+ *	be stored
+ * @param fp_type: pointer to type of data
+ * @param fp: pointer to where the address of data is to be stored, the data 
+ *	is not copied, it points into the recv buffer and is only valid until 
+ *	the msg is decoded
+ *
+ * @return: error code
+ */
+int cfio_recv_unpack_put_vara_chunk(
+	cfio_msg_t *msg,
+	int *ncid, int *varid, int *ndims, 
+	size_t **start, size_t **count, size_t *total_len,
+	int *data_len, int *fp_type, char **fp);
+/**
+ * @brief: unpack the head of a batch of put_vara, the records are unpacked by
+ *	cfio_recv_unpack_put_vara_rec one by one after it
+ *
+ * @param ncid: pointer to where netCDF ID of the records is to be stored
+ * @param rec_num: pointer to where the amount of records is to be stored
+ *
+ * @return: error code
+ */
+int cfio_recv_unpack_put_vara_batch(
+	cfio_msg_t *msg,
+	int *ncid, int *rec_num);
+/**
+ * @brief: unpack the next record of a batch of put_vara
+ *
+ * @param varid: pointer to where variable ID is to be stored 
+ * @param ndims: pointer to where the dimensionality of to be written variable
+ *	 is to be stored 
+ * @param start: pointer to where the start index is to be stored
+ * @param count: pointer to where the count is to be stored
+ * @param data_len: pointer to where the amount of elements is to be stored
+ * @param fp_type: pointer to type of data
+ * @param fp: pointer to where the address of data is to be stored, the data 
+ *	is not copied, as in cfio_recv_unpack_put_vara
+ *
+ * @return: error code
+ */
+int cfio_recv_unpack_put_vara_rec(
+	cfio_msg_t *msg,
+	int *varid, int *ndims, 
+	size_t **start, size_t **count,
+	int *data_len, int *fp_type, char **fp);
 /**
  * @brief: unpack arguments for the cfio_close function
  *
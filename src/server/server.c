@@ -18,22 +18,20 @@
 #include "server.h"
 #include "recv.h"
 #include "io.h"
+#include "pipeline.h"
 #include "id.h"
+#include "map.h"
 #include "mpi.h"
 #include "debug.h"
 #include "times.h"
 #include "define.h"
 #include "cfio_error.h"
 
-/* the thread read the buffer and write to the real io node */
-static pthread_t writer;
-/* the thread listen to the mpi message and put data into buffer */
-static pthread_t reader;
 /* my real rank in mpi_comm_world */
 static int rank;
 static int server_proc_num;	    /* server group size */
 
-static int reader_done, writer_done;
+static int reader_done;
 
 static int decode(cfio_msg_t *msg)
 {	
@@ -53,6 +51,13 @@ static int decode(cfio_msg_t *msg)
 	    debug(DEBUG_SERVER, "server %d done nc_create for client %d\n",
 		    rank,client_id);
 	    return CFIO_ERROR_NONE;
+	case FUNC_NC_CREATE_TEMPLATE: 
+	    debug(DEBUG_SERVER,"server %d recv nc_create_template from client %d",
+		    rank, client_id);
+	    cfio_io_create_from_template(msg);
+	    debug(DEBUG_SERVER, "server %d done nc_create_template for client %d\n",
+		    rank,client_id);
+	    return CFIO_ERROR_NONE;
 	case FUNC_NC_DEF_DIM:
 	    debug(DEBUG_SERVER,"server %d recv nc_def_dim from client %d",
 		    rank, client_id);
@@ -67,6 +72,13 @@ static int decode(cfio_msg_t *msg)
 	    debug(DEBUG_SERVER, "server %d done nc_def_var for client %d\n",
 		    rank,client_id);
 	    return CFIO_ERROR_NONE;
+	case FUNC_NC_DEF_VAR_DECOMP:
+	    debug(DEBUG_SERVER,"server %d recv nc_def_var_decomp from client %d",
+		    rank, client_id);
+	    cfio_io_def_var_decomp(msg);
+	    debug(DEBUG_SERVER, "server %d done nc_def_var_decomp for client %d\n",
+		    rank,client_id);
+	    return CFIO_ERROR_NONE;
 	case FUNC_PUT_ATT:
 	    debug(DEBUG_SERVER, "server %d recv nc_put_att from client %d",
 		    rank, client_id);
@@ -89,6 +101,29 @@ static int decode(cfio_msg_t *msg)
 		    "server %d done nc_put_vara_float from client %d\n", 
 		    rank, client_id);
 	    return CFIO_ERROR_NONE;
+	case FUNC_NC_PUT_VARA_CHUNK:
+	    debug(DEBUG_SERVER,"server %d recv nc_put_vara_chunk from client %d",
+		    rank, client_id);
+	    cfio_io_put_vara_chunk(msg);
+	    debug(DEBUG_SERVER, 
+		    "server %d done nc_put_vara_chunk from client %d\n", 
+		    rank, client_id);
+	    return CFIO_ERROR_NONE;
+	case FUNC_NC_PUT_VARA_BATCH:
+	    debug(DEBUG_SERVER,"server %d recv nc_put_vara_batch from client %d",
+		    rank, client_id);
+	    cfio_io_put_vara_batch(msg);
+	    debug(DEBUG_SERVER, 
+		    "server %d done nc_put_vara_batch from client %d\n", 
+		    rank, client_id);
+	    return CFIO_ERROR_NONE;
+	case FUNC_IO_END:
+	    debug(DEBUG_SERVER,"server %d recv io_end from client %d",
+		    rank, client_id);
+	    cfio_io_end_step(msg);
+	    debug(DEBUG_SERVER,"server %d done io_end for client %d\n",
+		    rank, client_id);
+	    return CFIO_ERROR_NONE;
 	case FUNC_NC_CLOSE:
 	    debug(DEBUG_SERVER,"server %d recv nc_close from client %d",
 		    rank, client_id);
@@ -110,128 +145,39 @@ static int decode(cfio_msg_t *msg)
     }	
 }
 
-static void * cfio_reader(void *argv)
-{
-    int ret = 0;
-    cfio_msg_t *msg;
-    
-    while(!reader_done)
-    {
-        msg = cfio_recv_get_first();
-        if(NULL != msg)
-        {
-            decode(msg);
-	    free(msg);
-        }
-    }
-    
-    debug(DEBUG_SERVER, "Server(%d) Reader done", rank);
-    return ((void *)0);
-}
-static inline void process_one(int client_num)
-{
-    int i;
-    cfio_msg_t *msg;
-
-    for(i = 0; i < client_num; i++)
-    {
-	msg = cfio_recv_get_first();
-	decode(msg);
-	free(msg);
-    }
-}
-
-static void* cfio_writer(void *argv)
+/**
+ * @brief: the recv stage of the server, recv and decode msgs in the calling 
+ *	thread until all clients finish, the data of vars is handed to the 
+ *	assemble threads and the io thread
+ */
+static void* cfio_receiver(void *argv)
 {
     cfio_msg_t *msg;
-    int i, server_index, client_num;
-    uint32_t func_code;
-    int *client_id;
-    double comm_time = 0.0, IO_time = 0.0;
-    double start_time = times_cur();
-    int decode_num, flag;
+    int client_num;
+    int decode_num;
 
-    server_index = cfio_map_get_server_index(rank);
     client_num = cfio_map_get_client_num_of_server(rank);
-    client_id = malloc(sizeof(int) * client_num);
-    if(client_id == NULL)
-    {
-	error("malloc fail.");
-	return (void*)0;
-    }
-    cfio_map_get_clients(rank, client_id);
 
-    while(!writer_done)
+    /* every client is polled for msgs, msgs are decoded in the order 
+     * they arrived, so no client waits for a slow one */
+    while(!reader_done)
     {
-	/*  recv from client one by one, to make sure that data recv and output in time */
-	//times_start();
-	for(i = 0; i < client_num; i ++)
+	/* block in recv only when there is nothing to decode */
+	if(cfio_recv_progress(cfio_recv_msg_empty(), NULL) < 0)
 	{
-	    while(cfio_recv(client_id[i], rank, cfio_map_get_comm(), &func_code)
-		    == CFIO_RECV_BUF_FULL)
-	    {
-	//times_start();
-		process_one(client_num);
-	//IO_time += times_end();
-	    }
-	    if(func_code == FUNC_FINAL)
-	    {
-		debug(DEBUG_SERVER,"server(writer) %d recv client_end_io from client %d",
-			rank, client_id[i]);
-		cfio_io_writer_done(client_id[i], &writer_done);
-		debug(DEBUG_SERVER, "server(writer) %d done client_end_io for client %d\n",
-			rank,client_id[i]);
-	    }
+	    error("server %d recv error.", rank);
+	    break;
 	}
-	//comm_time += times_end();
-	//msg = cfio_recv_get_first();
-	//while(NULL != msg)
-	//{
-	//    decode(msg);
-	//    free(msg);
-	//    msg = cfio_recv_get_first();
-	//}
-	//times_start();
-	if(func_code == FUNC_IO_END)
+	decode_num = 0;
+	/* back to recv after a round of msgs, to keep the clients polled */
+	while(decode_num < client_num && NULL != (msg = cfio_recv_get_first()))
 	{
-	    //printf("Server %d recv point : %f\n", rank, times_cur() - start_time);
-	    decode_num = 0;
-	    msg = cfio_recv_get_first();
-	    //times_start();
-	    while(NULL != msg)
-	    {
-		decode(msg);
-		free(msg);
-		decode_num ++;
-		if(decode_num == client_num)
-		{
-		    cfio_iprobe(client_id, client_num, cfio_map_get_comm(), &flag);
-		    if(flag == 1) // has recv arrived , recv first
-		    {
-		    //    printf("Server %d iprobe true : %f\n", rank, times_cur() - start_time);
-		        break;
-		    }
-		    decode_num = 0;
-		}
-		msg = cfio_recv_get_first();
-	    }
-	    //printf("Server %d one loop time : %f\n", rank, times_end());
+	    decode(msg);
+	    cfio_msg_free(msg);
+	    decode_num ++;
 	}
-	//IO_time += times_end();
-    }
-	//times_start();
-    msg = cfio_recv_get_first();
-    while(NULL != msg)
-    {
-	decode(msg);
-	free(msg);
-	msg = cfio_recv_get_first();
     }
-	//IO_time += times_end();
-    //printf("Server %d comm time : %f\n", rank, comm_time);
-    //printf("Server %d pnetcdf time : %f\n", rank, IO_time);
-    //printf("Server end : %f\n", times_cur() - start_time);
-    debug(DEBUG_SERVER, "Server(%d) Writer done", rank);
+    debug(DEBUG_SERVER, "Server(%d) Receiver done", rank);
     return ((void *)0);
 }
 
@@ -239,7 +185,7 @@ int cfio_server_start()
 {
     int ret = 0;
 
-    cfio_writer((void*)0);
+    cfio_receiver((void*)0);
     return CFIO_ERROR_NONE;
 }
 
@@ -257,13 +203,14 @@ int cfio_server_init()
     }
     
     reader_done = 0;
-    writer_done = 0;
     
     if((ret = cfio_id_init(CFIO_ID_INIT_SERVER)) < 0)
     {
 	error("");
 	return ret;
     }
+    /* some data put into the vars is kept in the recv buffer */
+    cfio_id_set_free_data(cfio_recv_free_data);
 
     if((ret = cfio_io_init(rank)) < 0)
     {
@@ -271,13 +218,21 @@ int cfio_server_init()
 	return ret;
     }
 
+    if((ret = cfio_pipe_init()) < 0)
+    {
+	error("");
+	return ret;
+    }
+
     return CFIO_ERROR_NONE;
 }
 
 int cfio_server_final()
 {
+    cfio_pipe_final();
     cfio_io_final();
     cfio_id_final();
+    cfio_id_set_free_data(NULL);
     cfio_recv_final();
 
 
@@ -0,0 +1,462 @@
+/****************************************************************************
+ *       Filename:  cfio_merge.c
+ *
+ *    Description:  merge the subfiles written with CFIO_SUBFILE into one nc
+ *		    file. the subfiles are read in parallel, each proc reads
+ *		    whole subfiles and writes them into the global file with
+ *		    large collective writes
+ *
+ *		    Usage : cfio_merge path out_path [cdf5]
+ *
+ *        Version:  1.0
+ *        Created:  10/17/2026 10:02:51 PM
+ *       Revision:  none
+ *       Compiler:  gcc
+ ***************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "mpi.h"
+#include "pnetcdf.h"
+#include "times.h"
+
+/* the same names as ATT_NAME_SUB_AMOUNT and ATT_NAME_START in server/io.h */
+#define ATT_NAME_SUB_AMOUNT "sub_amount"
+#define ATT_NAME_START	    "start"
+
+/* the header and each var of the global file are aligned to it */
+#define MERGE_ALIGN_SIZE    "1048576"
+/* max bytes of a var read from a subfile and written at a time */
+#define MERGE_SLAB_SIZE	    (64 * 1024 * 1024)
+
+#define MERGE_MAX_DIMS	    NC_MAX_VAR_DIMS
+
+static int rank, size;
+
+#define merge_error(ret, ...) \
+    do{ \
+	fprintf(stderr, "proc %d : ", rank); \
+	fprintf(stderr, __VA_ARGS__); \
+	fprintf(stderr, " (%s)\n", ncmpi_strerror(ret)); \
+	MPI_Abort(MPI_COMM_WORLD, -1); \
+    }while(0)
+
+/**
+ * @brief: get the MPI type and size of a nc type
+ *
+ * @param xtype: the nc type
+ * @param ele_size: pointer to where the size of an element is to be stored
+ *
+ * @return: the MPI type, MPI_DATATYPE_NULL if the type is not supported
+ */
+static MPI_Datatype _nc_to_mpi(nc_type xtype, int *ele_size)
+{
+    switch(xtype)
+    {
+	case NC_BYTE :
+	    *ele_size = 1;
+	    return MPI_SIGNED_CHAR;
+	case NC_CHAR :
+	    *ele_size = 1;
+	    return MPI_CHAR;
+	case NC_SHORT :
+	    *ele_size = 2;
+	    return MPI_SHORT;
+	case NC_INT :
+	    *ele_size = 4;
+	    return MPI_INT;
+	case NC_FLOAT :
+	    *ele_size = 4;
+	    return MPI_FLOAT;
+	case NC_DOUBLE :
+	    *ele_size = 8;
+	    return MPI_DOUBLE;
+	default :
+	    *ele_size = 0;
+	    return MPI_DATATYPE_NULL;
+    }
+}
+
+/**
+ * @brief: open a subfile
+ *
+ * @param path: path of the global file
+ * @param sub_index: index of the subfile
+ *
+ * @return: id of the subfile
+ */
+static int _open_sub(const char *path, int sub_index)
+{
+    char sub_path[1024];
+    int ret, nc_id;
+
+    snprintf(sub_path, sizeof(sub_path), "%s_%d", path, sub_index);
+    ret = ncmpi_open(MPI_COMM_SELF, sub_path, NC_NOWRITE, MPI_INFO_NULL,
+	    &nc_id);
+    if(NC_NOERR != ret)
+    {
+	merge_error(ret, "open %s fail", sub_path);
+    }
+
+    return nc_id;
+}
+
+/**
+ * @brief: get where a var of a subfile is in the global var and its count
+ *
+ * @param nc_id: id of the subfile
+ * @param var_id: id of the var
+ * @param start: where the start is to be stored, 0 if the var has no start
+ *	attribute
+ * @param count: where the count is to be stored
+ *
+ * @return: number of dims of the var
+ */
+static int _get_sub_box(int nc_id, int var_id,
+	MPI_Offset *start, MPI_Offset *count)
+{
+    int i, ndims, natts;
+    int dim_ids[MERGE_MAX_DIMS], sub_start[MERGE_MAX_DIMS];
+    nc_type xtype;
+
+    ncmpi_inq_var(nc_id, var_id, NULL, &xtype, &ndims, dim_ids, &natts);
+    if(NC_NOERR != ncmpi_get_att_int(nc_id, var_id, ATT_NAME_START,
+		sub_start))
+    {
+	memset(sub_start, 0, sizeof(sub_start));
+    }
+    for(i = 0; i < ndims; i ++)
+    {
+	start[i] = sub_start[i];
+	ncmpi_inq_dim(nc_id, dim_ids[i], NULL, &count[i]);
+    }
+
+    return ndims;
+}
+
+/**
+ * @brief: copy the attributes of a var or global attributes, except the ones
+ *	written for the subfiling
+ *
+ * @param in_id: id of the subfile
+ * @param out_id: id of the global file
+ * @param in_var_id: id of the var in the subfile, NC_GLOBAL for the global
+ *	attributes
+ * @param out_var_id: id of the var in the global file
+ * @param natts: number of the attributes
+ */
+static void _copy_atts(int in_id, int out_id, int in_var_id, int out_var_id,
+	int natts)
+{
+    int i, ret;
+    char name[NC_MAX_NAME + 1];
+
+    for(i = 0; i < natts; i ++)
+    {
+	ncmpi_inq_attname(in_id, in_var_id, i, name);
+	if((NC_GLOBAL == in_var_id && 0 == strcmp(name, ATT_NAME_SUB_AMOUNT))
+		|| (NC_GLOBAL != in_var_id &&
+		    0 == strcmp(name, ATT_NAME_START)))
+	{
+	    continue;
+	}
+	if(NC_NOERR != (ret = ncmpi_copy_att(in_id, in_var_id, name,
+			out_id, out_var_id)))
+	{
+	    merge_error(ret, "copy attr(%s) fail", name);
+	}
+    }
+}
+
+/**
+ * @brief: define the global file with the schema of a subfile, the global
+ *	length of each dim is the largest end of the vars of all subfiles
+ *
+ * @param path: path of the global file
+ * @param sub_amount: amount of the subfiles
+ * @param out_path: path of the new global file
+ * @param cmode: the creation mode flag of the global file
+ *
+ * @return: id of the global file
+ */
+static int _def_global(const char *path, int sub_amount,
+	const char *out_path, int cmode)
+{
+    int i, j, ret, nc_id, sub_id, out_id;
+    int ndims, nvars, ngatts, unlim_dim_id, var_ndims, natts, out_var_id;
+    int dim_ids[MERGE_MAX_DIMS];
+    char name[NC_MAX_NAME + 1];
+    nc_type xtype;
+    MPI_Offset *dim_len, start[MERGE_MAX_DIMS], count[MERGE_MAX_DIMS];
+    MPI_Info info;
+
+    nc_id = _open_sub(path, rank % sub_amount);
+    ncmpi_inq(nc_id, &ndims, &nvars, &ngatts, &unlim_dim_id);
+    dim_len = malloc(sizeof(MPI_Offset) * (ndims + 1));
+    assert(NULL != dim_len);
+    for(i = 0; i < ndims; i ++)
+    {
+	ncmpi_inq_dim(nc_id, i, NULL, &dim_len[i]);
+    }
+    /* each proc looks at the subfiles it merges, a dim not split keeps its
+     * length in the subfiles */
+    for(i = rank; i < sub_amount; i += size)
+    {
+	sub_id = (i == rank % sub_amount) ? nc_id : _open_sub(path, i);
+
+	for(j = 0; j < nvars; j ++)
+	{
+	    _get_sub_box(sub_id, j, start, count);
+	    ncmpi_inq_var(sub_id, j, NULL, &xtype, &var_ndims, dim_ids, &natts);
+	    while(var_ndims --)
+	    {
+		if(start[var_ndims] + count[var_ndims] >
+			dim_len[dim_ids[var_ndims]])
+		{
+		    dim_len[dim_ids[var_ndims]] =
+			start[var_ndims] + count[var_ndims];
+		}
+	    }
+	}
+	if(sub_id != nc_id)
+	{
+	    ncmpi_close(sub_id);
+	}
+    }
+    MPI_Allreduce(MPI_IN_PLACE, dim_len, ndims, MPI_OFFSET, MPI_MAX,
+	    MPI_COMM_WORLD);
+
+    MPI_Info_create(&info);
+    MPI_Info_set(info, "nc_header_align_size", MERGE_ALIGN_SIZE);
+    MPI_Info_set(info, "nc_var_align_size", MERGE_ALIGN_SIZE);
+    MPI_Info_set(info, "romio_cb_write", "enable");
+    ret = ncmpi_create(MPI_COMM_WORLD, out_path, cmode, info, &out_id);
+    MPI_Info_free(&info);
+    if(NC_NOERR != ret)
+    {
+	merge_error(ret, "create %s fail", out_path);
+    }
+
+    for(i = 0; i < ndims; i ++)
+    {
+	ncmpi_inq_dim(nc_id, i, name, NULL);
+	ret = ncmpi_def_dim(out_id, name,
+		i == unlim_dim_id ? NC_UNLIMITED : dim_len[i], &j);
+	if(NC_NOERR != ret)
+	{
+	    merge_error(ret, "def dim(%s) fail", name);
+	}
+    }
+    _copy_atts(nc_id, out_id, NC_GLOBAL, NC_GLOBAL, ngatts);
+    for(i = 0; i < nvars; i ++)
+    {
+	ncmpi_inq_var(nc_id, i, name, &xtype, &var_ndims, dim_ids, &natts);
+	ret = ncmpi_def_var(out_id, name, xtype, var_ndims, dim_ids,
+		&out_var_id);
+	if(NC_NOERR != ret)
+	{
+	    merge_error(ret, "def var(%s) fail", name);
+	}
+	_copy_atts(nc_id, out_id, i, out_var_id, natts);
+    }
+    if(NC_NOERR != (ret = ncmpi_enddef(out_id)))
+    {
+	merge_error(ret, "enddef %s fail", out_path);
+    }
+
+    ncmpi_close(nc_id);
+    free(dim_len);
+    return out_id;
+}
+
+/**
+ * @brief: copy a var of a subfile into the global file, slab by slab along
+ *	its first dim. all procs call it for the same var together, the ones
+ *	without a subfile join the collective writes with nothing
+ *
+ * @param nc_id: id of the subfile, < 0 if the proc has no subfile
+ * @param out_id: id of the global file
+ * @param var_id: id of the var
+ * @param buf: pointer to the buffer, it is grown if a row of the var is
+ *	larger than it
+ * @param buf_size: pointer to the size of the buffer
+ *
+ * @return: bytes written
+ */
+static MPI_Offset _merge_var(int nc_id, int out_id, int var_id, char **buf,
+	MPI_Offset *buf_size)
+{
+    int i, ret, ndims, ele_size;
+    nc_type xtype;
+    MPI_Datatype ele_type;
+    MPI_Offset start[MERGE_MAX_DIMS], count[MERGE_MAX_DIMS];
+    MPI_Offset sub_start[MERGE_MAX_DIMS], sub_count[MERGE_MAX_DIMS];
+    MPI_Offset out_start[MERGE_MAX_DIMS];
+    MPI_Offset row_size, rows = 0, slab_rows, slab_num = 0, slab, written = 0;
+    MPI_Offset ele_num;
+
+    ncmpi_inq_var(out_id, var_id, NULL, &xtype, &ndims, NULL, NULL);
+    if(MPI_DATATYPE_NULL == (ele_type = _nc_to_mpi(xtype, &ele_size)))
+    {
+	merge_error(NC_NOERR, "type(%d) of var(%d) not supported",
+		xtype, var_id);
+    }
+
+    memset(start, 0, sizeof(start));
+    memset(count, 0, sizeof(count));
+    row_size = ele_size;
+    if(nc_id >= 0)
+    {
+	_get_sub_box(nc_id, var_id, sub_start, sub_count);
+	for(i = 1; i < ndims; i ++)
+	{
+	    row_size *= sub_count[i];
+	}
+	rows = ndims > 0 ? sub_count[0] : 1;
+    }
+    slab_rows = MERGE_SLAB_SIZE / row_size;
+    if(slab_rows < 1)
+    {
+	/* a row is larger than a slab, the slab is a row */
+	slab_rows = 1;
+	if(row_size > *buf_size)
+	{
+	    *buf = realloc(*buf, row_size);
+	    assert(NULL != *buf);
+	    *buf_size = row_size;
+	}
+    }
+    if(row_size > 0 && rows > 0)
+    {
+	slab_num = (rows + slab_rows - 1) / slab_rows;
+    }
+    MPI_Allreduce(MPI_IN_PLACE, &slab_num, 1, MPI_OFFSET, MPI_MAX,
+	    MPI_COMM_WORLD);
+
+    for(slab = 0; slab < slab_num; slab ++)
+    {
+	if(nc_id >= 0 && slab * slab_rows < rows)
+	{
+	    for(i = 0; i < ndims; i ++)
+	    {
+		start[i] = 0;
+		count[i] = sub_count[i];
+	    }
+	    ele_num = row_size / ele_size;
+	    if(ndims > 0)
+	    {
+		start[0] = slab * slab_rows;
+		count[0] = rows - start[0] < slab_rows ?
+		    rows - start[0] : slab_rows;
+		ele_num *= count[0];
+	    }
+	    ret = ncmpi_get_vara_all(nc_id, var_id, start, count, *buf,
+		    ele_num, ele_type);
+	    if(NC_NOERR != ret)
+	    {
+		merge_error(ret, "read var(%d) fail", var_id);
+	    }
+	    for(i = 0; i < ndims; i ++)
+	    {
+		out_start[i] = sub_start[i] + start[i];
+	    }
+	    ret = ncmpi_put_vara_all(out_id, var_id, out_start, count, *buf,
+		    ele_num, ele_type);
+	    written += ele_num * ele_size;
+	}else
+	{
+	    /* take part in the collective call even with nothing to write */
+	    memset(out_start, 0, sizeof(out_start));
+	    memset(count, 0, sizeof(count));
+	    ret = ncmpi_put_vara_all(out_id, var_id, out_start, count, *buf,
+		    0, ele_type);
+	}
+	if(NC_NOERR != ret)
+	{
+	    merge_error(ret, "write var(%d) fail", var_id);
+	}
+    }
+
+    return written;
+}
+
+int main(int argc, char** argv)
+{
+    int i, ret, nc_id, out_id, nvars;
+    int sub_amount, round, cmode;
+    char *buf;
+    MPI_Offset written = 0, buf_size = MERGE_SLAB_SIZE;
+    double time;
+
+    MPI_Init(&argc, &argv);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    if(3 != argc && !(4 == argc && 0 == strcmp(argv[3], "cdf5")))
+    {
+	if(0 == rank)
+	{
+	    printf("Usage : cfio_merge path out_path [cdf5]\n");
+	}
+	MPI_Finalize();
+	return -1;
+    }
+    cmode = NC_CLOBBER | (4 == argc ? NC_64BIT_DATA : NC_64BIT_OFFSET);
+
+    times_init();
+    times_start();
+
+    if(0 == rank)
+    {
+	nc_id = _open_sub(argv[1], 0);
+	if(NC_NOERR != (ret = ncmpi_get_att_int(nc_id, NC_GLOBAL,
+			ATT_NAME_SUB_AMOUNT, &sub_amount)))
+	{
+	    merge_error(ret, "%s_0 is not a subfile", argv[1]);
+	}
+	ncmpi_close(nc_id);
+    }
+    MPI_Bcast(&sub_amount, 1, MPI_INT, 0, MPI_COMM_WORLD);
+
+    out_id = _def_global(argv[1], sub_amount, argv[2], cmode);
+    ncmpi_inq(out_id, NULL, &nvars, NULL, NULL);
+
+    buf = malloc(buf_size);
+    assert(NULL != buf);
+
+    /* each proc merges the subfiles rank, rank + size, ... */
+    for(round = 0; round * size < sub_amount; round ++)
+    {
+	i = round * size + rank;
+	nc_id = i < sub_amount ? _open_sub(argv[1], i) : -1;
+	for(i = 0; i < nvars; i ++)
+	{
+	    written += _merge_var(nc_id, out_id, i, &buf, &buf_size);
+	}
+	if(nc_id >= 0)
+	{
+	    ncmpi_close(nc_id);
+	}
+    }
+
+    free(buf);
+    if(NC_NOERR != (ret = ncmpi_close(out_id)))
+    {
+	merge_error(ret, "close %s fail", argv[2]);
+    }
+
+    time = times_end();
+    MPI_Allreduce(MPI_IN_PLACE, &written, 1, MPI_OFFSET, MPI_SUM,
+	    MPI_COMM_WORLD);
+    if(0 == rank)
+    {
+	printf("merge %d subfiles into %s : %lld bytes, %f ms\n",
+		sub_amount, argv[2], (long long)written, time);
+    }
+
+    times_final();
+    MPI_Finalize();
+    return 0;
+}
@@ -0,0 +1,401 @@
+/****************************************************************************
+ *       Filename:  cfio_raw2nc.c
+ *
+ *    Description:  rebuild a nc file from the logs and the indexes written
+ *		    with CFIO_BACKEND=raw. each proc reads the logs of some
+ *		    servers and writes their blocks into the nc file with
+ *		    nonblocking writes, which are flushed together in large
+ *		    batches
+ *
+ *		    Usage : cfio_raw2nc path out_path [cdf5]
+ *
+ *		    with CFIO_SUBFILE each subfile path_n is rebuilt alone,
+ *		    the results are merged with cfio_merge
+ *
+ *        Version:  1.0
+ *        Created:  10/17/2026 11:36:08 PM
+ *       Revision:  none
+ *       Compiler:  gcc
+ ***************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <assert.h>
+
+#include "mpi.h"
+#include "pnetcdf.h"
+#include "backend.h"
+#include "times.h"
+
+/* the header and each var of the nc file are aligned to it */
+#define RAW2NC_ALIGN_SIZE   "1048576"
+/* the blocks are read and written in batches of about this size */
+#define RAW2NC_BATCH_SIZE   (64 * 1024 * 1024)
+/* max amount of the blocks of a batch */
+#define RAW2NC_BATCH_NUM    1024
+
+static int rank, size;
+
+#define raw2nc_error(msg, ...) \
+    do{ \
+	fprintf(stderr, "proc %d : ", rank); \
+	fprintf(stderr, __VA_ARGS__); \
+	fprintf(stderr, " (%s)\n", msg); \
+	MPI_Abort(MPI_COMM_WORLD, -1); \
+    }while(0)
+
+/* the index being walked and the log of the same server */
+static char *idx;
+static uint64_t idx_size, idx_pos;
+static int log_fd = -1;
+
+/**
+ * @brief: read size bytes at offset of a fd
+ *
+ * @param fd: the fd
+ * @param buf: where the bytes are to be stored
+ * @param count: amount of the bytes
+ * @param offset: where to read
+ */
+static void _read_at(int fd, char *buf, uint64_t count, uint64_t offset)
+{
+    ssize_t ret;
+
+    while(count > 0)
+    {
+	if((ret = pread(fd, buf, count, offset)) <= 0)
+	{
+	    if(ret < 0 && EINTR == errno)
+	    {
+		continue;
+	    }
+	    raw2nc_error(ret < 0 ? strerror(errno) : "end of file",
+		    "read fd(%d) at %llu fail", fd, (unsigned long long)offset);
+	}
+	buf += ret;
+	count -= ret;
+	offset += ret;
+    }
+}
+
+/**
+ * @brief: load the index of a server, and open its log if log is set
+ *
+ * @param path: path of the file
+ * @param server: rank of the server
+ * @param log: whether to open the log
+ *
+ * @return: the head of the index
+ */
+static cfio_raw_head_t *_load(const char *path, int server, int log)
+{
+    char file_path[1024];
+    int fd;
+    off_t end;
+    cfio_raw_head_t *head;
+
+    snprintf(file_path, sizeof(file_path), "%s.%d.idx", path, server);
+    if((fd = open(file_path, O_RDONLY)) < 0 ||
+	    (end = lseek(fd, 0, SEEK_END)) < 0)
+    {
+	raw2nc_error(strerror(errno), "open %s fail", file_path);
+    }
+    free(idx);
+    idx_size = end;
+    idx = malloc(idx_size);
+    assert(NULL != idx);
+    _read_at(fd, idx, idx_size, 0);
+    close(fd);
+
+    head = (cfio_raw_head_t *)idx;
+    if(idx_size < sizeof(cfio_raw_head_t) ||
+	    0 != strcmp(head->magic, RAW_MAGIC) ||
+	    RAW_VERSION != head->version)
+    {
+	raw2nc_error("bad head", "%s is not a raw index", file_path);
+    }
+    idx_pos = sizeof(cfio_raw_head_t);
+
+    if(log_fd >= 0)
+    {
+	close(log_fd);
+	log_fd = -1;
+    }
+    if(log)
+    {
+	snprintf(file_path, sizeof(file_path), "%s.%d.log", path, server);
+	if((log_fd = open(file_path, O_RDONLY)) < 0)
+	{
+	    raw2nc_error(strerror(errno), "open %s fail", file_path);
+	}
+    }
+
+    return head;
+}
+
+/**
+ * @brief: get the next record of the index loaded
+ *
+ * @param body: where the pointer to the data after the record head is to be
+ *	stored
+ *
+ * @return: the record, NULL at the end of the index
+ */
+static cfio_raw_rec_t *_next_rec(char **body)
+{
+    cfio_raw_rec_t *rec;
+
+    if(idx_pos + sizeof(cfio_raw_rec_t) > idx_size)
+    {
+	return NULL;
+    }
+    rec = (cfio_raw_rec_t *)(idx + idx_pos);
+    if(rec->size < sizeof(cfio_raw_rec_t) || idx_pos + rec->size > idx_size)
+    {
+	raw2nc_error("bad record", "index broken at %llu",
+		(unsigned long long)idx_pos);
+    }
+    idx_pos += rec->size;
+    *body = (char *)rec + sizeof(cfio_raw_rec_t);
+
+    return rec;
+}
+
+/**
+ * @brief: define the nc file with the dims, vars and attributes in the index
+ *	of the server 0, which are the same in all indexes
+ *
+ * @param path: path of the raw file
+ * @param out_path: path of the nc file
+ * @param cmode: the creation mode flag of the nc file
+ *
+ * @return: id of the nc file
+ */
+static int _def_nc(const char *path, const char *out_path, int cmode)
+{
+    int ret, out_id, id;
+    char *body, *name;
+    int32_t ndims;
+    int64_t len;
+    cfio_raw_rec_t *rec;
+    MPI_Info info;
+
+    MPI_Info_create(&info);
+    MPI_Info_set(info, "nc_header_align_size", RAW2NC_ALIGN_SIZE);
+    MPI_Info_set(info, "nc_var_align_size", RAW2NC_ALIGN_SIZE);
+    MPI_Info_set(info, "romio_cb_write", "enable");
+    ret = ncmpi_create(MPI_COMM_WORLD, out_path, cmode, info, &out_id);
+    MPI_Info_free(&info);
+    if(NC_NOERR != ret)
+    {
+	raw2nc_error(ncmpi_strerror(ret), "create %s fail", out_path);
+    }
+
+    _load(path, 0, 0);
+    while(NULL != (rec = _next_rec(&body)))
+    {
+	switch(rec->type)
+	{
+	    case RAW_REC_DIM :
+		memcpy(&len, body, sizeof(int64_t));
+		name = body + sizeof(int64_t);
+		ret = ncmpi_def_dim(out_id, name, len, &id);
+		break;
+	    case RAW_REC_VAR :
+		memcpy(&ndims, body, sizeof(int32_t));
+		name = body + sizeof(int32_t) * (1 + ndims);
+		ret = ncmpi_def_var(out_id, name, cfio_type_to_nc(rec->arg),
+			ndims, (int *)(body + sizeof(int32_t)), &id);
+		break;
+	    case RAW_REC_ATT :
+		memcpy(&len, body, sizeof(int64_t));
+		name = body + sizeof(int64_t);
+		body = name + strlen(name) + 1;
+		switch(rec->arg)
+		{
+		    case CFIO_CHAR :
+			ret = ncmpi_put_att_text(out_id, rec->id, name,
+				len, body);
+			break;
+		    case CFIO_INT :
+			ret = ncmpi_put_att_int(out_id, rec->id, name,
+				NC_INT, len, (int *)body);
+			break;
+		    case CFIO_FLOAT :
+			ret = ncmpi_put_att_float(out_id, rec->id, name,
+				NC_FLOAT, len, (float *)body);
+			break;
+		    case CFIO_DOUBLE :
+			ret = ncmpi_put_att_double(out_id, rec->id, name,
+				NC_DOUBLE, len, (double *)body);
+			break;
+		    default :
+			ret = NC_NOERR;
+			break;
+		}
+		break;
+	    default :
+		/* the defs all come before the data */
+		idx_pos = idx_size;
+		ret = NC_NOERR;
+		break;
+	}
+	if(NC_NOERR != ret)
+	{
+	    raw2nc_error(ncmpi_strerror(ret), "def record(%d, %d) fail",
+		    rec->type, rec->id);
+	}
+    }
+    if(NC_NOERR != (ret = ncmpi_enddef(out_id)))
+    {
+	raw2nc_error(ncmpi_strerror(ret), "enddef %s fail", out_path);
+    }
+
+    return out_id;
+}
+
+int main(int argc, char** argv)
+{
+    int i, ret, out_id, cmode, server, server_amount;
+    int req_num, more, ndims, ele_size = 1;
+    int reqs[RAW2NC_BATCH_NUM], statuses[RAW2NC_BATCH_NUM];
+    int64_t block[2];
+    char *buf, *body;
+    uint64_t buf_size = RAW2NC_BATCH_SIZE, used;
+    cfio_raw_rec_t *rec;
+    MPI_Offset start[NC_MAX_VAR_DIMS], count[NC_MAX_VAR_DIMS];
+    MPI_Offset written = 0;
+    double time;
+
+    MPI_Init(&argc, &argv);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    if(3 != argc && !(4 == argc && 0 == strcmp(argv[3], "cdf5")))
+    {
+	if(0 == rank)
+	{
+	    printf("Usage : cfio_raw2nc path out_path [cdf5]\n");
+	}
+	MPI_Finalize();
+	return -1;
+    }
+    cmode = NC_CLOBBER | (4 == argc ? NC_64BIT_DATA : NC_64BIT_OFFSET);
+
+    times_init();
+    times_start();
+
+    out_id = _def_nc(argv[1], argv[2], cmode);
+    server_amount = ((cfio_raw_head_t *)idx)->size;
+
+    buf = malloc(buf_size);
+    assert(NULL != buf);
+
+    /* each proc reads the logs of the servers rank, rank + size, ... . a
+     * batch is flushed with a collective wait, so all procs go on until
+     * the last one has nothing left */
+    server = rank;
+    if(server < server_amount)
+    {
+	_load(argv[1], server, 1);
+    }
+    rec = NULL;
+    do
+    {
+	req_num = 0;
+	used = 0;
+	while(req_num < RAW2NC_BATCH_NUM && server < server_amount)
+	{
+	    if(NULL == rec && NULL == (rec = _next_rec(&body)))
+	    {
+		if((server += size) < server_amount)
+		{
+		    _load(argv[1], server, 1);
+		}
+		continue;
+	    }
+	    if(RAW_REC_DATA != rec->type)
+	    {
+		rec = NULL;
+		continue;
+	    }
+	    memcpy(block, body, sizeof(block));
+	    if(used > 0 && used + block[1] > buf_size)
+	    {
+		/* left for the next batch */
+		break;
+	    }
+	    if(block[1] > buf_size)
+	    {
+		buf_size = block[1];
+		buf = realloc(buf, buf_size);
+		assert(NULL != buf);
+	    }
+	    ndims = rec->arg;
+	    for(i = 0; i < ndims; i ++)
+	    {
+		memcpy(&start[i], body + sizeof(block) + sizeof(int64_t) * i,
+			sizeof(int64_t));
+		memcpy(&count[i], body + sizeof(block) +
+			sizeof(int64_t) * (ndims + i), sizeof(int64_t));
+	    }
+	    cfio_types_size(ele_size, rec->dtype);
+	    _read_at(log_fd, buf + used, block[1], block[0]);
+	    ret = ncmpi_iput_vara(out_id, rec->id, start, count, buf + used,
+		    block[1] / ele_size, cfio_type_to_mpi(rec->dtype),
+		    &reqs[req_num]);
+	    if(NC_NOERR != ret)
+	    {
+		raw2nc_error(ncmpi_strerror(ret), "post var(%d) fail",
+			rec->id);
+	    }
+	    req_num ++;
+	    used += block[1];
+	    written += block[1];
+	    rec = NULL;
+	}
+
+	if(NC_NOERR != (ret = ncmpi_wait_all(out_id, req_num, reqs,
+			statuses)))
+	{
+	    raw2nc_error(ncmpi_strerror(ret), "wait fail");
+	}
+	for(i = 0; i < req_num; i ++)
+	{
+	    if(NC_NOERR != statuses[i])
+	    {
+		raw2nc_error(ncmpi_strerror(statuses[i]), "write fail");
+	    }
+	}
+	more = server < server_amount;
+	MPI_Allreduce(MPI_IN_PLACE, &more, 1, MPI_INT, MPI_MAX,
+		MPI_COMM_WORLD);
+    }while(more);
+
+    free(buf);
+    free(idx);
+    if(log_fd >= 0)
+    {
+	close(log_fd);
+    }
+    if(NC_NOERR != (ret = ncmpi_close(out_id)))
+    {
+	raw2nc_error(ncmpi_strerror(ret), "close %s fail", argv[2]);
+    }
+
+    time = times_end();
+    MPI_Allreduce(MPI_IN_PLACE, &written, 1, MPI_OFFSET, MPI_SUM,
+	    MPI_COMM_WORLD);
+    if(0 == rank)
+    {
+	printf("rebuild %s from %d servers : %lld bytes, %f ms\n",
+		argv[2], server_amount, (long long)written, time);
+    }
+
+    times_final();
+    MPI_Finalize();
+    return 0;
+}
@@ -0,0 +1,175 @@
+/****************************************************************************
+ *       Filename:  chunk_test.c
+ *
+ *    Description:  test put_vara larger than the max msg size, the block is
+ *		    sent in chunks. the last client defines the vars after
+ *		    the others have put, so the server keeps their chunks
+ *		    in define mode
+ *
+ *        Version:  1.0
+ *        Created:  10/17/2026 05:02:48 PM
+ *       Revision:  none
+ *       Compiler:  gcc
+ ***************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "mpi.h"
+#include "pnetcdf.h"
+#include "cfio.h"
+#include "map.h"
+
+#define Z   16
+#define LAT 1024
+#define LON 1024
+
+#define LAT_PROC 4
+#define LON_PROC 4
+
+#define ratio 8
+
+/* the first client puts M0 of the 1-D var, the others MR each */
+#define M0 1000000
+#define MR 1000
+#define M_LEN (M0 + (LAT_PROC * LON_PROC - 1) * MR)
+
+int main(int argc, char** argv)
+{
+    int rank, size;
+    char *path = "chunk_test.nc";
+    int ncidp;
+    int var1, var2, i, n;
+    int index, last;
+    int dimids[3], mdim;
+    size_t start[3], count[3], mstart, mcount;
+    double *fp, *mp;
+    int *client_ranks;
+    MPI_Group world_group, client_group;
+    MPI_Comm client_comm;
+
+    MPI_Init(&argc, &argv);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    cfio_init( LAT_PROC, LON_PROC, ratio);
+    CFIO_START();
+
+    client_ranks = malloc(size * sizeof(int));
+    for(i = 0, n = 0; i < size; i ++)
+    {
+	if(CFIO_MAP_TYPE_CLIENT == cfio_map_proc_type(i))
+	{
+	    client_ranks[n ++] = i;
+	}
+    }
+    MPI_Comm_group(MPI_COMM_WORLD, &world_group);
+    MPI_Group_incl(world_group, n, client_ranks, &client_group);
+    MPI_Comm_create_group(MPI_COMM_WORLD, client_group, 0, &client_comm);
+    free(client_ranks);
+
+    index = cfio_client_index();
+    last = (index == LAT_PROC * LON_PROC - 1);
+    start[0] = 0;
+    start[1] = (index % LAT_PROC) * (LAT / LAT_PROC);
+    start[2] = (index / LAT_PROC) * (LON / LON_PROC);
+    count[0] = Z;
+    count[1] = LAT / LAT_PROC;
+    count[2] = LON / LON_PROC;
+    fp = malloc(count[0] * count[1] * count[2] * sizeof(double));
+    for(i = 0; i < count[0] * count[1] * count[2]; i ++)
+    {
+	fp[i] = (i / (count[1] * count[2]) * LAT +
+		start[1] + i / count[2] % count[1]) * LON +
+	    start[2] + i % count[2];
+    }
+    mcount = 0 == index ? M0 : MR;
+    mstart = 0 == index ? 0 : M0 + (index - 1) * MR;
+    mp = malloc(mcount * sizeof(double));
+    for(i = 0; i < mcount; i ++)
+    {
+	mp[i] = mstart + i;
+    }
+
+    cfio_create(path, 0, &ncidp);
+    cfio_def_dim(ncidp, "z", Z, &dimids[0]);
+    cfio_def_dim(ncidp, "lat", LAT, &dimids[1]);
+    cfio_def_dim(ncidp, "lon", LON, &dimids[2]);
+    cfio_def_dim(ncidp, "m", M_LEN, &mdim);
+    if(last)
+    {
+	/* all msgs of the others are sent */
+	MPI_Barrier(client_comm);
+    }
+    cfio_def_var(ncidp, "chunk_v", CFIO_DOUBLE, 3, dimids, start, count,
+	    &var1);
+    cfio_def_var(ncidp, "chunk_m", CFIO_DOUBLE, 1, &mdim, &mstart, &mcount,
+	    &var2);
+    cfio_enddef(ncidp);
+    cfio_put_vara_double(ncidp, var1, 3, start, count, fp);
+    cfio_put_vara_double(ncidp, var2, 1, &mstart, &mcount, mp);
+    cfio_close(ncidp);
+    cfio_io_end();
+    if(!last)
+    {
+	MPI_Barrier(client_comm);
+    }
+
+    free(fp);
+    free(mp);
+    MPI_Comm_free(&client_comm);
+    MPI_Group_free(&client_group);
+    MPI_Group_free(&world_group);
+
+    CFIO_END();
+    cfio_finalize();
+
+    /* read the file back when the servers have closed it */
+    MPI_Barrier(MPI_COMM_WORLD);
+    if(0 == rank)
+    {
+	MPI_Offset rstart[3] = {0, 0, 0}, rcount[3] = {1, LAT, LON};
+	int nc_id, var_id, err = 0;
+
+	if(NC_NOERR != ncmpi_open(MPI_COMM_SELF, path, NC_NOWRITE,
+		    MPI_INFO_NULL, &nc_id))
+	{
+	    printf("open %s fail\n", path);
+	    MPI_Abort(MPI_COMM_WORLD, -1);
+	}
+	fp = malloc((LAT * LON > M_LEN ? LAT * LON : M_LEN) * sizeof(double));
+	ncmpi_inq_varid(nc_id, "chunk_v", &var_id);
+	for(rstart[0] = 0; rstart[0] < Z; rstart[0] ++)
+	{
+	    if(NC_NOERR != ncmpi_get_vara_double_all(nc_id, var_id, 
+			rstart, rcount, fp))
+	    {
+		err += LAT * LON;
+		continue;
+	    }
+	    for(i = 0; i < LAT * LON; i ++)
+	    {
+		err += (fp[i] != rstart[0] * LAT * LON + i);
+	    }
+	}
+	ncmpi_inq_varid(nc_id, "chunk_m", &var_id);
+	rstart[0] = 0;
+	rcount[0] = M_LEN;
+	if(NC_NOERR != ncmpi_get_vara_double_all(nc_id, var_id, 
+		    rstart, rcount, fp))
+	{
+	    err += M_LEN;
+	}else
+	{
+	    for(i = 0; i < M_LEN; i ++)
+	    {
+		err += (fp[i] != i);
+	    }
+	}
+	ncmpi_close(nc_id);
+	free(fp);
+	printf("%s : %d wrong values\n", path, err);
+    }
+
+    MPI_Finalize();
+    return 0;
+}
@@ -33,6 +33,7 @@ int main(int argc, char** argv)
     char *path = "test";
     int ncidp;
     int dim1,var1,i;
+    int index;
 
     size_t len = 10;
     char *test="test";
@@ -45,21 +46,24 @@ int main(int argc, char** argv)
     //assert(size == LAT_PROC * LON_PROC);
     //set_debug_mask(DEBUG_IO); 
     size_t start[2],count[2];
-    start[0] = (rank % LAT_PROC) * (LAT / LAT_PROC);
-    start[1] = (rank / LAT_PROC) * (LON / LON_PROC);
+
+    cfio_init( LAT_PROC, LON_PROC, ratio);
+    CFIO_START();
+
+    /* the block is located by the client index, not the rank, for they 
+     * differ when CFIO_MAP_TOPOLOGY is set */
+    index = cfio_client_index();
+    start[0] = (index % LAT_PROC) * (LAT / LAT_PROC);
+    start[1] = (index / LAT_PROC) * (LON / LON_PROC);
     count[0] = LAT / LAT_PROC;
     count[1] = LON / LON_PROC;
     float *fp = malloc(count[0] * count[1] *sizeof(float));
 
     for( i = 0; i< count[0] * count[1]; i++)
     {
-	fp[i] = i + rank * count[0] * count[1];
+	fp[i] = i + index * count[0] * count[1];
     }
 
-
-    cfio_init( LAT_PROC, LON_PROC, ratio);
-    CFIO_START();
-
     char fileName[100];
     memset(fileName, 0, sizeof(fileName));
     sprintf(fileName,"%s.nc",path);
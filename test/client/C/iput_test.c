@@ -0,0 +1,149 @@
+/****************************************************************************
+ *       Filename:  iput_test.c
+ *
+ *    Description:  test the non-blocking put, cfio_iput_vara_*, cfio_wait
+ *		    and cfio_test, the output file is read back and checked
+ *
+ *        Version:  1.0
+ *        Created:  10/17/2026 03:40:12 PM
+ *       Revision:  none
+ *       Compiler:  gcc
+ ***************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mpi.h"
+#include "pnetcdf.h"
+#include "cfio.h"
+#include "cfio_error.h"
+
+/* the block of a client is large enough to be sent without copy */
+#define LAT 512
+#define LON 512
+
+#define LAT_PROC 4
+#define LON_PROC 4
+
+#define ratio 8
+
+int main(int argc, char** argv)
+{
+    int rank, size;
+    char *path = "iput_test.nc";
+    int ncidp;
+    int var1, var2, i;
+    int index, req1, req2, flag, ret;
+    int dimids[2];
+    size_t start[2], count[2];
+    double *fp;
+
+    MPI_Init(&argc, &argv);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    cfio_init( LAT_PROC, LON_PROC, ratio);
+    CFIO_START();
+
+    index = cfio_client_index();
+    start[0] = (index % LAT_PROC) * (LAT / LAT_PROC);
+    start[1] = (index / LAT_PROC) * (LON / LON_PROC);
+    count[0] = LAT / LAT_PROC;
+    count[1] = LON / LON_PROC;
+    fp = malloc(count[0] * count[1] * sizeof(double));
+    for(i = 0; i < count[0] * count[1]; i ++)
+    {
+	fp[i] = (start[0] + i / count[1]) * LON + start[1] + i % count[1];
+    }
+
+    cfio_create(path, 0, &ncidp);
+    cfio_def_dim(ncidp, "lat", LAT, &dimids[0]);
+    cfio_def_dim(ncidp, "lon", LON, &dimids[1]);
+    cfio_def_var(ncidp, "iput_v", CFIO_DOUBLE, 2, dimids, start, count, &var1);
+    cfio_def_var(ncidp, "reuse_v", CFIO_DOUBLE, 2, dimids, start, count,
+	    &var2);
+    cfio_enddef(ncidp);
+
+    /* fp can be reused once cfio_wait returns */
+    cfio_iput_vara_double(ncidp, var1, 2, start, count, fp, &req1);
+    if(CFIO_ERROR_NONE != (ret = cfio_wait(req1)))
+    {
+	printf("proc %d wait fail(%d)\n", rank, ret);
+    }
+    for(i = 0; i < count[0] * count[1]; i ++)
+    {
+	fp[i] = - fp[i];
+    }
+
+    /* poll with cfio_test until the put is done, then clobber fp */
+    cfio_iput_vara_double(ncidp, var2, 2, start, count, fp, &req2);
+    flag = 0;
+    while(!flag)
+    {
+	if(CFIO_ERROR_NONE != (ret = cfio_test(req2, &flag)))
+	{
+	    printf("proc %d test fail(%d)\n", rank, ret);
+	    break;
+	}
+    }
+    memset(fp, 0, count[0] * count[1] * sizeof(double));
+
+    /* a done request is freed, waiting it again is an error */
+    if(CFIO_ERROR_INVALID_REQ != (ret = cfio_wait(req1)))
+    {
+	printf("proc %d wait a done request returns %d\n", rank, ret);
+    }
+
+    cfio_close(ncidp);
+    cfio_io_end();
+    free(fp);
+
+    CFIO_END();
+    cfio_finalize();
+
+    /* read the file back when the servers have closed it */
+    MPI_Barrier(MPI_COMM_WORLD);
+    if(0 == rank)
+    {
+	MPI_Offset rstart[2] = {0, 0}, rcount[2] = {LAT, LON};
+	int nc_id, var_id, err = 0;
+
+	if(NC_NOERR != ncmpi_open(MPI_COMM_SELF, path, NC_NOWRITE,
+		    MPI_INFO_NULL, &nc_id))
+	{
+	    printf("open %s fail\n", path);
+	    MPI_Abort(MPI_COMM_WORLD, -1);
+	}
+	fp = malloc(LAT * LON * sizeof(double));
+	ncmpi_inq_varid(nc_id, "iput_v", &var_id);
+	if(NC_NOERR != ncmpi_get_vara_double_all(nc_id, var_id,
+		    rstart, rcount, fp))
+	{
+	    err += LAT * LON;
+	}else
+	{
+	    for(i = 0; i < LAT * LON; i ++)
+	    {
+		err += (fp[i] != i);
+	    }
+	}
+	ncmpi_inq_varid(nc_id, "reuse_v", &var_id);
+	if(NC_NOERR != ncmpi_get_vara_double_all(nc_id, var_id,
+		    rstart, rcount, fp))
+	{
+	    err += LAT * LON;
+	}else
+	{
+	    for(i = 0; i < LAT * LON; i ++)
+	    {
+		err += (fp[i] != - i);
+	    }
+	}
+	ncmpi_close(nc_id);
+	free(fp);
+	printf("%s : %d wrong values\n", path, err);
+    }
+
+    MPI_Finalize();
+    return 0;
+}
@@ -26,6 +26,7 @@ int main(int argc, char** argv)
     int rank, size;
     int ncidp;
     int dim1,var1,i, j, l;
+    int index;
 
     int LAT_PROC, LON_PROC;
     size_t start[2],count[2];
@@ -37,6 +38,7 @@ int main(int argc, char** argv)
     size_t len = 10;
     MPI_Comm comm = MPI_COMM_WORLD;
     volatile double a;
+    int provided;
 
     if(4 != argc)
     {
@@ -47,7 +49,8 @@ int main(int argc, char** argv)
     LAT_PROC = atoi(argv[1]);
     LON_PROC = atoi(argv[2]);
     
-    MPI_Init(&argc, &argv);
+    /* CFIO_SEND_THREAD=1 needs MPI_THREAD_MULTIPLE */
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_MULTIPLE, &provided);
     MPI_Comm_rank(comm, &rank);
     MPI_Comm_size(comm, &size);
 
@@ -63,12 +66,19 @@ int main(int argc, char** argv)
     //    set_debug_mask(DEBUG_MSG | DEBUG_CFIO);
     //}
     //set_debug_mask(DEBUG_SERVER | DEBUG_SENDER);
-    start[0] = (rank % LAT_PROC) * (LAT / LAT_PROC);
-    start[1] = (rank / LAT_PROC) * (LON / LON_PROC);
+
+    times_start();
+    cfio_init( LAT_PROC, LON_PROC, CFIO_RATIO);
+    CFIO_START();
+    /* the block is located by the client index, not the rank, for they 
+     * differ when CFIO_MAP_TOPOLOGY is set */
+    index = cfio_client_index();
+    start[0] = (index % LAT_PROC) * (LAT / LAT_PROC);
+    start[1] = (index / LAT_PROC) * (LON / LON_PROC);
     count[0] = LAT / LAT_PROC;
     count[1] = LON / LON_PROC;
     //start[0] = 0;
-    //start[1] = rank * (LON / size);
+    //start[1] = index * (LON / size);
     //count[0] = LAT ;
     //count[1] = LON / size;
     double *fp = malloc(count[0] * count[1] *sizeof(double));
@@ -78,12 +88,8 @@ int main(int argc, char** argv)
 
     for( i = 0; i< count[0] * count[1]; i++)
     {
-	fp[i] = i + rank * count[0] * count[1];
+	fp[i] = i + index * count[0] * count[1];
     }
-
-    times_start();
-    cfio_init( LAT_PROC, LON_PROC, CFIO_RATIO);
-    CFIO_START();
     double start_time = times_cur();
     //printf("Loop : %d\n", LOOP);
     for(i = 0; i < LOOP; i ++)
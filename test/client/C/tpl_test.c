@@ -0,0 +1,182 @@
+/****************************************************************************
+ *       Filename:  tpl_test.c
+ *
+ *    Description:  test cfio_create_from_template, the file of step 0 is
+ *		    the template of the later steps. the last client ends the
+ *		    define of the template after the others have put all
+ *		    steps, so the server creates the later files late
+ *
+ *        Version:  1.0
+ *        Created:  10/17/2026 04:25:37 PM
+ *       Revision:  none
+ *       Compiler:  gcc
+ ***************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "mpi.h"
+#include "pnetcdf.h"
+#include "cfio.h"
+#include "cfio_error.h"
+#include "map.h"
+#include "id.h"
+
+#define LAT 64
+#define LON 32
+
+#define LAT_PROC 4
+#define LON_PROC 4
+
+#define ratio 8
+
+#define STEP 6
+
+int main(int argc, char** argv)
+{
+    int rank, size;
+    char path[32];
+    int ncidp, template_ncid;
+    int dim1, var1, i, k, n, ret;
+    int index, last;
+    int dimids[2];
+    size_t start[2], count[2];
+    double *fp;
+    int *client_ranks;
+    MPI_Group world_group, client_group;
+    MPI_Comm client_comm;
+
+    MPI_Init(&argc, &argv);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    cfio_init( LAT_PROC, LON_PROC, ratio);
+    CFIO_START();
+
+    client_ranks = malloc(size * sizeof(int));
+    for(i = 0, n = 0; i < size; i ++)
+    {
+	if(CFIO_MAP_TYPE_CLIENT == cfio_map_proc_type(i))
+	{
+	    client_ranks[n ++] = i;
+	}
+    }
+    MPI_Comm_group(MPI_COMM_WORLD, &world_group);
+    MPI_Group_incl(world_group, n, client_ranks, &client_group);
+    MPI_Comm_create_group(MPI_COMM_WORLD, client_group, 0, &client_comm);
+    free(client_ranks);
+
+    index = cfio_client_index();
+    last = (index == LAT_PROC * LON_PROC - 1);
+    start[0] = (index % LAT_PROC) * (LAT / LAT_PROC);
+    start[1] = (index / LAT_PROC) * (LON / LON_PROC);
+    count[0] = LAT / LAT_PROC;
+    count[1] = LON / LON_PROC;
+    fp = malloc(count[0] * count[1] * sizeof(double));
+
+    for(k = 0; k < STEP; k ++)
+    {
+	sprintf(path, "tpl-%d.nc", k);
+	if(0 == k)
+	{
+	    cfio_create(path, 0, &template_ncid);
+	    ncidp = template_ncid;
+	    cfio_def_dim(ncidp, "lat", LAT, &dimids[0]);
+	    cfio_def_dim(ncidp, "lon", LON, &dimids[1]);
+	    cfio_put_att(ncidp, NC_GLOBAL, "title", CFIO_CHAR, 4, "test");
+	    cfio_def_var(ncidp, "tpl_v", CFIO_DOUBLE, 2, dimids, start, count,
+		    &var1);
+	    cfio_put_att(ncidp, var1, "units", CFIO_CHAR, 1, "K");
+	    if(last)
+	    {
+		/* all steps of the others are sent */
+		MPI_Barrier(client_comm);
+	    }
+	    cfio_enddef(ncidp);
+	}else
+	{
+	    ret = cfio_create_from_template(path, template_ncid, &ncidp);
+	    if(ret < 0)
+	    {
+		printf("proc %d create %s from template fail(%d)\n",
+			rank, path, ret);
+		continue;
+	    }
+	}
+	for(i = 0; i < count[0] * count[1]; i ++)
+	{
+	    fp[i] = k * LAT * LON +
+		(start[0] + i / count[1]) * LON + start[1] + i % count[1];
+	}
+	cfio_put_vara_double(ncidp, var1, 2, start, count, fp);
+	cfio_close(ncidp);
+    }
+    cfio_io_end();
+    if(!last)
+    {
+	MPI_Barrier(client_comm);
+    }
+
+    /* the template is dropped after ID_TEMPLATE_CACHE_SIZE later ones */
+    for(k = 0; k < ID_TEMPLATE_CACHE_SIZE; k ++)
+    {
+	sprintf(path, "tpl-other-%d.nc", k);
+	cfio_create(path, 0, &ncidp);
+	cfio_def_dim(ncidp, "x", 4, &dim1);
+	cfio_enddef(ncidp);
+	cfio_close(ncidp);
+    }
+    ret = cfio_create_from_template("tpl-dropped.nc", template_ncid, &ncidp);
+    if(CFIO_ERROR_NC_NO_EXIST != ret)
+    {
+	printf("proc %d create from a dropped template returns %d\n",
+		rank, ret);
+    }
+    cfio_io_end();
+
+    free(fp);
+    MPI_Comm_free(&client_comm);
+    MPI_Group_free(&client_group);
+    MPI_Group_free(&world_group);
+
+    CFIO_END();
+    cfio_finalize();
+
+    /* read every step back when the servers have closed the files */
+    MPI_Barrier(MPI_COMM_WORLD);
+    if(0 == rank)
+    {
+	MPI_Offset rstart[2] = {0, 0}, rcount[2] = {LAT, LON};
+	int nc_id, var_id, err = 0;
+
+	fp = malloc(LAT * LON * sizeof(double));
+	for(k = 0; k < STEP; k ++)
+	{
+	    sprintf(path, "tpl-%d.nc", k);
+	    if(NC_NOERR != ncmpi_open(MPI_COMM_SELF, path, NC_NOWRITE,
+			MPI_INFO_NULL, &nc_id))
+	    {
+		printf("open %s fail\n", path);
+		err += LAT * LON;
+		continue;
+	    }
+	    ncmpi_inq_varid(nc_id, "tpl_v", &var_id);
+	    if(NC_NOERR != ncmpi_get_vara_double_all(nc_id, var_id,
+			rstart, rcount, fp))
+	    {
+		err += LAT * LON;
+	    }else
+	    {
+		for(i = 0; i < LAT * LON; i ++)
+		{
+		    err += (fp[i] != k * LAT * LON + i);
+		}
+	    }
+	    ncmpi_close(nc_id);
+	}
+	free(fp);
+	printf("tpl_test : %d wrong values\n", err);
+    }
+
+    MPI_Finalize();
+    return 0;
+}